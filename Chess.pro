@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui svg widgets
+QT       += core gui svg widgets concurrent network
 
 TARGET = Chess
 TEMPLATE = app
@@ -12,10 +12,74 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    chessboard.cpp
+    chessboard.cpp \
+    batchrenderer.cpp \
+    commandline.cpp \
+    piecerenderercache.cpp \
+    piecepixmapcache.cpp \
+    svgboardwriter.cpp \
+    position.cpp \
+    collectionfile.cpp \
+    positionsource.cpp \
+    pgnreader.cpp \
+    pgnrenderer.cpp \
+    bitboardposition.cpp \
+    matesolver.cpp \
+    batchsolver.cpp \
+    zobrist.cpp \
+    collectionindex.cpp \
+    positionquery.cpp \
+    renderserver.cpp \
+    tiledpngwriter.cpp \
+    pagecomposer.cpp \
+    boarditem.cpp \
+    instrumentation.cpp \
+    performanceoverlay.cpp \
+    uciengine.cpp \
+    enginepool.cpp \
+    thumbnailcache.cpp \
+    collectionbrowser.cpp \
+    annotations.cpp \
+    annotationitem.cpp \
+    piecetheme.cpp \
+    animationwriter.cpp
 
 HEADERS  += mainwindow.h \
-    chessboard.h
+    chessboard.h \
+    batchrenderer.h \
+    commandline.h \
+    piecerenderercache.h \
+    piecepixmapcache.h \
+    svgboardwriter.h \
+    piece.h \
+    position.h \
+    collectionfile.h \
+    positionsource.h \
+    pgnreader.h \
+    pgnrenderer.h \
+    bitboardposition.h \
+    matesolver.h \
+    batchsolver.h \
+    zobrist.h \
+    collectionindex.h \
+    positionquery.h \
+    renderserver.h \
+    tiledpngwriter.h \
+    pagecomposer.h \
+    boarditem.h \
+    instrumentation.h \
+    performanceoverlay.h \
+    uciengine.h \
+    enginepool.h \
+    thumbnailcache.h \
+    collectionbrowser.h \
+    annotations.h \
+    annotationitem.h \
+    piecetheme.h \
+    animationwriter.h
+
+# TiledPngWriter and PageComposer compress with zlib directly
+LIBS += -lz
 
 RESOURCES += \
     resources.qrc
@@ -0,0 +1,58 @@
+# Round trips of the animation writer's own encoders: every frame of a GIF
+# is decoded by Qt and compared with the position drawn directly, and the
+# first frame of an APNG, which is an ordinary PNG image, likewise. Run with
+# -platform offscreen where there is no display.
+
+QT       += core gui svg widgets testlib
+
+TARGET = animationtest
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += .. ../testsupport
+
+SOURCES += tst_animationwriter.cpp \
+    ../animationwriter.cpp \
+    ../thumbnailcache.cpp \
+    ../tiledpngwriter.cpp \
+    ../collectionfile.cpp \
+    ../positionsource.cpp \
+    ../pgnreader.cpp \
+    ../bitboardposition.cpp \
+    ../chessboard.cpp \
+    ../boarditem.cpp \
+    ../annotations.cpp \
+    ../annotationitem.cpp \
+    ../piecerenderercache.cpp \
+    ../piecetheme.cpp \
+    ../piecepixmapcache.cpp \
+    ../svgboardwriter.cpp \
+    ../position.cpp \
+    ../zobrist.cpp \
+    ../instrumentation.cpp
+
+HEADERS += ../testsupport/imagecomparison.h \
+    ../animationwriter.h \
+    ../thumbnailcache.h \
+    ../tiledpngwriter.h \
+    ../collectionfile.h \
+    ../positionsource.h \
+    ../pgnreader.h \
+    ../bitboardposition.h \
+    ../chessboard.h \
+    ../boarditem.h \
+    ../annotations.h \
+    ../annotationitem.h \
+    ../piecerenderercache.h \
+    ../piecetheme.h \
+    ../piecepixmapcache.h \
+    ../svgboardwriter.h \
+    ../position.h \
+    ../zobrist.h \
+    ../instrumentation.h \
+    ../piece.h
+
+RESOURCES += ../resources.qrc
+
+LIBS += -lz
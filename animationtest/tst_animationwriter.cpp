@@ -0,0 +1,166 @@
+#include <QtTest>
+#include <QBuffer>
+#include <QImageReader>
+#include <QtEndian>
+#include <zlib.h>
+
+#include "animationwriter.h"
+#include "thumbnailcache.h"
+#include "imagecomparison.h"
+
+class TestAnimationWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void gifRoundTrip_data();
+    void gifRoundTrip();
+    void apngFirstFrame();
+    void limits();
+
+private:
+    static QVector<Position> opening();
+    static QByteArray write(AnimationWriter::Format format, int squareSize);
+};
+
+void TestAnimationWriter::initTestCase()
+{
+    useTestLocations();
+}
+
+// 1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. O-O: small frames, and one of four squares
+QVector<Position> TestAnimationWriter::opening()
+{
+    static const char * const fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w",
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b",
+        "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w",
+        "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b",
+        "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w",
+        "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b",
+        "r1bqkbnr/1ppp1ppp/p1n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R w",
+        "r1bqkbnr/1ppp1ppp/p1n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQ1RK1 b",
+        0 };
+    QVector<Position> positions;
+    for(int i=0; fens[i] != 0; i++)
+    {
+        Position p;
+        p.parse( QString(fens[i]) );
+        positions << p;
+    }
+    return positions;
+}
+
+QByteArray TestAnimationWriter::write(AnimationWriter::Format format, int squareSize)
+{
+    AnimationWriter writer;
+    writer.setSquareSize(squareSize);
+    writer.setThreadCount(3);
+    foreach(Position p, opening())
+        writer.addPosition(p);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    if( !writer.write(format, &buffer) )
+        return QByteArray();
+    return buffer.data();
+}
+
+void TestAnimationWriter::gifRoundTrip_data()
+{
+    QTest::addColumn<int>("squareSize");
+
+    QTest::newRow("20 px squares") << 20;
+    QTest::newRow("45 px squares") << 45;
+}
+
+void TestAnimationWriter::gifRoundTrip()
+{
+    QFETCH(int, squareSize);
+
+    QByteArray gif = write(AnimationWriter::Gif, squareSize);
+    QVERIFY( gif.startsWith("GIF89a") );
+    QVERIFY( gif.endsWith(";") );
+
+    // Qt composes each delta frame over the ones before, as a viewer would
+    QBuffer buffer(&gif);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, "gif");
+    QVERIFY( reader.supportsAnimation() );
+    QVector<Position> positions = opening();
+    QCOMPARE( reader.imageCount(), positions.count() );
+    QCOMPARE( reader.loopCount(), -1 );
+    for(int i=0; i<positions.count(); i++)
+    {
+        QImage frame = reader.read();
+        QVERIFY2( !frame.isNull(), qPrintable( QString("frame %1: %2").arg(i).arg(reader.errorString()) ) );
+        compareImages( frame, ThumbnailCache::render(positions.at(i), BoardStyle(), squareSize), 4.0, 48 );
+    }
+}
+
+void TestAnimationWriter::apngFirstFrame()
+{
+    QByteArray apng = write(AnimationWriter::Apng, 30);
+    QVector<Position> positions = opening();
+
+    // the chunks: each CRC, one acTL before the image data, an fcTL a frame, IEND last
+    QVERIFY( apng.startsWith("\x89PNG\r\n\x1a\n") );
+    int pos = 8, controls = 0;
+    bool sawAnimation = false, sawImage = false;
+    QByteArray last;
+    while( pos + 12 <= apng.size() )
+    {
+        const uchar *p = reinterpret_cast<const uchar*>( apng.constData() ) + pos;
+        quint32 length = qFromBigEndian<quint32>(p);
+        QVERIFY( pos + 12 + (qint64)length <= apng.size() );
+        QByteArray type = apng.mid(pos + 4, 4);
+        uLong crc = crc32( 0, p + 4, 4 + length );
+        QCOMPARE( qFromBigEndian<quint32>( p + 8 + length ), (quint32)crc );
+
+        if( type == "acTL" )
+        {
+            QVERIFY( !sawImage );
+            QCOMPARE( qFromBigEndian<quint32>( p + 8 ), (quint32)positions.count() );
+            sawAnimation = true;
+        }
+        else if( type == "IDAT" )
+        {
+            sawImage = true;
+        }
+        else if( type == "fcTL" )
+        {
+            controls++;
+        }
+        last = type;
+        pos += 12 + length;
+    }
+    QCOMPARE( pos, apng.size() );
+    QVERIFY( sawAnimation );
+    QCOMPARE( controls, positions.count() );
+    QCOMPARE( last, QByteArray("IEND") );
+
+    // a viewer that knows no APNG shows the first frame, a whole board
+    QImage first;
+    QVERIFY( first.loadFromData(apng, "PNG") );
+    compareImages( first, ThumbnailCache::render(positions.first(), BoardStyle(), 30), 1.0, 48 );
+}
+
+void TestAnimationWriter::limits()
+{
+    // a board wider than a 16-bit field, or a delay longer than one, is not written
+    AnimationWriter writer;
+    writer.addPosition( opening().first() );
+    writer.setSquareSize( AnimationWriter::MaxSquareSize + 1 );
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY( !writer.write(AnimationWriter::Gif, &buffer) );
+    writer.setSquareSize( AnimationWriter::MaxSquareSize );
+    writer.setDelays( AnimationWriter::MaxDelay + 1, 1000 );
+    QVERIFY( !writer.write(AnimationWriter::Gif, &buffer) );
+    QCOMPARE( buffer.size(), Q_INT64_C(0) );
+}
+
+QTEST_MAIN(TestAnimationWriter)
+
+#include "tst_animationwriter.moc"
@@ -0,0 +1,737 @@
+#include "animationwriter.h"
+
+#include <QtCore>
+#include <QtEndian>
+#include <QImage>
+#include <QPainter>
+#include <zlib.h>
+#include <algorithm>
+#include <climits>
+
+#include "positionsource.h"
+#include "bitboardposition.h"
+#include "pgnreader.h"
+#include "svgboardwriter.h"
+#include "tiledpngwriter.h"
+#include "piecerenderercache.h"
+#include "piecepixmapcache.h"
+#include "instrumentation.h"
+
+// GIF palette index left for the squares a frame does not change
+enum { Transparent = 255 };
+
+// tinted piece images at one square size, kept by each thread that draws frames
+struct AnimationPieces
+{
+    AnimationPieces() : size(0) { }
+
+    BoardStyle style;
+    int size;
+    QImage images[2][6];
+};
+
+static QThreadStorage<AnimationPieces*> animationPieces;
+
+static const QImage & pieceImage(Piece p, const BoardStyle & style, int size)
+{
+    if( !animationPieces.hasLocalData() )
+        animationPieces.setLocalData( new AnimationPieces );
+    AnimationPieces *pieces = animationPieces.localData();
+    if( pieces->size != size || pieces->style.lightPiece != style.lightPiece || pieces->style.darkPiece != style.darkPiece
+            || pieces->style.version != style.version || pieces->style.pieceTheme != style.pieceTheme )
+    {
+        pieces->size = size;
+        pieces->style = style;
+        for(int c=0; c<2; c++)
+            for(int t=0; t<6; t++)
+                pieces->images[c][t] = QImage();
+    }
+
+    QImage & image = pieces->images[p.color()][p.type()];
+    if( image.isNull() )
+    {
+        QImage artwork(size, size, QImage::Format_ARGB32_Premultiplied);
+        artwork.fill(Qt::transparent);
+        QPainter painter(&artwork);
+        painter.setRenderHint(QPainter::Antialiasing);
+        PieceRendererCache::instance()->render( &painter, p, style.version, style.pieceTheme, QRectF(0, 0, size, size) );
+        painter.end();
+        image = PiecePixmapCache::colorize( artwork, p.color() == Piece::White ? style.lightPiece : style.darkPiece );
+    }
+    return image;
+}
+
+// the squares of a frame: any that differ from the position before, or all of them for the first
+static quint64 changedSquares(const QVector<Position> & positions, int frame)
+{
+    if( frame == 0 )
+        return ~Q_UINT64_C(0);
+    quint64 changed = 0;
+    for(int square=0; square<64; square++)
+        if( positions.at(frame).code(square) != positions.at(frame - 1).code(square) )
+            changed |= Q_UINT64_C(1) << square;
+    return changed;
+}
+
+// the smallest rectangle of squares holding the changed ones, in pixels; a
+// frame that changes nothing is one transparent pixel, since a frame may not be empty
+static QRect frameArea(quint64 changed, int squareSize)
+{
+    if( changed == 0 )
+        return QRect(0, 0, 1, 1);
+    int top = 7, bottom = 0, left = 7, right = 0;
+    for(int square=0; square<64; square++)
+    {
+        if( !( changed & ( Q_UINT64_C(1) << square ) ) )
+            continue;
+        top = qMin(top, square / 8);
+        bottom = qMax(bottom, square / 8);
+        left = qMin(left, square % 8);
+        right = qMax(right, square % 8);
+    }
+    return QRect( left * squareSize, top * squareSize, ( right - left + 1 ) * squareSize, ( bottom - top + 1 ) * squareSize );
+}
+
+static QImage drawFrame(const Position & position, quint64 changed, const QRect & area, const BoardStyle & style, int squareSize)
+{
+    QImage image(area.size(), QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.translate( -area.topLeft() );
+    for(int square=0; square<64; square++)
+    {
+        if( !( changed & ( Q_UINT64_C(1) << square ) ) )
+            continue;
+        int i = square / 8, j = square % 8;
+        QRect rect( j * squareSize, i * squareSize, squareSize, squareSize );
+        painter.fillRect( rect, i % 2 == j % 2 ? style.lightSquare : style.darkSquare );
+        Piece p = position.at(i, j);
+        if( p.type() != Piece::None )
+            painter.drawImage( rect.topLeft(), pieceImage(p, style, squareSize) );
+    }
+    painter.end();
+    return image;
+}
+
+// packs LZW codes of growing width into GIF's 255-byte sub-blocks
+class GifBitWriter
+{
+public:
+    GifBitWriter() : bits(0), count(0) { }
+
+    void write(int code, int size)
+    {
+        bits |= (quint32)code << count;
+        count += size;
+        while( count >= 8 )
+        {
+            byte( bits & 0xFF );
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    QByteArray finish()
+    {
+        if( count > 0 )
+            byte( bits & 0xFF );
+        if( !block.isEmpty() )
+            out += char( block.size() ) + block;
+        out += char(0);
+        return out;
+    }
+
+    QByteArray out;
+
+private:
+    void byte(quint32 b)
+    {
+        block += char(b);
+        if( block.size() == 255 )
+        {
+            out += char(255) + block;
+            block.clear();
+        }
+    }
+
+    QByteArray block;
+    quint32 bits;
+    int count;
+};
+
+// GIF's variable-width LZW over 8-bit indices, with the dictionary held in
+// an open-addressed table keyed by prefix code and next index
+static QByteArray lzw(const QByteArray & indices)
+{
+    enum { MinCodeSize = 8, ClearCode = 256, EndCode = 257, MaxCode = 4095, TableSize = 8192 };
+
+    QVector<int> keys(TableSize, -1);
+    QVector<short> codes(TableSize);
+    GifBitWriter writer;
+    writer.out += char(MinCodeSize);
+
+    int codeSize = MinCodeSize + 1;
+    int nextCode = EndCode + 1;
+    writer.write(ClearCode, codeSize);
+
+    const uchar *data = reinterpret_cast<const uchar*>( indices.constData() );
+    int current = indices.isEmpty() ? -1 : data[0];
+    for(int i=1; i<indices.size(); i++)
+    {
+        int key = ( current << 8 ) | data[i];
+        int slot = ( key * 2654435761u ) >> 19 & ( TableSize - 1 );
+        while( keys.at(slot) != -1 && keys.at(slot) != key )
+            slot = ( slot + 1 ) & ( TableSize - 1 );
+        if( keys.at(slot) == key )
+        {
+            current = codes.at(slot);
+            continue;
+        }
+
+        writer.write(current, codeSize);
+        keys[slot] = key;
+        codes[slot] = nextCode++;
+        // the decoder widens its codes one entry behind the encoder
+        if( nextCode > ( 1 << codeSize ) && codeSize < 12 )
+            codeSize++;
+        if( nextCode > MaxCode )
+        {
+            writer.write(ClearCode, codeSize);
+            keys.fill(-1);
+            codeSize = MinCodeSize + 1;
+            nextCode = EndCode + 1;
+        }
+        current = data[i];
+    }
+    if( current >= 0 )
+        writer.write(current, codeSize);
+    writer.write(EndCode, codeSize);
+    return writer.finish();
+}
+
+// filtered RGBA rows in a zlib stream, as IDAT and fdAT hold them
+static QByteArray pngData(const QImage & image)
+{
+    const int width = image.width();
+    QByteArray raw( image.height() * ( 1 + 4 * width ), Qt::Uninitialized );
+    uchar *out = reinterpret_cast<uchar*>( raw.data() );
+    for(int y=0; y<image.height(); y++)
+    {
+        // filter type 1: every byte less the one a pixel to its left
+        const QRgb *line = reinterpret_cast<const QRgb*>( image.constScanLine(y) );
+        *out++ = 1;
+        QRgb left = 0;
+        for(int x=0; x<width; x++)
+        {
+            *out++ = qRed(line[x]) - qRed(left);
+            *out++ = qGreen(line[x]) - qGreen(left);
+            *out++ = qBlue(line[x]) - qBlue(left);
+            *out++ = qAlpha(line[x]) - qAlpha(left);
+            left = line[x];
+        }
+    }
+
+    uLongf length = compressBound( raw.size() );
+    QByteArray compressed( length, Qt::Uninitialized );
+    compress2( reinterpret_cast<Bytef*>( compressed.data() ), &length, reinterpret_cast<const Bytef*>( raw.constData() ), raw.size(), Z_DEFAULT_COMPRESSION );
+    compressed.resize( length );
+    return compressed;
+}
+
+struct AnimationFrame
+{
+    QRect area;
+    QByteArray data;    // a zlib stream for APNG, LZW sub-blocks for GIF
+};
+
+struct AnimationJob
+{
+    const QVector<Position> *positions;
+    BoardStyle style;
+    int squareSize;
+    AnimationWriter::Format format;
+    QVector<uchar> palette;     // for GIF, the index of each colour with five bits a channel
+
+    QAtomicInt next;
+    QSemaphore freeSlots;       // frames that may be waiting to be written
+    QMutex mutex;
+    QWaitCondition frameReady;
+    QMap<int,AnimationFrame> finished;
+};
+
+class AnimationWorker : public QRunnable
+{
+public:
+    explicit AnimationWorker(AnimationJob *job) : job(job) { }
+
+    void run();
+
+private:
+    AnimationJob *job;
+};
+
+void AnimationWorker::run()
+{
+    forever
+    {
+        job->freeSlots.acquire();
+        int i = job->next.fetchAndAddRelaxed(1);
+        if( i >= job->positions->count() )
+        {
+            job->freeSlots.release();
+            return;
+        }
+
+        ScopedTimer timer("animation frame");
+        quint64 changed = changedSquares(*job->positions, i);
+        AnimationFrame frame;
+        frame.area = frameArea(changed, job->squareSize);
+        QImage image = drawFrame( job->positions->at(i), changed, frame.area, job->style, job->squareSize );
+
+        if( job->format == AnimationWriter::Apng )
+        {
+            frame.data = pngData(image);
+        }
+        else
+        {
+            QByteArray indices( image.width() * image.height(), Qt::Uninitialized );
+            uchar *out = reinterpret_cast<uchar*>( indices.data() );
+            for(int y=0; y<image.height(); y++)
+            {
+                const QRgb *line = reinterpret_cast<const QRgb*>( image.constScanLine(y) );
+                for(int x=0; x<image.width(); x++)
+                    *out++ = qAlpha(line[x]) < 128 ? Transparent
+                            : job->palette.at( ( qRed(line[x]) >> 3 ) << 10 | ( qGreen(line[x]) >> 3 ) << 5 | qBlue(line[x]) >> 3 );
+            }
+            frame.data = lzw(indices);
+        }
+
+        QMutexLocker locker(&job->mutex);
+        job->finished.insert(i, frame);
+        job->frameReady.wakeAll();
+    }
+}
+
+// the 255 commonest colours of the squares and every piece on both, and
+// for each colour of five bits a channel the nearest of them
+static void buildPalette(const BoardStyle & style, int squareSize, QByteArray & colors, QVector<uchar> & lookup)
+{
+    QImage sample(squareSize * 12, squareSize * 2, QImage::Format_ARGB32);
+    QPainter painter(&sample);
+    for(int row=0; row<2; row++)
+    {
+        for(int k=0; k<12; k++)
+        {
+            QRect rect( k * squareSize, row * squareSize, squareSize, squareSize );
+            painter.fillRect( rect, row == 0 ? style.lightSquare : style.darkSquare );
+            painter.drawImage( rect.topLeft(), pieceImage( Piece( (Piece::Type)( k % 6 ), k < 6 ? Piece::White : Piece::Black ), style, squareSize ) );
+        }
+    }
+    painter.end();
+
+    QVector<int> counts(32768, 0);
+    QVector<qint64> sums(32768 * 3, 0);
+    for(int y=0; y<sample.height(); y++)
+    {
+        const QRgb *line = reinterpret_cast<const QRgb*>( sample.constScanLine(y) );
+        for(int x=0; x<sample.width(); x++)
+        {
+            int bin = ( qRed(line[x]) >> 3 ) << 10 | ( qGreen(line[x]) >> 3 ) << 5 | qBlue(line[x]) >> 3;
+            counts[bin]++;
+            sums[bin * 3] += qRed(line[x]);
+            sums[bin * 3 + 1] += qGreen(line[x]);
+            sums[bin * 3 + 2] += qBlue(line[x]);
+        }
+    }
+
+    QVector<QPair<int,int> > used;
+    for(int bin=0; bin<32768; bin++)
+        if( counts.at(bin) > 0 )
+            used << qMakePair( -counts.at(bin), bin );
+    std::sort( used.begin(), used.end() );
+    int entries = qMin( used.count(), (int)Transparent );
+
+    // the transparent entry is never shown, so it may be any colour
+    colors = QByteArray(256 * 3, 0);
+    for(int k=0; k<entries; k++)
+    {
+        int bin = used.at(k).second;
+        for(int c=0; c<3; c++)
+            colors[k * 3 + c] = char( sums.at(bin * 3 + c) / counts.at(bin) );
+    }
+
+    lookup = QVector<uchar>(32768);
+    for(int bin=0; bin<32768; bin++)
+    {
+        int r = ( bin >> 10 ) * 8 + 4, g = ( ( bin >> 5 ) & 31 ) * 8 + 4, b = ( bin & 31 ) * 8 + 4;
+        int best = 0, bestDistance = INT_MAX;
+        for(int k=0; k<entries && bestDistance > 0; k++)
+        {
+            int dr = r - (uchar)colors.at(k * 3), dg = g - (uchar)colors.at(k * 3 + 1), db = b - (uchar)colors.at(k * 3 + 2);
+            int distance = dr * dr + dg * dg + db * db;
+            if( distance < bestDistance )
+            {
+                best = k;
+                bestDistance = distance;
+            }
+        }
+        lookup[bin] = best;
+    }
+}
+
+static QByteArray littleEndian16(int v)
+{
+    QByteArray b(2, 0);
+    qToLittleEndian<quint16>( v, reinterpret_cast<uchar*>( b.data() ) );
+    return b;
+}
+
+static QByteArray bigEndian32(quint32 v)
+{
+    QByteArray b(4, 0);
+    qToBigEndian<quint32>( v, reinterpret_cast<uchar*>( b.data() ) );
+    return b;
+}
+
+// the positions of the main line of the first game, each move a frame
+class AnimationGame : public PgnVisitor
+{
+public:
+    explicit AnimationGame(AnimationWriter *writer) : writer(writer), bStarted(false), bFailed(false) { game.setStartingPosition(); }
+
+    void tag(const QByteArray & name, const QByteArray & value)
+    {
+        if( name == "FEN" && !game.setFen( value.constData(), value.size() ) )
+            bFailed = true;
+    }
+
+    bool move(const QByteArray & san)
+    {
+        start();
+        BitboardPosition::Move m;
+        if( bFailed || !game.moveFromSan( san.constData(), san.size(), &m ) )
+        {
+            bFailed = true;
+            return false;
+        }
+        game.makeMove(m);
+        writer->addPosition( game.position() );
+        return true;
+    }
+
+    void endGame(const QByteArray & result)
+    {
+        Q_UNUSED(result);
+        start();
+    }
+
+    bool failed() const { return bFailed; }
+
+private:
+    void start()
+    {
+        if( !bStarted && !bFailed )
+            writer->addPosition( game.position() );
+        bStarted = true;
+    }
+
+    AnimationWriter *writer;
+    BitboardPosition game;
+    bool bStarted;
+    bool bFailed;
+};
+
+AnimationWriter::AnimationWriter()
+{
+    nSquareSize = 45;
+    nDelay = 1000;
+    nEndDelay = 3000;
+    nThreads = QThread::idealThreadCount();
+    nSkipped = 0;
+    nMilliseconds = 0;
+    nPixels = 0;
+}
+
+bool AnimationWriter::addInput(const QString & path)
+{
+    if( QFileInfo(path).suffix().toLower() == "pgn" )
+        return addPgn(path);
+
+    PositionSource source;
+    if( !source.addInput(path) )
+        return false;
+    foreach(const PositionSource::Item & item, source.items())
+    {
+        CollectionEntry entry;
+        if( item.read(&entry) )
+            addPosition(entry.position);
+        else
+            nSkipped++;
+    }
+    return true;
+}
+
+bool AnimationWriter::addPgn(const QString & path)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Could not open:" << path;
+        return false;
+    }
+    AnimationGame game(this);
+    PgnReader reader(&file);
+    reader.readGame(&game);
+    // the moves up to one that cannot be played are kept
+    if( game.failed() )
+        qDebug() << "Could not read the whole game in:" << path;
+    return true;
+}
+
+double AnimationWriter::fractionEncoded() const
+{
+    double whole = (double)positions.count() * nSquareSize * nSquareSize * 64;
+    return whole > 0 ? nPixels / whole : 0.0;
+}
+
+AnimationWriter::Format AnimationWriter::formatFromFilename(const QString & filename)
+{
+    QString suffix = QFileInfo(filename).suffix().toLower();
+    if( suffix == "gif" )
+        return Gif;
+    else if( suffix == "svg" )
+        return Svg;
+    else
+        return Apng;
+}
+
+bool AnimationWriter::write(const QString & filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+    return write( formatFromFilename(filename), &file );
+}
+
+bool AnimationWriter::write(Format format, QIODevice *device)
+{
+    if( device == 0 || !device->isWritable() || positions.isEmpty() )
+        return false;
+    if( nSquareSize < 1 || nSquareSize > MaxSquareSize )
+    {
+        qDebug() << "Square size out of range:" << nSquareSize;
+        return false;
+    }
+    if( nDelay < MinDelay || nDelay > MaxDelay || nEndDelay < MinDelay || nEndDelay > MaxDelay )
+    {
+        qDebug() << "Delay out of range:" << nDelay << nEndDelay;
+        return false;
+    }
+    ScopedTimer scopedTimer("animation export");
+    Instrumentation::count(Instrumentation::Exports);
+
+    QElapsedTimer timer;
+    timer.start();
+    nPixels = 0;
+    bool ok = format == Svg ? writeSvg(device) : writeRaster(format, device);
+    nMilliseconds = timer.elapsed();
+    return ok;
+}
+
+bool AnimationWriter::writeRaster(Format format, QIODevice *device)
+{
+    const int side = nSquareSize * 8;
+
+    AnimationJob job;
+    job.positions = &positions;
+    job.style = mStyle;
+    job.squareSize = nSquareSize;
+    job.format = format;
+    job.next = 0;
+    QByteArray colors;
+    if( format == Gif )
+        buildPalette(mStyle, nSquareSize, colors, job.palette);
+
+    int threads = qMax(1, nThreads);
+    job.freeSlots.release( threads * 4 );
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for(int i=0; i<threads; i++)
+        pool.start( new AnimationWorker(&job) );
+
+    bool ok;
+    if( format == Apng )
+    {
+        static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+        ok = device->write(signature, 8) == 8;
+
+        QByteArray header = bigEndian32(side) + bigEndian32(side);
+        header += char(8);  // bits per channel
+        header += char(6);  // RGBA
+        header += QByteArray(3, 0);
+        ok = ok && TiledPngWriter::writeChunk(device, "IHDR", header);
+        // the frame count, and zero plays, which is for ever
+        ok = ok && TiledPngWriter::writeChunk(device, "acTL", bigEndian32( positions.count() ) + bigEndian32(0));
+    }
+    else
+    {
+        QByteArray header = "GIF89a" + littleEndian16(side) + littleEndian16(side);
+        header += char(0xF7);   // a global table of 256 colours
+        header += QByteArray(2, 0);
+        header += colors;
+        // loop for ever
+        header += QByteArray("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+        ok = device->write(header) == header.size();
+    }
+
+    quint32 sequence = 0;
+    for(int i=0; i<positions.count(); i++)
+    {
+        AnimationFrame frame;
+        {
+            QMutexLocker locker(&job.mutex);
+            while( !job.finished.contains(i) )
+                job.frameReady.wait(&job.mutex);
+            frame = job.finished.take(i);
+        }
+        job.freeSlots.release();
+        nPixels += (qint64)frame.area.width() * frame.area.height();
+
+        if( format == Apng )
+        {
+            // every frame after the first is drawn over the one before
+            QByteArray control = bigEndian32(sequence++);
+            control += bigEndian32( frame.area.width() ) + bigEndian32( frame.area.height() );
+            control += bigEndian32( frame.area.x() ) + bigEndian32( frame.area.y() );
+            QByteArray delayFraction(4, 0);
+            qToBigEndian<quint16>( delay(i), reinterpret_cast<uchar*>( delayFraction.data() ) );
+            qToBigEndian<quint16>( 1000, reinterpret_cast<uchar*>( delayFraction.data() ) + 2 );
+            control += delayFraction;
+            control += char(0);     // leave the frame in place
+            control += char( i == 0 ? 0 : 1 );  // the first replaces everything, the rest blend over
+            ok = ok && TiledPngWriter::writeChunk(device, "fcTL", control);
+            if( i == 0 )
+                ok = ok && TiledPngWriter::writeChunk(device, "IDAT", frame.data);
+            else
+                ok = ok && TiledPngWriter::writeChunk(device, "fdAT", bigEndian32(sequence++) + frame.data);
+        }
+        else
+        {
+            QByteArray block("\x21\xF9\x04", 3);
+            block += char( ( 1 << 2 ) | ( i == 0 ? 0 : 1 ) );   // leave the frame in place; transparency after the first
+            block += littleEndian16( ( delay(i) + 5 ) / 10 );
+            block += char(Transparent);
+            block += char(0);
+            block += char(0x2C);
+            block += littleEndian16( frame.area.x() ) + littleEndian16( frame.area.y() );
+            block += littleEndian16( frame.area.width() ) + littleEndian16( frame.area.height() );
+            block += char(0);
+            ok = ok && device->write(block) == block.size() && device->write(frame.data) == frame.data.size();
+        }
+    }
+    pool.waitForDone();
+
+    if( format == Apng )
+        ok = ok && TiledPngWriter::writeChunk(device, "IEND", QByteArray());
+    else
+        ok = ok && device->write(";", 1) == 1;
+    return ok;
+}
+
+bool AnimationWriter::writeSvg(QIODevice *device)
+{
+    // drawn in 45-unit squares, as SvgBoardWriter draws, and shown at the square size
+    const int w = 45;
+    const QByteArray boardSize = QByteArray::number(8 * w);
+    const QByteArray squareEdge = QByteArray::number(w);
+
+    QVector<int> starts;
+    int total = 0;
+    for(int i=0; i<positions.count(); i++)
+    {
+        starts << total;
+        total += delay(i);
+    }
+    starts << total;
+
+    QByteArray defs;
+    bool defined[2][6] = { { false, false, false, false, false, false }, { false, false, false, false, false, false } };
+
+    // a piece is one element for as long as it stays on its square, shown
+    // and hidden by a discrete animation of its visibility over the whole loop
+    QByteArray uses;
+    const QByteArray duration = QByteArray::number(total / 1000.0) + "s";
+    for(int square=0; square<64; square++)
+    {
+        int first = 0;
+        for(int i=1; i<=positions.count(); i++)
+        {
+            quint8 code = positions.at(first).code(square);
+            if( i < positions.count() && positions.at(i).code(square) == code )
+                continue;
+            int end = i;
+            int start = first;
+            first = i;
+            if( code == 0 )
+                continue;
+
+            Piece p = Position::pieceFromCode(code);
+            QByteArray id = SvgBoardWriter::pieceId(p);
+            if( !defined[p.color()][p.type()] )
+            {
+                defined[p.color()][p.type()] = true;
+                QColor tint = p.color() == Piece::White ? mStyle.lightPiece : mStyle.darkPiece;
+                defs += SvgBoardWriter::pieceDefinition(p, mStyle.version, mStyle.pieceTheme, tint, id, w);
+            }
+
+            uses += "<use xlink:href=\"#" + id + "\" x=\"" + QByteArray::number(square % 8 * w) + "\" y=\"" + QByteArray::number(square / 8 * w) + "\"";
+            if( start == 0 && end == positions.count() )
+            {
+                uses += "/>\n";
+                continue;
+            }
+
+            QByteArray values, keyTimes;
+            if( start > 0 )
+            {
+                values += "hidden;";
+                keyTimes += "0;";
+            }
+            values += "visible";
+            keyTimes += start > 0 ? QByteArray::number( (double)starts.at(start) / total, 'f', 4 ) : QByteArray("0");
+            if( end < positions.count() )
+            {
+                values += ";hidden";
+                keyTimes += ";" + QByteArray::number( (double)starts.at(end) / total, 'f', 4 );
+            }
+            // what is on the board at the start stays visible where SMIL is not played
+            uses += start > 0 ? " visibility=\"hidden\">" : ">";
+            uses += "<animate attributeName=\"visibility\" values=\"" + values + "\" keyTimes=\"" + keyTimes
+                    + "\" dur=\"" + duration + "\" calcMode=\"discrete\" repeatCount=\"indefinite\"/></use>\n";
+        }
+    }
+    for(int i=0; i<positions.count(); i++)
+        nPixels += (qint64)qPopulationCount( changedSquares(positions, i) ) * nSquareSize * nSquareSize;
+
+    QByteArray darkSquares;
+    for(int i=0; i<8; i++)
+        for(int j=0; j<8; j++)
+            if( i % 2 != j % 2 )
+                darkSquares += "M" + QByteArray::number(j * w) + " " + QByteArray::number(i * w) + "h" + squareEdge + "v" + squareEdge + "h-" + squareEdge + "z";
+
+    const QByteArray side = QByteArray::number(nSquareSize * 8);
+    QByteArray svg;
+    svg += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    svg += "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\""
+           " width=\"" + side + "\" height=\"" + side + "\" viewBox=\"0 0 " + boardSize + " " + boardSize + "\">\n";
+    if( !defs.isEmpty() )
+        svg += "<defs>\n" + defs + "</defs>\n";
+    svg += "<rect width=\"" + boardSize + "\" height=\"" + boardSize + "\" fill=\"" + mStyle.lightSquare.name().toLatin1() + "\"/>\n";
+    svg += "<path fill=\"" + mStyle.darkSquare.name().toLatin1() + "\" d=\"" + darkSquares + "\"/>\n";
+    svg += uses;
+    svg += "</svg>\n";
+    return device->write(svg) == svg.size();
+}
@@ -0,0 +1,78 @@
+#ifndef ANIMATIONWRITER_H
+#define ANIMATIONWRITER_H
+
+#include <QVector>
+#include <QString>
+
+#include "chessboard.h"
+#include "position.h"
+
+class QIODevice;
+
+// Writes a sequence of positions, such as the moves of a solution, as one
+// animation: an APNG, a GIF, or an SVG animated with SMIL. The first frame
+// is the whole board; each later frame is only the rectangle around the
+// squares that changed, with the unchanged squares inside it transparent,
+// so it is drawn over the frame before. File size and encoding time grow
+// with the number of moves rather than with moves times the board. The
+// raster frames are drawn and compressed on a pool of threads and written
+// in order.
+class AnimationWriter
+{
+public:
+    enum Format { Apng, Gif, Svg };
+    // GIF and APNG keep the board side and the delays in 16-bit fields (the
+    // GIF's in hundredths of a second); a 1024-pixel square already makes a
+    // 32 MB frame per thread
+    enum { MaxSquareSize = 1024, MinDelay = 10, MaxDelay = 65535 };
+
+    AnimationWriter();
+
+    // a PGN file (the main line of its first game, starting from its FEN tag
+    // if it has one), a collection (.chc), a .chs file, a directory of .chs
+    // files, or a list file with one .chs path or position per line; positions
+    // that cannot be read are left out and counted by skipped()
+    bool addInput(const QString & path);
+    void addPosition(const Position & position) { positions << position; }
+    int frameCount() const { return positions.count(); }
+    int skipped() const { return nSkipped; }
+
+    void setStyle(const BoardStyle & style) { mStyle = style; }
+    // in pixels; an SVG is drawn in 45-unit squares and shown at this size.
+    // write() refuses sizes outside 1 to MaxSquareSize.
+    void setSquareSize(int pixels) { nSquareSize = pixels; }
+    // each position is shown for delay milliseconds, and the last for endDelay;
+    // write() refuses delays outside MinDelay to MaxDelay
+    void setDelays(int delay, int endDelay) { nDelay = delay; nEndDelay = endDelay; }
+    void setThreadCount(int n) { nThreads = n; }
+
+    // the format is chosen by the suffix: .png or .apng, .gif, or .svg
+    static Format formatFromFilename(const QString & filename);
+    bool write(const QString & filename);
+    bool write(Format format, QIODevice *device);
+
+    // figures for the last write()
+    qint64 milliseconds() const { return nMilliseconds; }
+    // the pixels of all the frames written, against as many whole boards
+    double fractionEncoded() const;
+
+private:
+    bool addPgn(const QString & path);
+
+    bool writeRaster(Format format, QIODevice *device);
+    bool writeSvg(QIODevice *device);
+    int delay(int frame) const { return frame == positions.count() - 1 ? nEndDelay : nDelay; }
+
+    QVector<Position> positions;
+    BoardStyle mStyle;
+    int nSquareSize;
+    int nDelay;
+    int nEndDelay;
+    int nThreads;
+    int nSkipped;
+
+    qint64 nMilliseconds;
+    qint64 nPixels;
+};
+
+#endif // ANIMATIONWRITER_H
@@ -0,0 +1,27 @@
+#include "annotationitem.h"
+
+#include <QtWidgets>
+#include "chessboard.h"
+#include "instrumentation.h"
+
+AnnotationItem::AnnotationItem(ChessBoard *board) :
+    board(board)
+{
+    setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+    setAcceptedMouseButtons(Qt::NoButton);
+    // over the pieces, under a piece being dragged
+    setZValue(0.5);
+}
+
+QRectF AnnotationItem::boundingRect() const
+{
+    return QRectF( 0, 0, 8 * board->squareSize(), 8 * board->squareSize() );
+}
+
+void AnnotationItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+    ScopedTimer timer("paint annotations");
+    board->annotations().paint( painter, board->squareSize() );
+}
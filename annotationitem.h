@@ -0,0 +1,24 @@
+#ifndef ANNOTATIONITEM_H
+#define ANNOTATIONITEM_H
+
+#include <QGraphicsItem>
+
+class ChessBoard;
+
+// The board's annotations, drawn over the squares and pieces. The item is
+// cached as a pixmap of its own, so the annotations are drawn again only
+// when they change: repainting squares beneath them blits the cache, and
+// changing them leaves the board's pixmaps alone.
+class AnnotationItem : public QGraphicsItem
+{
+public:
+    explicit AnnotationItem(ChessBoard *board);
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+    ChessBoard *board;
+};
+
+#endif // ANNOTATIONITEM_H
@@ -0,0 +1,298 @@
+#include "annotations.h"
+
+#include <QtCore>
+#include <QPainter>
+#include <QtMath>
+#include <string.h>
+
+static const char colorLetters[] = "GRYB";
+
+static QString squareName(int square)
+{
+    return QString("%1%2").arg( QChar('a' + square % 8) ).arg( 8 - square / 8 );
+}
+
+static int squareFromName(const QString & name)
+{
+    if( name.length() != 2 || name.at(0) < 'a' || name.at(0) > 'h' || name.at(1) < '1' || name.at(1) > '8' )
+        return -1;
+    return ( '8' - name.at(1).toLatin1() ) * 8 + ( name.at(0).toLatin1() - 'a' );
+}
+
+static int colorFromLetter(QChar c)
+{
+    const char *p = strchr( colorLetters, c.toLatin1() );
+    return c.isNull() || p == 0 ? -1 : p - colorLetters;
+}
+
+int Annotations::find(Kind kind, int square, int to) const
+{
+    for(int i=0; i<marks.count(); i++)
+        if( marks.at(i).kind == kind && marks.at(i).square == square && ( kind != Arrow || marks.at(i).to == to ) )
+            return i;
+    return -1;
+}
+
+void Annotations::toggle(Kind kind, int square, int to, Color color)
+{
+    int i = find(kind, square, to);
+    if( i >= 0 )
+    {
+        bool same = marks.at(i).color == color;
+        marks.removeAt(i);
+        if( same )
+            return;
+    }
+    Mark m;
+    m.kind = kind;
+    m.color = color;
+    m.square = square;
+    m.to = to;
+    marks << m;
+}
+
+void Annotations::toggleSquare(int square, Color color)
+{
+    toggle(Square, square, 0, color);
+}
+
+void Annotations::toggleCircle(int square, Color color)
+{
+    toggle(Circle, square, 0, color);
+}
+
+void Annotations::toggleArrow(int from, int to, Color color)
+{
+    if( from != to )
+        toggle(Arrow, from, to, color);
+}
+
+void Annotations::setText(int square, const QString & text, Color color)
+{
+    int i = find(Text, square, 0);
+    if( i >= 0 )
+        marks.removeAt(i);
+
+    // quotes and brackets would end the command in a file
+    QString t = text.trimmed();
+    t.remove('"');
+    t.remove(']');
+    if( t.isEmpty() )
+        return;
+    Mark m;
+    m.kind = Text;
+    m.color = color;
+    m.square = square;
+    m.to = 0;
+    m.text = t;
+    marks << m;
+}
+
+QString Annotations::text(int square) const
+{
+    int i = find(Text, square, 0);
+    return i < 0 ? QString() : marks.at(i).text;
+}
+
+void Annotations::clearSquare(int square)
+{
+    for(int i=marks.count()-1; i>=0; i--)
+        if( marks.at(i).square == square || ( marks.at(i).kind == Arrow && marks.at(i).to == square ) )
+            marks.removeAt(i);
+}
+
+QString Annotations::toString() const
+{
+    QStringList items[4];
+    foreach(const Mark & m, marks)
+    {
+        QString item = QChar( colorLetters[m.color] ) + squareName(m.square);
+        if( m.kind == Arrow )
+            item += squareName(m.to);
+        else if( m.kind == Text )
+            item += '"' + m.text + '"';
+        items[m.kind] << item;
+    }
+
+    const char * const commands[4] = { "csl", "ccl", "cal", "ctx" };
+    QString result;
+    for(int k=0; k<4; k++)
+        if( !items[k].isEmpty() )
+            result += QString("[%%1 %2]").arg(commands[k]).arg( items[k].join(',') );
+    return result;
+}
+
+Annotations Annotations::take(QString & text)
+{
+    Annotations result;
+    QRegularExpression command("\\[%(csl|ccl|cal|ctx)\\s+([^\\]]*)\\]");
+    QRegularExpression textMark("([GRYB])([a-h][1-8])\"([^\"]*)\"");
+
+    QRegularExpressionMatchIterator it = command.globalMatch(text);
+    while( it.hasNext() )
+    {
+        QRegularExpressionMatch match = it.next();
+        QString name = match.captured(1);
+        if( name == "ctx" )
+        {
+            QRegularExpressionMatchIterator marks = textMark.globalMatch( match.captured(2) );
+            while( marks.hasNext() )
+            {
+                QRegularExpressionMatch mark = marks.next();
+                result.setText( squareFromName(mark.captured(2)), mark.captured(3), (Color)colorFromLetter(mark.captured(1).at(0)) );
+            }
+            continue;
+        }
+
+        foreach(QString item, match.captured(2).split(',', Qt::SkipEmptyParts))
+        {
+            item = item.trimmed();
+            int color = colorFromLetter( item.value(0) );
+            int from = squareFromName( item.mid(1, 2) );
+            if( color < 0 || from < 0 )
+                continue;
+            if( name == "cal" )
+            {
+                int to = squareFromName( item.mid(3, 2) );
+                if( to >= 0 && result.find(Arrow, from, to) < 0 )
+                    result.toggleArrow(from, to, (Color)color);
+            }
+            else
+            {
+                Kind kind = name == "csl" ? Square : Circle;
+                if( result.find(kind, from, 0) < 0 )
+                    result.toggle(kind, from, 0, (Color)color);
+            }
+        }
+    }
+    text.remove(command);
+    return result;
+}
+
+QColor Annotations::color(Color c)
+{
+    switch(c)
+    {
+    case Red:
+        return QColor(0x88, 0x20, 0x20);
+    case Yellow:
+        return QColor(0xe6, 0x8f, 0x00);
+    case Blue:
+        return QColor(0x00, 0x30, 0x88);
+    case Green:
+    default:
+        return QColor(0x15, 0x78, 0x1b);
+    }
+}
+
+// a shaft and head from near the centre of one square to near the centre of the other
+QPolygonF Annotations::arrow(int from, int to, int squareSize)
+{
+    const qreal s = squareSize;
+    QPointF start( ( from % 8 + 0.5 ) * s, ( from / 8 + 0.5 ) * s );
+    QPointF end( ( to % 8 + 0.5 ) * s, ( to / 8 + 0.5 ) * s );
+    QPointF d = end - start;
+    qreal length = qSqrt( d.x() * d.x() + d.y() * d.y() );
+    d /= length;
+    QPointF n( -d.y(), d.x() );
+
+    QPointF tail = start + d * s * 0.2;
+    QPointF tip = end - d * s * 0.1;
+    QPointF base = tip - d * s * 0.4;
+    const qreal shaft = s * 0.09, head = s * 0.25;
+
+    QPolygonF p;
+    p << tail + n * shaft << base + n * shaft << base + n * head << tip
+      << base - n * head << base - n * shaft << tail - n * shaft;
+    return p;
+}
+
+void Annotations::paint(QPainter *painter, int squareSize) const
+{
+    const qreal s = squareSize;
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    for(int kind=Square; kind<=Text; kind++)
+    {
+        foreach(const Mark & m, marks)
+        {
+            if( m.kind != kind )
+                continue;
+            QColor c = color(m.color);
+            QRectF square( ( m.square % 8 ) * s, ( m.square / 8 ) * s, s, s );
+            if( kind == Square )
+            {
+                c.setAlphaF(0.5);
+                painter->fillRect(square, c);
+            }
+            else if( kind == Circle )
+            {
+                c.setAlphaF(0.8);
+                painter->setPen( QPen(c, s * 0.08) );
+                painter->setBrush(Qt::NoBrush);
+                painter->drawEllipse( square.adjusted(s * 0.08, s * 0.08, -s * 0.08, -s * 0.08) );
+            }
+            else if( kind == Arrow )
+            {
+                c.setAlphaF(0.8);
+                painter->setPen(Qt::NoPen);
+                painter->setBrush(c);
+                painter->drawPolygon( arrow(m.square, m.to, squareSize) );
+            }
+            else
+            {
+                QFont font;
+                font.setBold(true);
+                font.setPixelSize( qMax(1, qRound(s * 0.45)) );
+                painter->setFont(font);
+                painter->setPen(c);
+                painter->drawText(square, Qt::AlignCenter, m.text);
+            }
+        }
+    }
+    painter->restore();
+}
+
+QByteArray Annotations::toSvg(int squareSize) const
+{
+    if( marks.isEmpty() )
+        return QByteArray();
+
+    const qreal s = squareSize;
+    QByteArray svg = "<g id=\"annotations\">\n";
+    for(int kind=Square; kind<=Text; kind++)
+    {
+        foreach(const Mark & m, marks)
+        {
+            if( m.kind != kind )
+                continue;
+            QByteArray fill = color(m.color).name().toLatin1();
+            QByteArray x = QByteArray::number( ( m.square % 8 ) * s ), y = QByteArray::number( ( m.square / 8 ) * s );
+            QByteArray cx = QByteArray::number( ( m.square % 8 + 0.5 ) * s ), cy = QByteArray::number( ( m.square / 8 + 0.5 ) * s );
+            if( kind == Square )
+            {
+                svg += "<rect x=\"" + x + "\" y=\"" + y + "\" width=\"" + QByteArray::number(s) + "\" height=\"" + QByteArray::number(s)
+                        + "\" fill=\"" + fill + "\" fill-opacity=\"0.5\"/>\n";
+            }
+            else if( kind == Circle )
+            {
+                svg += "<circle cx=\"" + cx + "\" cy=\"" + cy + "\" r=\"" + QByteArray::number(s * 0.42) + "\" fill=\"none\" stroke=\"" + fill
+                        + "\" stroke-width=\"" + QByteArray::number(s * 0.08) + "\" stroke-opacity=\"0.8\"/>\n";
+            }
+            else if( kind == Arrow )
+            {
+                QByteArray points;
+                foreach(QPointF p, arrow(m.square, m.to, squareSize))
+                    points += QByteArray::number(p.x(), 'f', 2) + "," + QByteArray::number(p.y(), 'f', 2) + " ";
+                svg += "<polygon points=\"" + points.trimmed() + "\" fill=\"" + fill + "\" fill-opacity=\"0.8\"/>\n";
+            }
+            else
+            {
+                svg += "<text x=\"" + cx + "\" y=\"" + cy + "\" font-family=\"sans-serif\" font-weight=\"bold\" font-size=\"" + QByteArray::number(s * 0.45)
+                        + "\" text-anchor=\"middle\" dominant-baseline=\"central\" fill=\"" + fill + "\">" + m.text.toHtmlEscaped().toUtf8() + "</text>\n";
+            }
+        }
+    }
+    svg += "</g>\n";
+    return svg;
+}
@@ -0,0 +1,66 @@
+#ifndef ANNOTATIONS_H
+#define ANNOTATIONS_H
+
+#include <QList>
+#include <QString>
+#include <QColor>
+#include <QPolygonF>
+
+class QPainter;
+
+// Arrows, coloured squares, circles and text marks drawn over a board.
+// Squares are numbered as in Position, row * 8 + column from a8.
+//
+// In files they are written as the comment commands most chess programs
+// read, [%csl Gd4,Re5] for squares and [%cal Ge2e4] for arrows, with
+// [%ccl Bf7] for circles and [%ctx Yd4"A"] for text marks, which other
+// programs pass over. The colours are G, R, Y and B.
+class Annotations
+{
+public:
+    enum Color { Green, Red, Yellow, Blue };
+    enum Kind { Square, Circle, Arrow, Text };
+
+    struct Mark
+    {
+        Kind kind;
+        Color color;
+        quint8 square;
+        quint8 to;      // arrows only
+        QString text;   // text marks only
+    };
+
+    bool isEmpty() const { return marks.isEmpty(); }
+    void clear() { marks.clear(); }
+    const QList<Mark> & list() const { return marks; }
+
+    // each adds the mark, or removes it if the same mark is already there;
+    // a mark of another colour on the same square or arrow is replaced
+    void toggleSquare(int square, Color color);
+    void toggleCircle(int square, Color color);
+    void toggleArrow(int from, int to, Color color);
+    // an empty text removes the mark
+    void setText(int square, const QString & text, Color color);
+    QString text(int square) const;
+    // removes every mark on the square, and arrows from or to it
+    void clearSquare(int square);
+
+    QString toString() const;
+    // takes the commands out of text, leaving the rest of it
+    static Annotations take(QString & text);
+
+    void paint(QPainter *painter, int squareSize) const;
+    // elements to go over a board squareSize * 8 units wide
+    QByteArray toSvg(int squareSize) const;
+
+    static QColor color(Color c);
+
+private:
+    int find(Kind kind, int square, int to) const;
+    void toggle(Kind kind, int square, int to, Color color);
+    static QPolygonF arrow(int from, int to, int squareSize);
+
+    QList<Mark> marks;
+};
+
+#endif // ANNOTATIONS_H
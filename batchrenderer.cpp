@@ -0,0 +1,168 @@
+#include "batchrenderer.h"
+
+#include <QtCore>
+#include "piecerenderercache.h"
+#include "position.h"
+#include "tiledpngwriter.h"
+
+class BatchWorker : public QRunnable
+{
+public:
+    BatchWorker(const QList<BatchRenderer::Job> & jobs, QAtomicInt *next, QAtomicInt *failed, QAtomicInteger<qint64> *bytes, QAtomicInteger<qint64> *sceneNsecs, QAtomicInteger<qint64> *writeNsecs, bool sceneSvg, int pngSize, int dpi, const BoardStyle & style)
+        : jobs(jobs), next(next), failed(failed), bytes(bytes), sceneNsecs(sceneNsecs), writeNsecs(writeNsecs), bSceneSvg(sceneSvg), nPngSize(pngSize), nDpi(dpi), style(style) { }
+
+    void run();
+
+private:
+    const QList<BatchRenderer::Job> & jobs;
+    QAtomicInt *next;
+    QAtomicInt *failed;
+    QAtomicInteger<qint64> *bytes;
+    QAtomicInteger<qint64> *sceneNsecs;
+    QAtomicInteger<qint64> *writeNsecs;
+    bool bSceneSvg;
+    int nPngSize;
+    int nDpi;
+    BoardStyle style;
+};
+
+void BatchWorker::run()
+{
+    // one scene per worker thread; it lives and dies on this thread
+    ChessBoard board;
+    board.setStyle(style);
+    board.setSvgRender(true);
+
+    // positions are already spread over the threads, so each image is drawn on one
+    TiledPngWriter png;
+    png.setSize( QSize(nPngSize, nPngSize) );
+    png.setDotsPerInch(nDpi);
+    png.setThreadCount(1);
+
+    int i;
+    while( (i = next->fetchAndAddRelaxed(1)) < jobs.count() )
+    {
+        const BatchRenderer::Job & job = jobs.at(i);
+
+        CollectionEntry entry;
+        if( !job.item.read(&entry) )
+        {
+            failed->ref();
+            continue;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        board.setPosition(entry.position);
+        sceneNsecs->fetchAndAddRelaxed( timer.nsecsElapsed() );
+
+        QFile output(job.output);
+        if(!output.open(QFile::WriteOnly))
+        {
+            qDebug() << "Could not open:" << job.output;
+            failed->ref();
+            continue;
+        }
+        bool written;
+        timer.restart();
+        if( nPngSize > 0 )
+            written = png.write(&board, &output);
+        else
+            written = bSceneSvg ? board.writeSceneSvg(&output) : board.writeSvg(&output);
+        writeNsecs->fetchAndAddRelaxed( timer.nsecsElapsed() );
+        if( written )
+            bytes->fetchAndAddRelaxed( output.size() );
+        else
+            failed->ref();
+    }
+}
+
+BatchRenderer::BatchRenderer()
+{
+    nThreads = QThread::idealThreadCount();
+    bSceneSvg = false;
+    nPngSize = 0;
+    nDpi = 600;
+}
+
+bool BatchRenderer::addInput(const QString & path)
+{
+    int first = source.items().count();
+    if( !source.addInput(path) )
+        return false;
+
+    for(int i=first; i<source.items().count(); i++)
+    {
+        Job job;
+        job.item = source.items().at(i);
+        QString name = QFileInfo(job.item.path).completeBaseName();
+        if( job.item.collection != 0 )
+        {
+            // padded, so that the files sort in the collection's order
+            int digits = QString::number(job.item.collection->count()).length();
+            job.output = outputFilename( QString("%1-%2").arg(name).arg(job.item.number, digits, 10, QChar('0')) );
+        }
+        else if( job.item.number > 0 )
+        {
+            job.output = outputFilename( QString("%1-%2").arg(name).arg(job.item.number) );
+        }
+        else
+        {
+            job.output = outputFilename(name);
+        }
+        jobs << job;
+    }
+    return true;
+}
+
+QString BatchRenderer::outputFilename(const QString & baseName)
+{
+    QString name = baseName;
+    int n = 1;
+    while( usedNames.contains(name) )
+        name = QString("%1-%2").arg(baseName).arg(++n);
+    usedNames << name;
+    return QDir(sOutputDirectory).absoluteFilePath( name + ( nPngSize > 0 ? ".png" : ".svg" ) );
+}
+
+int BatchRenderer::render(QTextStream & report)
+{
+    QDir().mkpath(sOutputDirectory);
+
+    QAtomicInt next(0);
+    nFailed = 0;
+    nBytes = 0;
+    nSceneNsecs = 0;
+    nWriteNsecs = 0;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(nThreads);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<nThreads; i++)
+        pool.start( new BatchWorker(jobs, &next, &nFailed, &nBytes, &nSceneNsecs, &nWriteNsecs, bSceneSvg, nPngSize, nDpi, mStyle) );
+    pool.waitForDone();
+    qint64 elapsed = timer.elapsed();
+
+    int rendered = jobs.count() - nFailed.load();
+    report << QString("Rendered %1 of %2 positions in %3 ms on %4 threads (%5 positions/s, %6 piece files parsed)")
+              .arg(rendered).arg(jobs.count()).arg(elapsed).arg(nThreads)
+              .arg( elapsed > 0 ? rendered * 1000.0 / elapsed : 0.0, 0, 'f', 1 )
+              .arg( PieceRendererCache::parseCount() ) << Qt::endl;
+    report << QString("Wrote %1 bytes (%2 bytes per diagram) with the %3 writer")
+              .arg(nBytes.load()).arg( rendered > 0 ? nBytes.load() / rendered : 0 )
+              .arg( nPngSize > 0 ? "PNG" : ( bSceneSvg ? "scene" : "compact" ) ) << Qt::endl;
+    // summed over the threads: the time to rebuild the scene for each position, and to write it out
+    if( jobs.count() > 0 )
+        report << QString("Scene rebuilds %1 ms (%2 us per position), writing %3 ms (%4 us per position)")
+                  .arg( nSceneNsecs.load() / 1000000 ).arg( nSceneNsecs.load() / 1000 / jobs.count() )
+                  .arg( nWriteNsecs.load() / 1000000 ).arg( nWriteNsecs.load() / 1000 / jobs.count() ) << Qt::endl;
+    if( nPngSize > 0 && rendered > 0 )
+    {
+        double megapixels = (double)nPngSize * nPngSize * rendered / 1e6;
+        report << QString("%1 megapixels, %2 ms per megapixel")
+                  .arg(megapixels, 0, 'f', 1).arg( elapsed * nThreads / megapixels, 0, 'f', 1 ) << Qt::endl;
+    }
+
+    return nFailed.load();
+}
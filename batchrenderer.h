@@ -0,0 +1,59 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QStringList>
+#include <QSet>
+#include <QColor>
+#include <QAtomicInteger>
+
+#include "chessboard.h"
+#include "positionsource.h"
+
+class QTextStream;
+
+class BatchRenderer
+{
+public:
+    struct Job
+    {
+        PositionSource::Item item;
+        QString output;
+    };
+
+    BatchRenderer();
+
+    bool addInput(const QString & path);
+    void setOutputDirectory(const QString & dir) { sOutputDirectory = dir; }
+    void setThreadCount(int n) { nThreads = n; }
+    void setSceneSvg(bool v) { bSceneSvg = v; }
+    // a width in pixels writes PNG instead of SVG; 0 writes SVG
+    void setPngSize(int pixels) { nPngSize = pixels; }
+    void setDotsPerInch(int dpi) { nDpi = dpi; }
+
+    void setStyle(const BoardStyle & style) { mStyle = style; }
+
+    int jobCount() const { return jobs.count(); }
+
+    int render(QTextStream & report);
+
+private:
+    QString outputFilename(const QString & baseName);
+
+    PositionSource source;
+    QList<Job> jobs;
+    QSet<QString> usedNames;
+    QString sOutputDirectory;
+    int nThreads;
+    bool bSceneSvg;
+    int nPngSize;
+    int nDpi;
+
+    BoardStyle mStyle;
+
+    QAtomicInt nFailed;
+    QAtomicInteger<qint64> nBytes;
+    QAtomicInteger<qint64> nSceneNsecs;
+    QAtomicInteger<qint64> nWriteNsecs;
+};
+
+#endif // BATCHRENDERER_H
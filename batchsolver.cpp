@@ -0,0 +1,116 @@
+#include "batchsolver.h"
+
+#include <QtCore>
+
+class SolveWorker : public QRunnable
+{
+public:
+    SolveWorker(const QList<PositionSource::Item> & jobs, QVector<QString> *lines, QVector<MateResult> *results, QAtomicInt *next, MateSolver *solver, int maxMoves)
+        : jobs(jobs), lines(lines), results(results), next(next), solver(solver), nMaxMoves(maxMoves) { }
+
+    void run();
+
+private:
+    const QList<PositionSource::Item> & jobs;
+    QVector<QString> *lines;
+    QVector<MateResult> *results;
+    QAtomicInt *next;
+    MateSolver *solver;
+    int nMaxMoves;
+};
+
+void SolveWorker::run()
+{
+    int i;
+    while( (i = next->fetchAndAddRelaxed(1)) < jobs.count() )
+    {
+        const PositionSource::Item & job = jobs.at(i);
+
+        CollectionEntry entry;
+        if( !job.read(&entry) )
+        {
+            (*lines)[i] = QString("%1: could not read the position").arg(job.name());
+            continue;
+        }
+        const Position & position = entry.position;
+        const Piece::Color side = entry.sideToMove;
+
+        BitboardPosition board;
+        board.setPosition(position, side);
+        QStringList problems = BitboardPosition::problems(position, side);
+        if( !problems.isEmpty() )
+        {
+            (*lines)[i] = QString("%1: not legal: %2").arg(job.name()).arg(problems.join(" "));
+            continue;
+        }
+
+        MateResult result = solver->solve(board, nMaxMoves);
+        (*results)[i] = result;
+
+        QStringList keys;
+        foreach(BitboardPosition::Move m, result.keys)
+            keys << board.moveToSan(m);
+        if( result.mateIn == 0 )
+            (*lines)[i] = QString("%1: no mate in %2 or fewer").arg(job.name()).arg(nMaxMoves);
+        else if( result.isUnique() )
+            (*lines)[i] = QString("%1: mate in %2, key %3").arg(job.name()).arg(result.mateIn).arg(keys.first());
+        else
+            (*lines)[i] = QString("%1: cooked, mate in %2 by %3").arg(job.name()).arg(result.mateIn).arg(keys.join(", "));
+    }
+}
+
+BatchSolver::BatchSolver()
+{
+    nThreads = QThread::idealThreadCount();
+    nMaxMoves = 3;
+}
+
+bool BatchSolver::addInput(const QString & path)
+{
+    return source.addInput(path);
+}
+
+int BatchSolver::solve(QTextStream & report)
+{
+    const QList<PositionSource::Item> & jobs = source.items();
+    QVector<QString> lines( jobs.count() );
+    QVector<MateResult> results( jobs.count() );
+    QAtomicInt next(0);
+
+    // whole positions are shared out, so each search runs on a single thread;
+    // the transposition table is shared by all of them
+    MateSolver solver;
+    solver.setThreadCount(1);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(nThreads);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<nThreads; i++)
+        pool.start( new SolveWorker(jobs, &lines, &results, &next, &solver, nMaxMoves) );
+    pool.waitForDone();
+    qint64 elapsed = timer.elapsed();
+
+    int unreadable = 0, cooked = 0, unsolved = 0;
+    quint64 nodes = 0;
+    for(int i=0; i<jobs.count(); i++)
+    {
+        report << lines.at(i) << Qt::endl;
+        if( results.at(i).nodes == 0 )
+            unreadable++;
+        else if( results.at(i).mateIn == 0 )
+            unsolved++;
+        else if( !results.at(i).isUnique() )
+            cooked++;
+        nodes += results.at(i).nodes;
+    }
+
+    report << QString("Solved %1 positions in %2 ms on %3 threads (%4 positions/s, %5 nodes/s): %6 cooked, %7 without mate, %8 unreadable or not legal")
+              .arg(jobs.count()).arg(elapsed).arg(nThreads)
+              .arg( elapsed > 0 ? jobs.count() * 1000.0 / elapsed : 0.0, 0, 'f', 1 )
+              .arg( elapsed > 0 ? nodes * 1000.0 / elapsed : 0.0, 0, 'f', 0 )
+              .arg(cooked).arg(unsolved).arg(unreadable) << Qt::endl;
+
+    return unreadable;
+}
@@ -0,0 +1,35 @@
+#ifndef BATCHSOLVER_H
+#define BATCHSOLVER_H
+
+#include <QStringList>
+#include <QVector>
+
+#include "matesolver.h"
+#include "positionsource.h"
+
+class QTextStream;
+
+// Runs the mate solver over many positions, one position per thread, and
+// reports each one in input order.
+class BatchSolver
+{
+public:
+    BatchSolver();
+
+    // a collection (.chc), a .chs file, a directory of them or a list file, as PositionSource reads them
+    bool addInput(const QString & path);
+    void setThreadCount(int n) { nThreads = n; }
+    void setMaxMoves(int n) { nMaxMoves = n; }
+
+    int jobCount() const { return source.items().count(); }
+
+    // returns the number of positions that could not be read
+    int solve(QTextStream & report);
+
+private:
+    PositionSource source;
+    int nThreads;
+    int nMaxMoves;
+};
+
+#endif // BATCHSOLVER_H
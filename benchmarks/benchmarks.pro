@@ -0,0 +1,41 @@
+# Benchmarks of the board model, the scene and the SVG export. Run with
+# -platform offscreen where there is no display; "-o results.xml,xml" or
+# "-o results.csv,csv" writes the figures in a form that can be compared
+# from build to build.
+
+QT       += core gui svg widgets testlib
+
+TARGET = benchmarks
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += tst_benchmarks.cpp \
+    ../chessboard.cpp \
+    ../boarditem.cpp \
+    ../annotations.cpp \
+    ../annotationitem.cpp \
+    ../piecerenderercache.cpp \
+    ../piecetheme.cpp \
+    ../piecepixmapcache.cpp \
+    ../svgboardwriter.cpp \
+    ../position.cpp \
+    ../zobrist.cpp \
+    ../instrumentation.cpp
+
+HEADERS += ../chessboard.h \
+    ../boarditem.h \
+    ../annotations.h \
+    ../annotationitem.h \
+    ../piecerenderercache.h \
+    ../piecetheme.h \
+    ../piecepixmapcache.h \
+    ../svgboardwriter.h \
+    ../position.h \
+    ../zobrist.h \
+    ../instrumentation.h \
+    ../piece.h
+
+RESOURCES += ../resources.qrc
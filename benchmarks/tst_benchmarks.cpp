@@ -0,0 +1,174 @@
+#include <QtTest>
+#include <QBuffer>
+
+#include "chessboard.h"
+#include "position.h"
+
+static const char * const initialFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w";
+static const char * const middlegameFen = "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R2QKB1R w";
+
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void setInitialPositions();
+    void colorChanges_data();
+    void colorChanges();
+    void setVersion();
+    void createSvg_data();
+    void createSvg();
+    void svgSize_data();
+    void svgSize();
+
+private:
+    static QString chs(const char *fen);
+};
+
+QString Benchmarks::chs(const char *fen)
+{
+    Position p;
+    p.parse( QString(fen) );
+    return p.toChs();
+}
+
+void Benchmarks::roundTrip_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("empty") << Position().toChs();
+    QTest::newRow("initial chs") << chs(initialFen);
+    QTest::newRow("middlegame chs") << chs(middlegameFen);
+    // every piece of both colours, knights next to kings
+    QTest::newRow("knights and kings") << chs("nk6/KN6/8/8/8/8/8/qrbpQRBP w");
+}
+
+void Benchmarks::roundTrip()
+{
+    QFETCH(QString, text);
+
+    ChessBoard board;
+    QString result;
+    QBENCHMARK
+    {
+        board.fromString(text);
+        result = board.toString();
+    }
+    QCOMPARE(result, text);
+
+    // and through FEN
+    QVERIFY( board.fromString( board.position().toFen() ) );
+    QCOMPARE(board.toString(), text);
+}
+
+void Benchmarks::setInitialPositions()
+{
+    ChessBoard board;
+    QBENCHMARK
+    {
+        board.clearBoard();
+        board.setInitialPositions();
+    }
+    QCOMPARE(board.toString(), chs(initialFen));
+}
+
+void Benchmarks::colorChanges_data()
+{
+    QTest::addColumn<bool>("pieces");
+
+    QTest::newRow("piece colours") << true;
+    QTest::newRow("square colours") << false;
+}
+
+void Benchmarks::colorChanges()
+{
+    QFETCH(bool, pieces);
+
+    ChessBoard board;
+    board.setInitialPositions();
+    int n = 0;
+    QBENCHMARK
+    {
+        // two colours in turn, so that after the first round the tinted pieces are cached
+        QColor c = n++ % 2 ? QColor("#804000") : QColor("#004080");
+        if( pieces )
+        {
+            board.setLightPieceColor(c);
+            board.setDarkPieceColor(c);
+        }
+        else
+        {
+            board.setLightSquareColor(c);
+            board.setDarkSquareColor(c);
+        }
+    }
+}
+
+void Benchmarks::setVersion()
+{
+    ChessBoard board;
+    board.setInitialPositions();
+    QBENCHMARK
+    {
+        board.setVersion( (quint32)ChessBoard::Secular );
+        board.setVersion( (quint32)ChessBoard::Traditional );
+    }
+    QCOMPARE(board.version(), ChessBoard::Traditional);
+}
+
+void Benchmarks::createSvg_data()
+{
+    QTest::addColumn<QString>("position");
+    QTest::addColumn<bool>("scene");
+
+    QTest::newRow("empty") << QString("8/8/8/8/8/8/8/8 w") << false;
+    QTest::newRow("initial") << QString(initialFen) << false;
+    QTest::newRow("middlegame") << QString(middlegameFen) << false;
+    QTest::newRow("empty, scene") << QString("8/8/8/8/8/8/8/8 w") << true;
+    QTest::newRow("initial, scene") << QString(initialFen) << true;
+    QTest::newRow("middlegame, scene") << QString(middlegameFen) << true;
+}
+
+void Benchmarks::createSvg()
+{
+    QFETCH(QString, position);
+    QFETCH(bool, scene);
+
+    ChessBoard board;
+    QVERIFY( board.fromString(position) );
+    QBuffer buffer;
+    QBENCHMARK
+    {
+        buffer.close();
+        buffer.setData( QByteArray() );
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY( scene ? board.writeSceneSvg(&buffer) : board.writeSvg(&buffer) );
+    }
+    QVERIFY( buffer.data().startsWith("<?xml") );
+}
+
+void Benchmarks::svgSize_data()
+{
+    createSvg_data();
+}
+
+// the size of each SVG, reported as a benchmark result so that it is in the
+// XML and CSV output alongside the times
+void Benchmarks::svgSize()
+{
+    QFETCH(QString, position);
+    QFETCH(bool, scene);
+
+    ChessBoard board;
+    QVERIFY( board.fromString(position) );
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY( scene ? board.writeSceneSvg(&buffer) : board.writeSvg(&buffer) );
+    QTest::setBenchmarkResult( buffer.data().size(), QTest::BytesAllocated );
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "tst_benchmarks.moc"
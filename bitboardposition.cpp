@@ -0,0 +1,679 @@
+#include "bitboardposition.h"
+
+#include <QtAlgorithms>
+#include "zobrist.h"
+#include <string.h>
+
+static inline Bitboard bit(int square) { return Q_UINT64_C(1) << square; }
+static inline int lowestSquare(Bitboard b) { return qCountTrailingZeroBits(b); }
+static inline int highestSquare(Bitboard b) { return 63 - qCountLeadingZeroBits(b); }
+static inline int popLowest(Bitboard & b) { int s = lowestSquare(b); b &= b - 1; return s; }
+static inline int count(Bitboard b) { return qPopulationCount(b); }
+
+// rays are indexed N, NE, E, NW (increasing squares), then S, SW, W, SE
+enum { North, NorthEast, East, NorthWest, South, SouthWest, West, SouthEast };
+static const int rayStep[8][2] = { {1,0}, {1,1}, {0,1}, {1,-1}, {-1,0}, {-1,-1}, {0,-1}, {-1,1} };
+
+struct AttackTables
+{
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[2][64];
+    Bitboard ray[8][64];
+
+    AttackTables()
+    {
+        static const int knightSteps[8][2] = { {-2,-1}, {-2,1}, {-1,-2}, {-1,2}, {1,-2}, {1,2}, {2,-1}, {2,1} };
+        for(int s=0; s<64; s++)
+        {
+            int r = s / 8, f = s % 8;
+            knight[s] = king[s] = pawn[0][s] = pawn[1][s] = 0;
+            for(int i=0; i<8; i++)
+            {
+                int kr = r + knightSteps[i][0], kf = f + knightSteps[i][1];
+                if( kr >= 0 && kr < 8 && kf >= 0 && kf < 8 )
+                    knight[s] |= bit(kr * 8 + kf);
+                kr = r + rayStep[i][0];
+                kf = f + rayStep[i][1];
+                if( kr >= 0 && kr < 8 && kf >= 0 && kf < 8 )
+                    king[s] |= bit(kr * 8 + kf);
+            }
+            for(int df=-1; df<=1; df+=2)
+            {
+                if( f + df < 0 || f + df > 7 )
+                    continue;
+                if( r < 7 )
+                    pawn[Piece::White][s] |= bit( (r + 1) * 8 + f + df );
+                if( r > 0 )
+                    pawn[Piece::Black][s] |= bit( (r - 1) * 8 + f + df );
+            }
+            for(int d=0; d<8; d++)
+            {
+                ray[d][s] = 0;
+                int rr = r + rayStep[d][0], rf = f + rayStep[d][1];
+                while( rr >= 0 && rr < 8 && rf >= 0 && rf < 8 )
+                {
+                    ray[d][s] |= bit(rr * 8 + rf);
+                    rr += rayStep[d][0];
+                    rf += rayStep[d][1];
+                }
+            }
+        }
+    }
+};
+
+static const AttackTables & tables()
+{
+    static const AttackTables t;
+    return t;
+}
+
+static inline Bitboard rayAttacks(const AttackTables & t, int d, int square, Bitboard occupied)
+{
+    Bitboard attacks = t.ray[d][square];
+    Bitboard blockers = attacks & occupied;
+    if( blockers )
+        attacks ^= t.ray[d][ d < South ? lowestSquare(blockers) : highestSquare(blockers) ];
+    return attacks;
+}
+
+static inline Bitboard rookAttacks(const AttackTables & t, int square, Bitboard occupied)
+{
+    return rayAttacks(t, North, square, occupied) | rayAttacks(t, East, square, occupied)
+            | rayAttacks(t, South, square, occupied) | rayAttacks(t, West, square, occupied);
+}
+
+static inline Bitboard bishopAttacks(const AttackTables & t, int square, Bitboard occupied)
+{
+    return rayAttacks(t, NorthEast, square, occupied) | rayAttacks(t, NorthWest, square, occupied)
+            | rayAttacks(t, SouthEast, square, occupied) | rayAttacks(t, SouthWest, square, occupied);
+}
+
+// Position numbers squares from the top row down
+static inline int toPositionSquare(int square) { return ( 7 - square / 8 ) * 8 + square % 8; }
+
+// the piece keys rearranged by colour, type and bitboard square, for put() and remove()
+struct PieceKeys
+{
+    PieceKeys()
+    {
+        const ZobristKeys & z = zobristKeys();
+        for(int c=0; c<2; c++)
+            for(int t=0; t<6; t++)
+                for(int s=0; s<64; s++)
+                    keys[c][t][s] = z.square[ toPositionSquare(s) ][ c * 8 + t + 1 ];
+    }
+
+    quint64 keys[2][6][64];
+};
+
+static const PieceKeys pieceKeys;
+
+BitboardPosition::BitboardPosition()
+{
+    memset(bbPieces, 0, sizeof(bbPieces));
+    bbColor[0] = bbColor[1] = bbAll = 0;
+    eSide = Piece::White;
+    nCastling = 0;
+    nEnPassant = -1;
+    nKey = 0;
+}
+
+void BitboardPosition::put(int square, Piece::Color c, Piece::Type t)
+{
+    bbPieces[c][t] |= bit(square);
+    bbColor[c] |= bit(square);
+    bbAll |= bit(square);
+    nKey ^= pieceKeys.keys[c][t][square];
+}
+
+void BitboardPosition::remove(int square, Piece::Color c, Piece::Type t)
+{
+    bbPieces[c][t] &= ~bit(square);
+    bbColor[c] &= ~bit(square);
+    bbAll &= ~bit(square);
+    nKey ^= pieceKeys.keys[c][t][square];
+}
+
+void BitboardPosition::computeKey()
+{
+    const ZobristKeys & z = zobristKeys();
+    nKey = position().key(eSide) ^ z.castling[nCastling];
+    if( nEnPassant >= 0 )
+        nKey ^= z.enPassant[nEnPassant % 8];
+}
+
+Piece::Type BitboardPosition::typeOn(int square, Piece::Color c) const
+{
+    for(int t=0; t<6; t++)
+        if( bbPieces[c][t] & bit(square) )
+            return (Piece::Type)t;
+    return Piece::None;
+}
+
+Piece BitboardPosition::pieceOn(int square) const
+{
+    for(int c=0; c<2; c++)
+    {
+        Piece::Type t = typeOn(square, (Piece::Color)c);
+        if( t != Piece::None )
+            return Piece(t, (Piece::Color)c);
+    }
+    return Piece();
+}
+
+void BitboardPosition::setPosition(const Position & p, Piece::Color sideToMove)
+{
+    *this = BitboardPosition();
+    for(int s=0; s<64; s++)
+    {
+        Piece piece = Position::pieceFromCode( p.code( toPositionSquare(s) ) );
+        if( piece.type() != Piece::None )
+            put(s, piece.color(), piece.type());
+    }
+    eSide = sideToMove;
+
+    if( bbPieces[Piece::White][Piece::King] & bit(4) )
+    {
+        if( bbPieces[Piece::White][Piece::Rook] & bit(7) )
+            nCastling |= WhiteShort;
+        if( bbPieces[Piece::White][Piece::Rook] & bit(0) )
+            nCastling |= WhiteLong;
+    }
+    if( bbPieces[Piece::Black][Piece::King] & bit(60) )
+    {
+        if( bbPieces[Piece::Black][Piece::Rook] & bit(63) )
+            nCastling |= BlackShort;
+        if( bbPieces[Piece::Black][Piece::Rook] & bit(56) )
+            nCastling |= BlackLong;
+    }
+    computeKey();
+}
+
+bool BitboardPosition::setFen(const char *fen, int length)
+{
+    Position p;
+    Piece::Color side;
+    if( !p.parseFen(fen, length, &side) )
+        return false;
+    // a pawn on the first or last rank has nowhere to go
+    for(int j=0; j<8; j++)
+        if( p.at(0, j).type() == Piece::Pawn || p.at(7, j).type() == Piece::Pawn )
+            return false;
+    setPosition(p, side);
+
+    // castling and en passant fields: skip the placement and side to move;
+    // a right is dropped if its king or rook is not at home
+    int possible = nCastling;
+    int i = 0, field = 0;
+    nCastling = 0;
+    while( i < length && field < 4 )
+    {
+        while( i < length && fen[i] == ' ' )
+            i++;
+        int start = i;
+        while( i < length && fen[i] != ' ' )
+            i++;
+        if( i == start )
+            break;
+        field++;
+        if( field == 3 )
+        {
+            for(int k=start; k<i; k++)
+            {
+                switch(fen[k])
+                {
+                case 'K': nCastling |= WhiteShort; break;
+                case 'Q': nCastling |= WhiteLong; break;
+                case 'k': nCastling |= BlackShort; break;
+                case 'q': nCastling |= BlackLong; break;
+                default: break;
+                }
+            }
+        }
+        else if( field == 4 && i - start == 2 )
+        {
+            int f = fen[start] - 'a', r = fen[start+1] - '1';
+            if( f >= 0 && f < 8 && r >= 0 && r < 8 )
+                nEnPassant = r * 8 + f;
+        }
+    }
+    nCastling &= possible;
+    computeKey();
+    return true;
+}
+
+void BitboardPosition::setStartingPosition()
+{
+    static const char fen[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    setFen( fen, sizeof(fen) - 1 );
+}
+
+Position BitboardPosition::position() const
+{
+    Position p;
+    for(int s=0; s<64; s++)
+        p.setCode( toPositionSquare(s), Position::codeFromPiece( pieceOn(s) ) );
+    return p;
+}
+
+int BitboardPosition::kingSquare(Piece::Color c) const
+{
+    Bitboard k = bbPieces[c][Piece::King];
+    return k ? lowestSquare(k) : -1;
+}
+
+bool BitboardPosition::isAttacked(int square, Piece::Color by) const
+{
+    const AttackTables & t = tables();
+    const Bitboard *p = bbPieces[by];
+    if( t.knight[square] & p[Piece::Knight] )
+        return true;
+    if( t.king[square] & p[Piece::King] )
+        return true;
+    // squares from which a pawn of colour by attacks square are those a pawn of the other colour would attack
+    if( t.pawn[opponent(by)][square] & p[Piece::Pawn] )
+        return true;
+    if( bishopAttacks(t, square, bbAll) & ( p[Piece::Bishop] | p[Piece::Queen] ) )
+        return true;
+    if( rookAttacks(t, square, bbAll) & ( p[Piece::Rook] | p[Piece::Queen] ) )
+        return true;
+    return false;
+}
+
+bool BitboardPosition::inCheck() const
+{
+    int k = kingSquare(eSide);
+    return k >= 0 && isAttacked(k, opponent(eSide));
+}
+
+static inline void addMove(BitboardPosition::Move *moves, int & n, int from, int to, int flags, int promotion = Piece::None)
+{
+    moves[n].from = from;
+    moves[n].to = to;
+    moves[n].promotion = promotion;
+    moves[n].flags = flags;
+    n++;
+}
+
+int BitboardPosition::pseudoLegalMoves(Move *moves) const
+{
+    const AttackTables & t = tables();
+    const Piece::Color us = eSide, them = opponent(eSide);
+    const Bitboard own = bbColor[us], enemy = bbColor[them], empty = ~bbAll;
+    int n = 0;
+
+    // pawns
+    const int forward = us == Piece::White ? 8 : -8;
+    const int startRank = us == Piece::White ? 1 : 6;
+    const int lastRank = us == Piece::White ? 7 : 0;
+    Bitboard pawns = bbPieces[us][Piece::Pawn];
+    while( pawns )
+    {
+        int from = popLowest(pawns);
+        // only setPosition() lets a pawn onto its last rank, and it cannot move from there
+        if( from / 8 == lastRank )
+            continue;
+        int to = from + forward;
+        Bitboard targets = 0;
+        if( empty & bit(to) )
+        {
+            targets |= bit(to);
+            if( from / 8 == startRank && ( empty & bit(to + forward) ) )
+                addMove(moves, n, from, to + forward, DoublePush);
+        }
+        targets |= t.pawn[us][from] & enemy;
+        while( targets )
+        {
+            int target = popLowest(targets);
+            int flags = ( enemy & bit(target) ) ? Capture : 0;
+            if( target / 8 == lastRank )
+            {
+                addMove(moves, n, from, target, flags, Piece::Queen);
+                addMove(moves, n, from, target, flags, Piece::Rook);
+                addMove(moves, n, from, target, flags, Piece::Bishop);
+                addMove(moves, n, from, target, flags, Piece::Knight);
+            }
+            else
+            {
+                addMove(moves, n, from, target, flags);
+            }
+        }
+        if( nEnPassant >= 0 && ( t.pawn[us][from] & bit(nEnPassant) ) )
+            addMove(moves, n, from, nEnPassant, Capture | EnPassant);
+    }
+
+    // pieces
+    for(int type = Piece::King; type <= Piece::Rook; type++)
+    {
+        Bitboard pieces = bbPieces[us][type];
+        while( pieces )
+        {
+            int from = popLowest(pieces);
+            Bitboard targets;
+            switch(type)
+            {
+            case Piece::King:
+                targets = t.king[from];
+                break;
+            case Piece::Queen:
+                targets = rookAttacks(t, from, bbAll) | bishopAttacks(t, from, bbAll);
+                break;
+            case Piece::Bishop:
+                targets = bishopAttacks(t, from, bbAll);
+                break;
+            case Piece::Knight:
+                targets = t.knight[from];
+                break;
+            default:
+                targets = rookAttacks(t, from, bbAll);
+                break;
+            }
+            targets &= ~own;
+            while( targets )
+            {
+                int to = popLowest(targets);
+                addMove(moves, n, from, to, ( enemy & bit(to) ) ? Capture : 0);
+            }
+        }
+    }
+
+    // castling; the king may not start on, pass over or land on an attacked square
+    const int home = us == Piece::White ? 0 : 56;
+    const int shortRight = us == Piece::White ? WhiteShort : BlackShort;
+    const int longRight = us == Piece::White ? WhiteLong : BlackLong;
+    if( ( nCastling & shortRight ) && !( bbAll & ( bit(home + 5) | bit(home + 6) ) )
+            && !isAttacked(home + 4, them) && !isAttacked(home + 5, them) && !isAttacked(home + 6, them) )
+        addMove(moves, n, home + 4, home + 6, Castle);
+    if( ( nCastling & longRight ) && !( bbAll & ( bit(home + 1) | bit(home + 2) | bit(home + 3) ) )
+            && !isAttacked(home + 4, them) && !isAttacked(home + 3, them) && !isAttacked(home + 2, them) )
+        addMove(moves, n, home + 4, home + 2, Castle);
+
+    return n;
+}
+
+bool BitboardPosition::leavesKingSafe(const Move & m) const
+{
+    BitboardPosition after = *this;
+    after.makeMove(m);
+    int k = after.kingSquare(eSide);
+    return k < 0 || !after.isAttacked(k, after.eSide);
+}
+
+int BitboardPosition::legalMoves(Move *moves) const
+{
+    Move candidates[MaxMoves];
+    int count = pseudoLegalMoves(candidates);
+    int n = 0;
+    for(int i=0; i<count; i++)
+        if( leavesKingSafe(candidates[i]) )
+            moves[n++] = candidates[i];
+    return n;
+}
+
+static inline int typeFromLetter(char c)
+{
+    switch(c)
+    {
+    case 'K':
+        return Piece::King;
+    case 'Q':
+        return Piece::Queen;
+    case 'B':
+        return Piece::Bishop;
+    case 'N':
+        return Piece::Knight;
+    case 'R':
+        return Piece::Rook;
+    default:
+        return -1;
+    }
+}
+
+bool BitboardPosition::moveFromSan(const char *san, int length, Move *move) const
+{
+    // drop check marks and annotations
+    while( length > 0 && strchr("+#!?", san[length-1]) != 0 )
+        length--;
+    if( length < 2 )
+        return false;
+
+    int type = Piece::Pawn, promotion = Piece::None;
+    int fromFile = -1, fromRank = -1, to;
+    bool castle = san[0] == 'O' || san[0] == '0';
+    if( castle )
+    {
+        if( length != 3 && length != 5 )
+            return false;
+        type = Piece::King;
+        to = ( eSide == Piece::White ? 0 : 56 ) + ( length == 3 ? 6 : 2 );
+    }
+    else
+    {
+        if( length >= 3 && typeFromLetter(san[length-1]) > Piece::King )
+        {
+            promotion = typeFromLetter(san[length-1]);
+            length--;
+            if( san[length-1] == '=' )
+                length--;
+        }
+        if( length < 2 )
+            return false;
+
+        int file = san[length-2] - 'a', rank = san[length-1] - '1';
+        if( file < 0 || file > 7 || rank < 0 || rank > 7 )
+            return false;
+        to = rank * 8 + file;
+
+        // disambiguation and capture mark between the piece letter and the destination
+        int start = 0;
+        if( typeFromLetter(san[0]) >= 0 )
+        {
+            type = typeFromLetter(san[0]);
+            start = 1;
+        }
+        for(int i=start; i<length-2; i++)
+        {
+            if( san[i] >= 'a' && san[i] <= 'h' )
+                fromFile = san[i] - 'a';
+            else if( san[i] >= '1' && san[i] <= '8' )
+                fromRank = san[i] - '1';
+            else if( san[i] != 'x' && san[i] != ':' )
+                return false;
+        }
+        // a pawn capture always names the file it comes from
+        if( type == Piece::Pawn && fromFile < 0 )
+            fromFile = file;
+    }
+
+    Move candidates[MaxMoves];
+    int count = pseudoLegalMoves(candidates);
+    int found = 0;
+    for(int i=0; i<count; i++)
+    {
+        const Move & m = candidates[i];
+        if( m.to != to || m.promotion != promotion || castle != ( ( m.flags & Castle ) != 0 ) )
+            continue;
+        if( ( fromFile >= 0 && m.from % 8 != fromFile ) || ( fromRank >= 0 && m.from / 8 != fromRank ) )
+            continue;
+        if( typeOn(m.from, eSide) != type || !leavesKingSafe(m) )
+            continue;
+        if( found++ == 0 )
+            *move = m;
+    }
+    return found == 1;
+}
+
+void BitboardPosition::makeMove(const Move & m)
+{
+    const Piece::Color us = eSide, them = opponent(eSide);
+    Piece::Type moving = typeOn(m.from, us);
+    const ZobristKeys & z = zobristKeys();
+    nKey ^= z.castling[nCastling] ^ z.blackToMove;
+    if( nEnPassant >= 0 )
+        nKey ^= z.enPassant[nEnPassant % 8];
+
+    if( m.flags & EnPassant )
+        remove( m.to + ( us == Piece::White ? -8 : 8 ), them, Piece::Pawn );
+    else if( m.flags & Capture )
+        remove( m.to, them, typeOn(m.to, them) );
+
+    remove(m.from, us, moving);
+    put(m.to, us, m.promotion != Piece::None ? (Piece::Type)m.promotion : moving);
+
+    if( m.flags & Castle )
+    {
+        int home = us == Piece::White ? 0 : 56;
+        if( m.to == home + 6 )
+        {
+            remove(home + 7, us, Piece::Rook);
+            put(home + 5, us, Piece::Rook);
+        }
+        else
+        {
+            remove(home, us, Piece::Rook);
+            put(home + 3, us, Piece::Rook);
+        }
+    }
+
+    // a king or rook leaving home, or a rook captured at home, ends that castling right
+    static const int corners[4] = { 7, 0, 63, 56 }; // in Castling bit order
+    for(int i=0; i<4; i++)
+        if( m.from == corners[i] || m.to == corners[i] )
+            nCastling &= ~(1 << i);
+    if( moving == Piece::King )
+        nCastling &= us == Piece::White ? ~( WhiteShort | WhiteLong ) : ~( BlackShort | BlackLong );
+
+    nEnPassant = ( m.flags & DoublePush ) ? ( m.from + m.to ) / 2 : -1;
+    eSide = them;
+
+    nKey ^= z.castling[nCastling];
+    if( nEnPassant >= 0 )
+        nKey ^= z.enPassant[nEnPassant % 8];
+}
+
+quint64 BitboardPosition::perft(int depth) const
+{
+    Move moves[MaxMoves];
+    int n = legalMoves(moves);
+    if( depth <= 1 )
+        return depth == 1 ? n : 1;
+
+    quint64 nodes = 0;
+    for(int i=0; i<n; i++)
+    {
+        BitboardPosition after = *this;
+        after.makeMove(moves[i]);
+        nodes += after.perft(depth - 1);
+    }
+    return nodes;
+}
+
+QString BitboardPosition::moveToUci(const Move & m)
+{
+    static const char promotionLetters[] = "kqbnrp";
+    QString s;
+    s += QChar( 'a' + m.from % 8 );
+    s += QChar( '1' + m.from / 8 );
+    s += QChar( 'a' + m.to % 8 );
+    s += QChar( '1' + m.to / 8 );
+    if( m.promotion != Piece::None )
+        s += QChar( promotionLetters[m.promotion] );
+    return s;
+}
+
+QString BitboardPosition::moveToSan(const Move & m) const
+{
+    static const char pieceLetters[] = "KQBNR";
+    QString s;
+    if( m.flags & Castle )
+    {
+        s = m.to % 8 == 6 ? "O-O" : "O-O-O";
+    }
+    else
+    {
+        Piece::Type moving = typeOn(m.from, eSide);
+        if( moving == Piece::Pawn )
+        {
+            if( m.flags & Capture )
+                s += QChar( 'a' + m.from % 8 );
+        }
+        else
+        {
+            s += QChar( pieceLetters[moving] );
+
+            // name the file, the rank, or both, if another piece of the same kind could go there
+            Move moves[MaxMoves];
+            int n = legalMoves(moves);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for(int i=0; i<n; i++)
+            {
+                if( moves[i].to != m.to || moves[i].from == m.from || typeOn(moves[i].from, eSide) != moving )
+                    continue;
+                ambiguous = true;
+                sameFile |= moves[i].from % 8 == m.from % 8;
+                sameRank |= moves[i].from / 8 == m.from / 8;
+            }
+            if( ambiguous && ( !sameFile || sameRank ) )
+                s += QChar( 'a' + m.from % 8 );
+            if( sameFile )
+                s += QChar( '1' + m.from / 8 );
+        }
+        if( m.flags & Capture )
+            s += 'x';
+        s += QChar( 'a' + m.to % 8 );
+        s += QChar( '1' + m.to / 8 );
+        if( m.promotion != Piece::None )
+        {
+            s += '=';
+            s += QChar( pieceLetters[m.promotion] );
+        }
+    }
+
+    BitboardPosition after = *this;
+    after.makeMove(m);
+    if( after.inCheck() )
+    {
+        Move replies[MaxMoves];
+        s += after.legalMoves(replies) == 0 ? '#' : '+';
+    }
+    return s;
+}
+
+QStringList BitboardPosition::problems(const Position & p, Piece::Color sideToMove)
+{
+    QStringList result;
+    BitboardPosition b;
+    b.setPosition(p, sideToMove);
+
+    static const char * const colorNames[2] = { "White", "Black" };
+    for(int c=0; c<2; c++)
+    {
+        int kings = count( b.bbPieces[c][Piece::King] );
+        if( kings != 1 )
+            result << QString("%1 has %2 kings.").arg(colorNames[c]).arg(kings);
+        int pawns = count( b.bbPieces[c][Piece::Pawn] );
+        if( pawns > 8 )
+            result << QString("%1 has %2 pawns.").arg(colorNames[c]).arg(pawns);
+        int pieces = count( b.bbColor[c] );
+        if( pieces > 16 )
+            result << QString("%1 has %2 pieces.").arg(colorNames[c]).arg(pieces);
+        // each promoted piece needs a pawn that is no longer there
+        int extra = qMax(0, count( b.bbPieces[c][Piece::Queen] ) - 1)
+                + qMax(0, count( b.bbPieces[c][Piece::Rook] ) - 2)
+                + qMax(0, count( b.bbPieces[c][Piece::Bishop] ) - 2)
+                + qMax(0, count( b.bbPieces[c][Piece::Knight] ) - 2);
+        if( pawns + extra > 8 )
+            result << QString("%1 has more promoted pieces than missing pawns.").arg(colorNames[c]);
+    }
+
+    const Bitboard backRanks = Q_UINT64_C(0xFF000000000000FF);
+    if( ( b.bbPieces[Piece::White][Piece::Pawn] | b.bbPieces[Piece::Black][Piece::Pawn] ) & backRanks )
+        result << QString("There are pawns on the first or last rank.");
+
+    int theirKing = b.kingSquare( opponent(sideToMove) );
+    if( theirKing >= 0 && b.isAttacked( theirKing, sideToMove ) )
+        result << QString("%1 is in check, but it is %2's move.").arg(colorNames[opponent(sideToMove)]).arg(colorNames[sideToMove]);
+
+    return result;
+}
@@ -0,0 +1,90 @@
+#ifndef BITBOARDPOSITION_H
+#define BITBOARDPOSITION_H
+
+#include <QtGlobal>
+#include <QStringList>
+
+#include "position.h"
+
+typedef quint64 Bitboard;
+
+// A position with the state the rules need (side to move, castling rights,
+// en passant square) kept as one bitboard per piece type and colour, and a
+// legal move generator over it.
+//
+// Squares here are numbered a1 = 0, b1 = 1, ... h8 = 63, the usual order for
+// bitboards; setPosition() and position() convert from and to the row-major,
+// top-down numbering of Position and ChessBoard.
+class BitboardPosition
+{
+public:
+    enum Castling { WhiteShort = 1, WhiteLong = 2, BlackShort = 4, BlackLong = 8 };
+    enum MoveFlag { Capture = 1, EnPassant = 2, Castle = 4, DoublePush = 8 };
+    enum { MaxMoves = 256 };
+
+    struct Move
+    {
+        quint8 from;
+        quint8 to;
+        quint8 promotion; // a Piece::Type, or Piece::None
+        quint8 flags;
+    };
+
+    BitboardPosition();
+
+    bool setFen(const char *fen, int length);
+    void setStartingPosition();
+    // castling rights are assumed wherever king and rook stand on their home squares
+    void setPosition(const Position & p, Piece::Color sideToMove);
+    Position position() const;
+
+    Piece::Color sideToMove() const { return eSide; }
+    int castlingRights() const { return nCastling; }
+    int enPassantSquare() const { return nEnPassant; }
+    Bitboard pieces(Piece::Color c, Piece::Type t) const { return bbPieces[c][t]; }
+    Bitboard occupied() const { return bbAll; }
+    Piece pieceOn(int square) const;
+    // Zobrist hash of everything above, kept up to date by makeMove(); without
+    // castling rights or an en passant square it equals Position::key()
+    quint64 key() const { return nKey; }
+
+    // fills moves, which must hold MaxMoves entries, and returns how many there are
+    int legalMoves(Move *moves) const;
+    void makeMove(const Move & m);
+
+    bool inCheck() const;
+    bool isAttacked(int square, Piece::Color by) const;
+
+    quint64 perft(int depth) const;
+
+    static QString moveToUci(const Move & m);
+    // m must be one of legalMoves()
+    QString moveToSan(const Move & m) const;
+    // the legal move a SAN string such as "e4", "Nbd7", "exd6", "O-O-O" or
+    // "e8=Q+" stands for; false if it stands for none, or for more than one
+    bool moveFromSan(const char *san, int length, Move *move) const;
+    static Piece::Color opponent(Piece::Color c) { return c == Piece::White ? Piece::Black : Piece::White; }
+
+    // reasons the position could not arise in a game with the given side to
+    // move; empty if there are none
+    static QStringList problems(const Position & p, Piece::Color sideToMove);
+
+private:
+    int pseudoLegalMoves(Move *moves) const;
+    bool leavesKingSafe(const Move & m) const;
+    int kingSquare(Piece::Color c) const;
+    void put(int square, Piece::Color c, Piece::Type t);
+    void remove(int square, Piece::Color c, Piece::Type t);
+    Piece::Type typeOn(int square, Piece::Color c) const;
+    void computeKey();
+
+    Bitboard bbPieces[2][6];
+    Bitboard bbColor[2];
+    Bitboard bbAll;
+    Piece::Color eSide;
+    int nCastling;
+    int nEnPassant; // square a pawn may capture onto, or -1
+    quint64 nKey;
+};
+
+#endif // BITBOARDPOSITION_H
@@ -0,0 +1,68 @@
+#include "boarditem.h"
+
+#include <QtWidgets>
+#include "chessboard.h"
+#include "piecerenderercache.h"
+#include "instrumentation.h"
+
+BoardItem::BoardItem(ChessBoard *board) :
+    board(board)
+{
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF BoardItem::boundingRect() const
+{
+    // the square outlines are half a pixel outside the board, as with QGraphicsRectItem
+    return QRectF( 0, 0, 8 * board->nPieceWidth, 8 * board->nPieceWidth ).adjusted( -0.5, -0.5, 0.5, 0.5 );
+}
+
+void BoardItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget);
+    ScopedTimer timer("paint board");
+
+    QRectF exposed = option->exposedRect & boundingRect();
+    if( exposed.isEmpty() )
+        return;
+    int firstRow = board->rowFromPoint( qMax( 0, qFloor( exposed.top() ) ) );
+    int lastRow = qMin( 7, (int)board->rowFromPoint( qMax( 0, qCeil( exposed.bottom() ) - 1 ) ) );
+    int firstCol = board->colFromPoint( qMax( 0, qFloor( exposed.left() ) ) );
+    int lastCol = qMin( 7, (int)board->colFromPoint( qMax( 0, qCeil( exposed.right() ) - 1 ) ) );
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    painter->setPen( QPen(Qt::black, 1) );
+    const int w = board->nPieceWidth;
+    for(int i=firstRow; i<=lastRow; i++)
+    {
+        for(int j=firstCol; j<=lastCol; j++)
+        {
+            painter->setBrush( i % 2 == j % 2 ? board->cLightSquareColor : board->cDarkSquareColor );
+            painter->drawRect( j * w, i * w, w, w );
+        }
+    }
+
+    // pieces go over all the squares, as the piece items did
+    for(int i=firstRow; i<=lastRow; i++)
+    {
+        for(int j=firstCol; j<=lastCol; j++)
+        {
+            Piece p = board->board[i][j];
+            if( p.type() == Piece::None )
+                continue;
+            if( board->bDragSourceHidden && i == board->dragRow && j == board->dragCol )
+                continue;
+            QRectF square( j * w, i * w, w, w );
+            if( board->bSvgRender )
+            {
+                PieceRendererCache::instance()->render( painter, p, board->eVersion, board->sPieceTheme, square );
+            }
+            else
+            {
+                const QPixmap & pixmap = board->piecePixmaps[i][j];
+                if( !pixmap.isNull() )
+                    painter->drawPixmap( square, pixmap, QRectF( pixmap.rect() ) );
+            }
+        }
+    }
+}
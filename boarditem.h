@@ -0,0 +1,24 @@
+#ifndef BOARDITEM_H
+#define BOARDITEM_H
+
+#include <QGraphicsItem>
+
+class ChessBoard;
+
+// The whole board as one item: squares and pieces are painted from the
+// board's model in a single paint() call, and only the squares inside the
+// exposed rectangle are drawn. The scene needs no index of 96 items, and a
+// point is mapped to a square arithmetically.
+class BoardItem : public QGraphicsItem
+{
+public:
+    explicit BoardItem(ChessBoard *board);
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+    ChessBoard *board;
+};
+
+#endif // BOARDITEM_H
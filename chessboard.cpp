@@ -2,17 +2,68 @@
 
 #include <QtWidgets>
 #include <QGraphicsSvgItem>
+#include <QSvgGenerator>
+#include <QSvgRenderer>
+#include "piecerenderercache.h"
+#include "piecepixmapcache.h"
+#include "svgboardwriter.h"
+#include "position.h"
+#include "boarditem.h"
+#include "annotationitem.h"
+#include "instrumentation.h"
 
 ChessBoard::ChessBoard(QObject *parent) :
     QGraphicsScene(parent)
 {
     bSvgRender = false;
+    pieceMenu = 0;
+    changePiece = 0;
+    nIconVersion = -1;
+    rIconDevicePixelRatio = 0;
+    bPlacing = false;
+    eAnnotationColor = Annotations::Green;
+    annotateRow = -1;
+    annotateCol = -1;
+    dragRow = -1;
+    dragCol = -1;
+    dragSprite = 0;
+    bDragCopy = false;
+    bDragSourceHidden = false;
+    nFrameStart = 0;
+    nDragFrames = 0;
+    nDragPaint = 0;
+    nDragMaxPaint = 0;
+    bItemPerSquare = false;
+    boardItem = 0;
 
     nPieceWidth = 45;
     nBorderWidth = 0;
     eVersion = Traditional;
+    nUpdateDepth = 0;
+    bReplaying = false;
+    setUndoStack(0);
+    rZoom = 1.0;
+    rDevicePixelRatio = 1.0;
 
-    setDefaultColors(); // also draws the board
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            squareItems[i][j] = 0;
+            pieceItems[i][j] = 0;
+            dirty[i][j] = false;
+        }
+    }
+
+    drawBoard();
+    annotationItem = new AnnotationItem(this);
+    addItem(annotationItem);
+    setDefaultColors();
+}
+
+ChessBoard::~ChessBoard()
+{
+    delete pieceMenu;
 }
 
 void ChessBoard::setDefaultColors()
@@ -24,132 +75,403 @@ void ChessBoard::setDefaultColors()
     redrawEntireBoard();
 }
 
+BoardStyle ChessBoard::style() const
+{
+    BoardStyle s;
+    s.lightSquare = cLightSquareColor;
+    s.darkSquare = cDarkSquareColor;
+    s.lightPiece = cLightPieceColor;
+    s.darkPiece = cDarkPieceColor;
+    s.version = eVersion;
+    s.pieceTheme = sPieceTheme;
+    return s;
+}
+
+void ChessBoard::setStyle(const BoardStyle & style)
+{
+    cLightSquareColor = style.lightSquare;
+    cDarkSquareColor = style.darkSquare;
+    cLightPieceColor = style.lightPiece;
+    cDarkPieceColor = style.darkPiece;
+    eVersion = style.version;
+    sPieceTheme = style.pieceTheme;
+    redrawEntireBoard();
+}
+
 void ChessBoard::drawBoard()
 {
+    // with one item there is nothing for an index to speed up
+    setItemIndexMethod( bItemPerSquare ? QGraphicsScene::BspTreeIndex : QGraphicsScene::NoIndex );
+    if( !bItemPerSquare )
+    {
+        boardItem = new BoardItem(this);
+        addItem(boardItem);
+        return;
+    }
+
     for(int i=0; i<8; i++)
     {
         for(int j=0; j<8; j++)
         {
             QGraphicsRectItem *rect = new QGraphicsRectItem( j * nPieceWidth , i * nPieceWidth , nPieceWidth , nPieceWidth );
-            if( i % 2 == j % 2 )
-                rect->setBrush( QBrush(cLightSquareColor, Qt::SolidPattern) );
-            else
-                rect->setBrush( QBrush(cDarkSquareColor, Qt::SolidPattern) );
             rect->setCacheMode(QGraphicsItem::NoCache);
             addItem(rect);
+            squareItems[i][j] = rect;
+        }
+    }
+    restyleSquares();
+}
+
+void ChessBoard::setItemPerSquare(bool v)
+{
+    if( v == bItemPerSquare )
+        return;
+
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            delete squareItems[i][j];
+            squareItems[i][j] = 0;
+            delete pieceItems[i][j];
+            pieceItems[i][j] = 0;
+            piecePixmaps[i][j] = QPixmap();
+        }
+    }
+    delete boardItem;
+    boardItem = 0;
+
+    bItemPerSquare = v;
+    drawBoard();
+    refreshBoard();
+}
+
+void ChessBoard::restyleSquares()
+{
+    if( boardItem != 0 )
+    {
+        boardItem->update();
+        return;
+    }
+
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            if( i % 2 == j % 2 )
+                squareItems[i][j]->setBrush( QBrush(cLightSquareColor, Qt::SolidPattern) );
+            else
+                squareItems[i][j]->setBrush( QBrush(cDarkSquareColor, Qt::SolidPattern) );
         }
     }
 }
 
 void ChessBoard::setItem(int i, int j, Piece p)
 {
+    if( pUndoStack != 0 && !bReplaying && pendingOld[i*8+j] < 0 )
+    {
+        pendingOld[i*8+j] = Position::codeFromPiece( board[i][j] );
+        bPendingEdit = true;
+    }
     board[i][j] = p;
     refreshImage(i,j);
+    if( nUpdateDepth == 0 )
+    {
+        commitEdit();
+        emit changed();
+    }
+}
+
+// An edit is stored as two bytes per square that changed: the square, then the
+// old piece code in the high nibble and the new one in the low nibble (see
+// Position). A batch that touches a square several times keeps only the net
+// change, so setInitialPositions is 32 deltas however it gets there.
+class BoardEdit : public QUndoCommand
+{
+public:
+    BoardEdit(ChessBoard *board, const QByteArray & deltas, const QString & text)
+        : board(board), deltas(deltas), bDone(true) { setText(text); }
+
+    void undo() { board->applyEdit(deltas, true); bDone = false; }
+    void redo()
+    {
+        // the edit has already been made when it is pushed
+        if( !bDone )
+            board->applyEdit(deltas, false);
+        bDone = true;
+    }
+
+private:
+    ChessBoard *board;
+    QByteArray deltas;
+    bool bDone;
+};
+
+void ChessBoard::setUndoStack(QUndoStack *stack)
+{
+    pUndoStack = stack;
+    for(int i=0; i<64; i++)
+        pendingOld[i] = -1;
+    bPendingEdit = false;
+}
+
+void ChessBoard::commitEdit()
+{
+    if( !bPendingEdit )
+        return;
+    bPendingEdit = false;
+
+    QByteArray deltas;
+    int last = 0;
+    for(int square=0; square<64; square++)
+    {
+        if( pendingOld[square] < 0 )
+            continue;
+        quint8 now = Position::codeFromPiece( board[square / 8][square % 8] );
+        if( now != pendingOld[square] )
+        {
+            deltas += (char)square;
+            deltas += (char)( ( pendingOld[square] << 4 ) | now );
+            last = square;
+        }
+        pendingOld[square] = -1;
+    }
+    if( deltas.isEmpty() || pUndoStack == 0 )
+        return;
+
+    QString text;
+    if( deltas.size() == 2 )
+        text = tr("Change %1%2").arg( QChar('a' + last % 8) ).arg( 8 - last / 8 );
+    else
+        text = tr("Change %n square(s)", 0, deltas.size() / 2);
+    pUndoStack->push( new BoardEdit(this, deltas, text) );
+}
+
+void ChessBoard::applyEdit(const QByteArray & deltas, bool undo)
+{
+    // through the same incremental path as any other change, without recording it again
+    bReplaying = true;
+    beginUpdate();
+    for(int k=0; k+1<deltas.size(); k+=2)
+    {
+        int square = (quint8)deltas.at(k);
+        quint8 codes = (quint8)deltas.at(k+1);
+        setItem( square / 8, square % 8, Position::pieceFromCode( undo ? codes >> 4 : codes & 0x0F ) );
+    }
+    endUpdate();
+    bReplaying = false;
+}
+
+void ChessBoard::beginUpdate()
+{
+    nUpdateDepth++;
+}
+
+void ChessBoard::endUpdate()
+{
+    if( nUpdateDepth == 0 || --nUpdateDepth > 0 )
+        return;
+
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            if( dirty[i][j] )
+            {
+                dirty[i][j] = false;
+                refreshImage(i,j);
+            }
+        }
+    }
+    commitEdit();
+    emit changed();
 }
 
 void ChessBoard::refreshBoard()
 {
     for(int i=0; i<8; i++)
         for(int j=0; j<8; j++)
-            refreshImage(i,j);
+            if( board[i][j].type() != Piece::None )
+                refreshImage(i,j);
 }
 
 void ChessBoard::redrawEntireBoard()
 {
-    qDeleteAll( items() );
-    drawBoard();
+    ScopedTimer timer("redrawEntireBoard");
+    Instrumentation::count(Instrumentation::FullRebuilds);
+    restyleSquares();
     refreshBoard();
 }
 
 void ChessBoard::clearBoard()
 {
+    beginUpdate();
     for(int i=0; i<8; i++)
         for(int j=0; j<8; j++)
             setItem(i,j,Piece());
+    endUpdate();
 }
 
 void ChessBoard::refreshImage(int i, int j)
 {
-    QGraphicsItem *currentItem = itemAt( xFromCol(j) , yFromRow(i) , QTransform() );
-    if( currentItem != 0 && currentItem->data(0) == 777 )
-        delete currentItem;
+    if( nUpdateDepth > 0 )
+    {
+        dirty[i][j] = true;
+        return;
+    }
 
-    QString filename = getPieceFilename( board[i][j] );
-    if(filename.isEmpty())
+    if( boardItem != 0 )
+    {
+        if( board[i][j].type() == Piece::None || bSvgRender )
+        {
+            piecePixmaps[i][j] = QPixmap();
+        }
+        else
+        {
+            QColor tint = board[i][j].color() == Piece::White ? cLightPieceColor : cDarkPieceColor;
+            piecePixmaps[i][j] = PiecePixmapCache::instance()->pixmap( board[i][j], eVersion, sPieceTheme, tint, qRound(nPieceWidth * rZoom), rDevicePixelRatio );
+        }
+        boardItem->update( squareRect(i,j) );
         return;
+    }
 
-    quint32 y = nPieceWidth * i;
-    quint32 x = nPieceWidth * j;
-    QGraphicsSvgItem *item = new QGraphicsSvgItem( filename );
+    if( board[i][j].type() == Piece::None )
+    {
+        if( pieceItems[i][j] != 0 )
+            Instrumentation::count(Instrumentation::ItemsDeleted);
+        delete pieceItems[i][j];
+        pieceItems[i][j] = 0;
+        return;
+    }
 
-    if(!bSvgRender)
+    // vector items are only needed while rendering to SVG; on screen pieces are pre-tinted pixmaps
+    QGraphicsItem *item = pieceItems[i][j];
+    if( item != 0 && ( item->type() == QGraphicsSvgItem::Type ) != bSvgRender )
+    {
+        Instrumentation::count(Instrumentation::ItemsDeleted);
+        delete item;
+        item = 0;
+    }
+    if( item == 0 )
     {
-        QGraphicsColorizeEffect *colorize = new QGraphicsColorizeEffect;
-        if( board[i][j].color() == Piece::White )
-            colorize->setColor(cLightPieceColor);
+        Instrumentation::count(Instrumentation::ItemsCreated);
+        if(bSvgRender)
+        {
+            item = new QGraphicsSvgItem;
+            item->setCacheMode(QGraphicsItem::NoCache); // needed for proper rendering
+        }
         else
-            colorize->setColor(cDarkPieceColor);
-        item->setGraphicsEffect( colorize );
+        {
+            item = new QGraphicsPixmapItem;
+            static_cast<QGraphicsPixmapItem*>(item)->setTransformationMode(Qt::SmoothTransformation);
+        }
+        addItem(item);
+        item->setPos( nPieceWidth * j , nPieceWidth * i );
+        pieceItems[i][j] = item;
     }
+    stylePieceItem(i,j);
+}
 
-    item->setCacheMode(QGraphicsItem::NoCache); // needed for proper rendering
-    item->setData(0, 777 );
+void ChessBoard::stylePieceItem(int i, int j)
+{
+    if(bSvgRender)
+    {
+        QGraphicsSvgItem *item = static_cast<QGraphicsSvgItem*>( pieceItems[i][j] );
+        QSvgRenderer *renderer = PieceRendererCache::instance()->renderer( board[i][j], eVersion, sPieceTheme );
+        if( item->renderer() != renderer )
+            item->setSharedRenderer( renderer );
+    }
+    else
+    {
+        QGraphicsPixmapItem *item = static_cast<QGraphicsPixmapItem*>( pieceItems[i][j] );
+        QColor tint = board[i][j].color() == Piece::White ? cLightPieceColor : cDarkPieceColor;
+        QPixmap pixmap = PiecePixmapCache::instance()->pixmap( board[i][j], eVersion, sPieceTheme, tint, qRound(nPieceWidth * rZoom), rDevicePixelRatio );
+        if( item->pixmap().cacheKey() != pixmap.cacheKey() )
+        {
+            item->setPixmap( pixmap );
+            item->setScale( qreal(nPieceWidth) / pixmap.width() );
+        }
+    }
+}
 
-    addItem(item);
-    item->setPos(x,y);
+void ChessBoard::setPixelScale(qreal zoom, qreal dpr)
+{
+    if( zoom == rZoom && dpr == rDevicePixelRatio )
+        return;
+    rZoom = zoom;
+    rDevicePixelRatio = dpr;
+    refreshBoard();
 }
 
-QString ChessBoard::getPieceFilename(Piece p)
+// indexed by [Version][Piece::Color][Piece::Type]
+static const char * const pieceFilenames[2][2][6] = {
+    {
+        { ":/resources/white-king.svg", ":/resources/white-queen.svg", ":/resources/white-bishop.svg",
+          ":/resources/white-knight.svg", ":/resources/white-rook.svg", ":/resources/white-pawn.svg" },
+        { ":/resources/black-king.svg", ":/resources/black-queen.svg", ":/resources/black-bishop.svg",
+          ":/resources/black-knight.svg", ":/resources/black-rook.svg", ":/resources/black-pawn.svg" }
+    },
+    {
+        { ":/resources/white-king-secular.svg", ":/resources/white-queen.svg", ":/resources/white-bishop-secular.svg",
+          ":/resources/white-knight.svg", ":/resources/white-rook.svg", ":/resources/white-pawn.svg" },
+        { ":/resources/black-king-secular.svg", ":/resources/black-queen.svg", ":/resources/black-bishop-secular.svg",
+          ":/resources/black-knight.svg", ":/resources/black-rook.svg", ":/resources/black-pawn.svg" }
+    }
+};
+
+QString ChessBoard::pieceFilename(Piece p, Version v)
 {
     if( p.type() == Piece::None )
-        return "";
-
-    QString filename = ":/resources/";
-    switch(p.color())
-    {
-    case Piece::White:
-        filename += "white";
-        break;
-    case Piece::Black:
-    default:
-        filename += "black";
-        break;
-    }
-
-    switch(p.type())
-    {
-    case Piece::King:
-        filename += "-king";
-        break;
-    case Piece::Queen:
-        filename += "-queen";
-        break;
-    case Piece::Bishop:
-        filename += "-bishop";
-        break;
-    case Piece::Knight:
-        filename += "-knight";
-        break;
-    case Piece::Rook:
-        filename += "-rook";
-        break;
-    case Piece::Pawn:
-        filename += "-pawn";
-        break;
-    default:
-        break;
-    }
-
-    if(eVersion == Secular && p.hasSecularVariant() )
-        filename += "-secular";
-
-    return filename + ".svg";
+        return QString();
+    return QLatin1String( pieceFilenames[v][p.color()][p.type()] );
+}
+
+bool ChessBoard::writeSvg(QIODevice *device)
+{
+    ScopedTimer timer("writeSvg");
+    Instrumentation::count(Instrumentation::Exports);
+    return SvgBoardWriter().write(this, device);
+}
+
+bool ChessBoard::writeSceneSvg(QIODevice *device)
+{
+    if( device == 0 || !device->isWritable() )
+        return false;
+    ScopedTimer timer("writeSceneSvg");
+    Instrumentation::count(Instrumentation::Exports);
+
+    bool wasSvgRender = bSvgRender;
+    if(!wasSvgRender)
+        setSvgRender(true);
+
+    QSvgGenerator generator;
+    generator.setOutputDevice(device);
+    generator.setSize(QSize(200, 200));
+    generator.setViewBox(QRect(0, 0, 200, 200));
+    QPainter painter(&generator);
+    render(&painter);
+    painter.end();
+
+    if(!wasSvgRender)
+        setSvgRender(false);
+    return true;
+}
+
+bool ChessBoard::writeSvg(const QString & filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+    return writeSvg(&file);
 }
 
 void ChessBoard::contextMenuEvent ( QGraphicsSceneContextMenuEvent * contextMenuEvent )
 {
     QPointF scenePos = contextMenuEvent->scenePos();
-    if( scenePos.x() < 0 || scenePos.y() < 0 || scenePos.x() > 8*nPieceWidth || scenePos.y() > 8*nPieceWidth )
+    if( scenePos.x() < 0 || scenePos.y() < 0 || scenePos.x() >= 8*nPieceWidth || scenePos.y() >= 8*nPieceWidth )
     {
         focusRow = -1;
         focusCol = -1;
@@ -159,46 +481,338 @@ void ChessBoard::contextMenuEvent ( QGraphicsSceneContextMenuEvent * contextMenu
     focusRow = rowFromPoint( scenePos.y() );
     focusCol = colFromPoint( scenePos.x() );
 
-    QMenu menu;
+    if( pieceMenu == 0 )
+        buildPieceMenu();
+    if( nIconVersion != eVersion || sIconTheme != sPieceTheme || rIconDevicePixelRatio != rDevicePixelRatio )
+        updatePieceIcons();
+
+    bool occupied = board[focusRow][focusCol].type() != Piece::None;
+    clearAction->setVisible(occupied);
+    toggleColorAction->setVisible(occupied);
+    editSeparator->setVisible(occupied);
+    int square = focusRow * 8 + focusCol;
+    bool marked = false;
+    foreach(const Annotations::Mark & m, mAnnotations.list())
+        marked = marked || m.square == square || ( m.kind == Annotations::Arrow && m.to == square );
+    clearMarksAction->setVisible(marked);
+
+    pieceMenu->exec(contextMenuEvent->screenPos());
+}
 
+// the menu is made the first time it is needed and kept; only the icons change, with the piece set
+void ChessBoard::buildPieceMenu()
+{
+    pieceMenu = new QMenu;
     changePiece = new QActionGroup(this);
-
-    if( board[focusRow][focusCol].type() != Piece::None )
-    {
-        QAction *clear = menu.addAction(tr("Clear space"));
-        clear->setData( QString("%1 %2").arg(Piece::None).arg(Piece::White) );
-        changePiece->addAction(clear);
-        menu.addAction(tr("Change color"),this,SLOT(toggleColor()));
-        menu.addSeparator();
-    }
-
-    menu.addAction( pieceMenuAction( tr("King") , Piece::King, Piece::White ) );
-    menu.addAction( pieceMenuAction( tr("Queen") , Piece::Queen, Piece::White ) );
-    menu.addAction( pieceMenuAction( tr("Bishop") , Piece::Bishop, Piece::White ) );
-    menu.addAction( pieceMenuAction( tr("Knight") , Piece::Knight, Piece::White ) );
-    menu.addAction( pieceMenuAction( tr("Rook") , Piece::Rook, Piece::White ) );
-    menu.addAction( pieceMenuAction( tr("Pawn") , Piece::Pawn, Piece::White ) );
-    menu.addSeparator();
-    menu.addAction( pieceMenuAction( tr("King") , Piece::King, Piece::Black ) );
-    menu.addAction( pieceMenuAction( tr("Queen") , Piece::Queen, Piece::Black ) );
-    menu.addAction( pieceMenuAction( tr("Bishop") , Piece::Bishop, Piece::Black ) );
-    menu.addAction( pieceMenuAction( tr("Knight") , Piece::Knight, Piece::Black ) );
-    menu.addAction( pieceMenuAction( tr("Rook") , Piece::Rook, Piece::Black ) );
-    menu.addAction( pieceMenuAction( tr("Pawn") , Piece::Pawn, Piece::Black ) );
-
     connect(changePiece,SIGNAL(triggered(QAction*)),this,SLOT(changePieceType(QAction*)));
 
-    menu.exec(contextMenuEvent->screenPos());
+    clearAction = pieceMenu->addAction(tr("Clear space"));
+    clearAction->setData( QString("%1 %2").arg(Piece::None).arg(Piece::White) );
+    changePiece->addAction(clearAction);
+    toggleColorAction = pieceMenu->addAction(tr("Change color"),this,SLOT(toggleColor()));
+    editSeparator = pieceMenu->addSeparator();
+    textMarkAction = pieceMenu->addAction(tr("Text mark..."),this,SLOT(editTextMark()));
+    clearMarksAction = pieceMenu->addAction(tr("Remove marks"),this,SLOT(clearMarks()));
+    pieceMenu->addSeparator();
+
+    const QString labels[6] = { tr("King"), tr("Queen"), tr("Bishop"), tr("Knight"), tr("Rook"), tr("Pawn") };
+    for(int c=0; c<2; c++)
+    {
+        if( c == Piece::Black )
+            pieceMenu->addSeparator();
+        for(int t=0; t<6; t++)
+            pieceMenu->addAction( pieceMenuAction( labels[t], (Piece::Type)t, (Piece::Color)c ) );
+    }
+    nIconVersion = -1;
+}
+
+void ChessBoard::updatePieceIcons()
+{
+    // drawn from the pictures the board already holds, at the menu's icon size and the screen's pixel ratio
+    int size = QApplication::style()->pixelMetric(QStyle::PM_SmallIconSize);
+    int edge = qMax( 1, qRound(size * rDevicePixelRatio) );
+    for(int c=0; c<2; c++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            QImage image( edge, edge, QImage::Format_ARGB32_Premultiplied );
+            image.fill(Qt::transparent);
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            PieceRendererCache::instance()->render( &painter, Piece( (Piece::Type)t, (Piece::Color)c ), eVersion, sPieceTheme, QRectF(0, 0, edge, edge) );
+            painter.end();
+            QPixmap pixmap = QPixmap::fromImage(image);
+            pixmap.setDevicePixelRatio(rDevicePixelRatio);
+            pieceActions[c][t]->setIcon( QIcon(pixmap) );
+        }
+    }
+    nIconVersion = eVersion;
+    sIconTheme = sPieceTheme;
+    rIconDevicePixelRatio = rDevicePixelRatio;
 }
 
 QAction* ChessBoard::pieceMenuAction( const QString& label , Piece::Type t, Piece::Color c)
 {
-    QAction *tmp = new QAction(QIcon(getPieceFilename(Piece(t,c))),label,this);
+    QAction *tmp = new QAction(label,this);
     tmp->setData(QString("%1 %2").arg(t).arg(c));
     changePiece->addAction(tmp);
+    pieceActions[c][t] = tmp;
     return tmp;
 }
 
+void ChessBoard::setPlacementPiece(Piece p)
+{
+    bPlacing = true;
+    placementPiece = p;
+    emit placementChanged();
+}
+
+void ChessBoard::stopPlacing()
+{
+    if( !bPlacing )
+        return;
+    bPlacing = false;
+    emit placementChanged();
+}
+
+void ChessBoard::keyPressEvent(QKeyEvent *event)
+{
+    // piece letters as in FEN, capitals for White; H is a knight too, as in .chs
+    QString text = event->text();
+    if( event->key() == Qt::Key_Escape && bPlacing )
+    {
+        stopPlacing();
+        event->accept();
+        return;
+    }
+    if( event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace || text == "x" || text == "X" )
+    {
+        setPlacementPiece( Piece() );
+        event->accept();
+        return;
+    }
+    if( text.length() == 1 && ( event->modifiers() & ~(Qt::ShiftModifier | Qt::KeypadModifier) ) == 0 )
+    {
+        QChar ch = text.at(0);
+        char lower = ch.toLower().toLatin1();
+        if( lower == 'h' )
+            lower = 'n';
+        int type = lower != 0 ? QByteArray("kqbnrp").indexOf(lower) : -1;
+        if( type >= 0 )
+        {
+            setPlacementPiece( Piece( (Piece::Type)type, ch.isUpper() ? Piece::White : Piece::Black ) );
+            event->accept();
+            return;
+        }
+    }
+    QGraphicsScene::keyPressEvent(event);
+}
+
+void ChessBoard::mousePressEvent(QGraphicsSceneMouseEvent *event)
+{
+    QPointF scenePos = event->scenePos();
+    bool onBoard = scenePos.x() >= 0 && scenePos.y() >= 0 && scenePos.x() < 8*nPieceWidth && scenePos.y() < 8*nPieceWidth;
+    if( onBoard && event->button() == Qt::LeftButton && ( event->modifiers() & Qt::ShiftModifier ) )
+    {
+        annotateRow = rowFromPoint( scenePos.y() );
+        annotateCol = colFromPoint( scenePos.x() );
+        event->accept();
+        return;
+    }
+    if( bPlacing && onBoard && event->button() == Qt::LeftButton )
+    {
+        int i = rowFromPoint( scenePos.y() ), j = colFromPoint( scenePos.x() );
+        // clicking a square that already has the piece empties it
+        setItem( i, j, board[i][j] == placementPiece ? Piece() : placementPiece );
+        event->accept();
+        return;
+    }
+    if( !bPlacing && onBoard && event->button() == Qt::LeftButton )
+    {
+        int i = rowFromPoint( scenePos.y() ), j = colFromPoint( scenePos.x() );
+        if( board[i][j].type() != Piece::None )
+        {
+            // the drag starts once the mouse has moved far enough
+            dragRow = i;
+            dragCol = j;
+            dragStart = scenePos;
+            event->accept();
+            return;
+        }
+    }
+    QGraphicsScene::mousePressEvent(event);
+}
+
+void ChessBoard::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
+{
+    if( dragRow < 0 || !( event->buttons() & Qt::LeftButton ) )
+    {
+        QGraphicsScene::mouseMoveEvent(event);
+        return;
+    }
+    event->accept();
+
+    bool copy = event->modifiers() & Qt::ControlModifier;
+    if( dragSprite == 0 )
+    {
+        if( ( event->screenPos() - event->buttonDownScreenPos(Qt::LeftButton) ).manhattanLength() < QApplication::startDragDistance() )
+            return;
+
+        // the sprite is the piece's screen pixmap, so moving it is a blit
+        Piece p = board[dragRow][dragCol];
+        QColor tint = p.color() == Piece::White ? cLightPieceColor : cDarkPieceColor;
+        QPixmap pixmap = PiecePixmapCache::instance()->pixmap( p, eVersion, sPieceTheme, tint, qRound(nPieceWidth * rZoom), rDevicePixelRatio );
+        dragSprite = new QGraphicsPixmapItem(pixmap);
+        dragSprite->setTransformationMode(Qt::SmoothTransformation);
+        dragSprite->setScale( qreal(nPieceWidth) / pixmap.width() );
+        dragSprite->setZValue(1);
+        addItem(dragSprite);
+        dragOffset = dragStart - QPointF( dragCol * nPieceWidth, dragRow * nPieceWidth );
+
+        bDragCopy = copy;
+        showDragSource(!bDragCopy);
+        dragTimer.start();
+        nDragFrames = 0;
+        nDragPaint = 0;
+        nDragMaxPaint = 0;
+    }
+    else if( copy != bDragCopy )
+    {
+        bDragCopy = copy;
+        showDragSource(!bDragCopy);
+    }
+    dragSprite->setPos( event->scenePos() - dragOffset );
+}
+
+void ChessBoard::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+{
+    if( annotateRow >= 0 && event->button() == Qt::LeftButton )
+    {
+        event->accept();
+        QPointF scenePos = event->scenePos();
+        int from = annotateRow * 8 + annotateCol;
+        annotateRow = -1;
+        annotateCol = -1;
+        if( scenePos.x() < 0 || scenePos.y() < 0 || scenePos.x() >= 8*nPieceWidth || scenePos.y() >= 8*nPieceWidth )
+            return;
+        int to = rowFromPoint( scenePos.y() ) * 8 + colFromPoint( scenePos.x() );
+        if( to != from )
+            mAnnotations.toggleArrow(from, to, eAnnotationColor);
+        else if( event->modifiers() & Qt::ControlModifier )
+            mAnnotations.toggleCircle(from, eAnnotationColor);
+        else
+            mAnnotations.toggleSquare(from, eAnnotationColor);
+        annotationItem->update();
+        return;
+    }
+    if( dragRow < 0 || event->button() != Qt::LeftButton )
+    {
+        QGraphicsScene::mouseReleaseEvent(event);
+        return;
+    }
+    event->accept();
+
+    int fromRow = dragRow, fromCol = dragCol;
+    bool dragged = dragSprite != 0;
+    if( dragged )
+    {
+        showDragSource(false);
+        delete dragSprite;
+        dragSprite = 0;
+        logDragFrames();
+    }
+    dragRow = -1;
+    dragCol = -1;
+    if( !dragged )
+        return;
+
+    // dropping off the board removes the piece, unless it is being copied
+    QPointF scenePos = event->scenePos();
+    bool onBoard = scenePos.x() >= 0 && scenePos.y() >= 0 && scenePos.x() < 8*nPieceWidth && scenePos.y() < 8*nPieceWidth;
+    Piece p = board[fromRow][fromCol];
+    beginUpdate();
+    if( onBoard )
+        setItem( rowFromPoint( scenePos.y() ), colFromPoint( scenePos.x() ), p );
+    if( !bDragCopy && ( !onBoard || rowFromPoint( scenePos.y() ) != fromRow || colFromPoint( scenePos.x() ) != fromCol ) )
+        setItem( fromRow, fromCol, Piece() );
+    endUpdate();
+    bDragCopy = false;
+}
+
+void ChessBoard::setAnnotations(const Annotations & annotations)
+{
+    mAnnotations = annotations;
+    annotationItem->update();
+}
+
+void ChessBoard::clearAnnotations()
+{
+    mAnnotations.clear();
+    annotationItem->update();
+}
+
+void ChessBoard::setAnnotationColor(QAction *action)
+{
+    eAnnotationColor = (Annotations::Color)action->data().toInt();
+}
+
+void ChessBoard::editTextMark()
+{
+    int square = focusRow * 8 + focusCol;
+    bool ok;
+    QString text = QInputDialog::getText( views().value(0), tr("Text mark"), tr("Text to show on the square (empty for none):"),
+                                          QLineEdit::Normal, mAnnotations.text(square), &ok );
+    if( !ok )
+        return;
+    mAnnotations.setText(square, text, eAnnotationColor);
+    annotationItem->update();
+}
+
+void ChessBoard::clearMarks()
+{
+    mAnnotations.clearSquare( focusRow * 8 + focusCol );
+    annotationItem->update();
+}
+
+void ChessBoard::showDragSource(bool hidden)
+{
+    bDragSourceHidden = hidden;
+    if( boardItem != 0 )
+        boardItem->update( squareRect(dragRow, dragCol) );
+    else if( pieceItems[dragRow][dragCol] != 0 )
+        pieceItems[dragRow][dragCol]->setVisible(!hidden);
+}
+
+// each view repaint during a drag is timed from its background to its foreground
+void ChessBoard::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    if( dragSprite != 0 )
+        nFrameStart = dragTimer.nsecsElapsed();
+    QGraphicsScene::drawBackground(painter, rect);
+}
+
+void ChessBoard::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawForeground(painter, rect);
+    if( dragSprite != 0 )
+    {
+        qint64 paint = dragTimer.nsecsElapsed() - nFrameStart;
+        nDragFrames++;
+        nDragPaint += paint;
+        nDragMaxPaint = qMax( nDragMaxPaint, paint );
+    }
+}
+
+void ChessBoard::logDragFrames()
+{
+    qint64 elapsed = dragTimer.nsecsElapsed();
+    if( nDragFrames == 0 )
+        return;
+    qDebug() << "Drag:" << nDragFrames << "frames in" << elapsed / 1000000 << "ms;"
+             << "paint" << nDragPaint / 1e6 / nDragFrames << "ms average," << nDragMaxPaint / 1e6 << "ms at most;"
+             << "a frame every" << elapsed / 1e6 / nDragFrames << "ms";
+}
+
 void ChessBoard::setVersion(quint32 v)
 {
     eVersion = (Version)v;
@@ -210,6 +824,19 @@ void ChessBoard::setVersion(QAction *action)
     setVersion(action->data().toUInt());
 }
 
+void ChessBoard::setPieceTheme(const QString & name)
+{
+    if( name == sPieceTheme )
+        return;
+    sPieceTheme = name;
+    refreshBoard();
+}
+
+void ChessBoard::setPieceTheme(QAction *action)
+{
+    setPieceTheme(action->data().toString());
+}
+
 void ChessBoard::changePieceType(QAction *action)
 {
     QStringList values = action->data().toString().split(" ");
@@ -217,104 +844,53 @@ void ChessBoard::changePieceType(QAction *action)
         return;
     Piece::Type t = (Piece::Type)values.at(0).toUInt();
     Piece::Color c = (Piece::Color)values.at(1).toUInt();
-    board[focusRow][focusCol] = Piece(t,c);
-    refreshImage(focusRow,focusCol);
+    setItem( focusRow, focusCol, Piece(t,c) );
 }
 
 void ChessBoard::toggleColor()
 {
-    if(board[focusRow][focusCol].color() == Piece::White )
-        board[focusRow][focusCol].setColor( Piece::Black );
-    else if(board[focusRow][focusCol].color() == Piece::Black )
-        board[focusRow][focusCol].setColor( Piece::White );
-    refreshImage(focusRow,focusCol);
+    Piece p = board[focusRow][focusCol];
+    p.setColor( p.color() == Piece::White ? Piece::Black : Piece::White );
+    setItem( focusRow, focusCol, p );
 }
 
-QString ChessBoard::toString() const
+Position ChessBoard::position() const
 {
-    QString result;
+    Position p;
     for(int i=0; i<8; i++)
-    {
         for(int j=0; j<8; j++)
-        {
-            if( board[i][j].color() == Piece::White )
-                result += "W";
-            else
-                result += "B";
-            switch(board[i][j].type())
-            {
-            case Piece::King:
-                result += "K ";
-                break;
-            case Piece::Queen:
-                result += "Q ";
-                break;
-            case Piece::Bishop:
-                result += "B ";
-                break;
-            case Piece::Knight:
-                result += "K ";
-                break;
-            case Piece::Rook:
-                result += "R ";
-                break;
-            case Piece::Pawn:
-                result += "P ";
-                break;
-            case Piece::None:
-                result += "N ";
-                break;
-            }
-        }
-    }
-    return result.trimmed();
+            p.set(i,j,board[i][j]);
+    return p;
 }
 
-void ChessBoard::fromString(QString s)
+void ChessBoard::setPosition(const Position & p)
 {
-    clearBoard();
-    QStringList list = s.trimmed().split(" ");
-    if(list.count() < 64)
-        return;
-
-    int pos = 0;
+    beginUpdate();
     for(int i=0; i<8; i++)
-    {
         for(int j=0; j<8; j++)
-        {
-            Piece::Color c;
-            Piece::Type t;
+            if( board[i][j] != p.at(i,j) )
+                setItem(i,j,p.at(i,j));
+    endUpdate();
+}
 
-            if( list.at(pos).at(0) == 'B' )
-                c = Piece::Black;
-            else
-                c = Piece::White;
-
-            if( list.at(pos).at(1) == 'K' )
-                t = Piece::King;
-            else if( list.at(pos).at(1) == 'Q' )
-                t = Piece::Queen;
-            else if( list.at(pos).at(1) == 'B' )
-                t = Piece::Bishop;
-            else if( list.at(pos).at(1) == 'K' )
-                t = Piece::Knight;
-            else if( list.at(pos).at(1) == 'R' )
-                t = Piece::Rook;
-            else if( list.at(pos).at(1) == 'P' )
-                t = Piece::Pawn;
-            else if( list.at(pos).at(1) == 'N' )
-                t = Piece::None;
-
-            board[i][j] = Piece(t,c);
-
-            pos++;
-        }
-    }
-    refreshBoard();
+QString ChessBoard::toString() const
+{
+    return position().toChs();
+}
+
+bool ChessBoard::fromString(QString s, Piece::Color *sideToMove)
+{
+    Position p;
+    bool ok = p.parse(s, sideToMove);
+    if( !ok )
+        p.clear();
+    setPosition(p);
+    return ok;
 }
 
 void ChessBoard::setInitialPositions()
 {
+    beginUpdate();
     clearBoard();
     setItem(0, 0, Piece(Piece::Rook,Piece::Black));
     setItem(0, 1, Piece(Piece::Knight,Piece::Black));
@@ -349,4 +925,6 @@ void ChessBoard::setInitialPositions()
     setItem(6, 5, Piece(Piece::Pawn,Piece::White));
     setItem(6, 6, Piece(Piece::Pawn,Piece::White));
     setItem(6, 7, Piece(Piece::Pawn,Piece::White));
+
+    endUpdate();
 }
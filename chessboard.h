@@ -2,30 +2,23 @@
 #define CHESSBOARD_H
 
 #include <QGraphicsScene>
+#include <QPixmap>
+#include <QElapsedTimer>
+
+#include "piece.h"
+#include "annotations.h"
 
 class QAction;
 class QActionGroup;
-
-class Piece
-{
-public:
-    enum Type { King, Queen, Bishop, Knight, Rook, Pawn, None };
-    enum Color { White, Black };
-
-    Piece() { eType = None; eColor = White; }
-    Piece(Type t, Color c) { eType = t; eColor = c; }
-
-    bool hasSecularVariant() const { if( eType == King || eType == Bishop ) return true; else return false; }
-
-    Type type() const { return eType; }
-    Color color() const { return eColor; }
-    void setType(Type t) { eType = t; }
-    void setColor(Color c) { eColor = c; }
-
-private:
-    Type eType;
-    Color eColor;
-};
+class QMenu;
+class QGraphicsPixmapItem;
+class QIODevice;
+class QUndoStack;
+class QGraphicsRectItem;
+class BoardItem;
+class AnnotationItem;
+class Position;
+struct BoardStyle;
 
 class ChessBoard : public QGraphicsScene
 {
@@ -34,11 +27,18 @@ public:
     enum Version { Traditional, Secular };
 
     explicit ChessBoard(QObject *parent = 0);
+    ~ChessBoard();
 
+    // .chs or FEN; a .chs position is taken to be White's move
     QString toString() const;
-    void fromString(QString s);
+    bool fromString(QString s, Piece::Color *sideToMove = 0);
+
+    Position position() const;
+    void setPosition(const Position & p);
 
     inline Version version() const { return eVersion; }
+    // the name of the PieceTheme the pieces are drawn from; empty for the built-in set
+    inline QString pieceTheme() const { return sPieceTheme; }
 
     inline QColor lightSquareColor() const { return cLightSquareColor; }
     inline QColor darkSquareColor() const { return cDarkSquareColor; }
@@ -50,37 +50,155 @@ public:
     inline void setLightPieceColor(QColor c) { cLightPieceColor = c; refreshBoard(); }
     inline void setDarkPieceColor(QColor c) { cDarkPieceColor = c; refreshBoard(); }
 
+    BoardStyle style() const;
+    void setStyle(const BoardStyle & style);
+
     inline void setSvgRender(bool v) { bSvgRender = v; refreshBoard(); }
+    inline bool svgRender() const { return bSvgRender; }
+
+    // on-screen pieces are rasterized for this view zoom and device pixel ratio
+    void setPixelScale(qreal zoom, qreal dpr);
+
+    // the board is normally one item that paints every square; this builds
+    // the older scene of a rect item per square and an item per piece instead,
+    // to compare frame times
+    void setItemPerSquare(bool v);
+    inline bool itemPerSquare() const { return bItemPerSquare; }
+
+    inline Piece pieceAt(int i, int j) const { return board[i][j]; }
+    inline int squareSize() const { return nPieceWidth; }
+
+    bool writeSvg(QIODevice *device);
+    bool writeSvg(const QString & filename);
+
+    // the original export: the whole scene replayed through QSvgGenerator
+    bool writeSceneSvg(QIODevice *device);
+
+    // the built-in artwork
+    static QString pieceFilename(Piece p, Version v);
+
+    // changes made between these calls are applied together at endUpdate(),
+    // touching only the squares whose piece differs from what is displayed
+    void beginUpdate();
+    void endUpdate();
+
+    // quick placement: after a piece letter is typed (as in FEN, capitals for
+    // White; x or Delete for an empty square) each left click puts that piece
+    // on a square, until Escape
+    inline bool isPlacing() const { return bPlacing; }
+    inline Piece placement() const { return placementPiece; }
+
+    // drawn over the board and cached apart from it: changing them redraws
+    // nothing else, and changing the position does not redraw them
+    inline const Annotations & annotations() const { return mAnnotations; }
+    void setAnnotations(const Annotations & annotations);
+    inline Annotations::Color annotationColor() const { return eAnnotationColor; }
+
+    // with a stack set, every edit (a setItem, or everything between
+    // beginUpdate and endUpdate) is pushed as one undoable step
+    void setUndoStack(QUndoStack *stack);
+    inline QUndoStack* undoStack() const { return pUndoStack; }
 
 signals:
+    void placementChanged();
+    // after each edit, once any batch of changes has been applied
+    void changed();
 
 public slots:
     void setItem(int i, int j, Piece p);
     void setVersion(quint32 v);
     void setVersion(QAction *action);
+    void setPieceTheme(const QString & name);
+    void setPieceTheme(QAction *action);
     void clearBoard();
 
     void setInitialPositions();
     void setDefaultColors();
 
+    void setPlacementPiece(Piece p);
+    void stopPlacing();
+
+    void clearAnnotations();
+    void setAnnotationColor(QAction *action);
+
 private:
 
+    friend class BoardItem;
+    friend class BoardEdit;
+
+    QUndoStack *pUndoStack;
+    qint8 pendingOld[64];   // the code each square had before the current edit, or -1
+    bool bPendingEdit;
+    bool bReplaying;
+    void commitEdit();
+    void applyEdit(const QByteArray & deltas, bool undo);
+
     bool bSvgRender;
+    bool bItemPerSquare;
+    qreal rZoom;
+    qreal rDevicePixelRatio;
 
+    QMenu *pieceMenu;
     QActionGroup *changePiece;
+    QAction *clearAction, *toggleColorAction, *editSeparator;
+    QAction *textMarkAction, *clearMarksAction;
+    QAction *pieceActions[2][6];
+    int nIconVersion;
+    QString sIconTheme;
+    qreal rIconDevicePixelRatio;
     QAction* pieceMenuAction( const QString& label , Piece::Type t, Piece::Color c);
+    void buildPieceMenu();
+    void updatePieceIcons();
+
+    bool bPlacing;
+    Piece placementPiece;
+
+    // Shift+click marks a square (with Ctrl, circles it); Shift+drag draws an arrow
+    Annotations mAnnotations;
+    AnnotationItem *annotationItem;
+    Annotations::Color eAnnotationColor;
+    qint8 annotateRow, annotateCol;
+
+    // a piece being dragged: the square it came from, and the sprite that follows the mouse
+    qint8 dragRow, dragCol;
+    QPointF dragStart, dragOffset;
+    QGraphicsPixmapItem *dragSprite;
+    bool bDragCopy;
+    bool bDragSourceHidden;
+    void showDragSource(bool hidden);
+
+    QElapsedTimer dragTimer;
+    qint64 nFrameStart;
+    int nDragFrames;
+    qint64 nDragPaint, nDragMaxPaint;
+    void logDragFrames();
 
     void refreshImage(int i, int j);
+    void stylePieceItem(int i, int j);
     void refreshBoard();
     void redrawEntireBoard();
+    void restyleSquares();
 
     void drawBoard();
-    QString getPieceFilename(Piece p);
 
     Piece board[8][8];
 
-    void contextMenuEvent ( QGraphicsSceneContextMenuEvent * contextMenuEvent );
+    QGraphicsRectItem *squareItems[8][8];
+    QGraphicsItem *pieceItems[8][8];
+    BoardItem *boardItem;
+    QPixmap piecePixmaps[8][8];     // what boardItem draws, when not rendering SVG
+    bool dirty[8][8];
+    int nUpdateDepth;
 
+    void contextMenuEvent ( QGraphicsSceneContextMenuEvent * contextMenuEvent );
+    void keyPressEvent(QKeyEvent *event);
+    void mousePressEvent(QGraphicsSceneMouseEvent *event);
+    void mouseMoveEvent(QGraphicsSceneMouseEvent *event);
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event);
+    void drawBackground(QPainter *painter, const QRectF &rect);
+    void drawForeground(QPainter *painter, const QRectF &rect);
+
+    QRect squareRect(int i, int j) const { return QRect( j * nPieceWidth, i * nPieceWidth, nPieceWidth, nPieceWidth ); }
     quint8 rowFromPoint(int y) const { return y / nPieceWidth; }
     quint8 colFromPoint(int x) const { return x / nPieceWidth; }
 
@@ -98,10 +216,26 @@ private:
     qint8 focusRow, focusCol;
 
     Version eVersion;
+    QString sPieceTheme;
 
 private slots:
     void changePieceType(QAction *action);
     void toggleColor();
+    void editTextMark();
+    void clearMarks();
+};
+
+// everything about how a board looks apart from the position on it
+struct BoardStyle
+{
+    BoardStyle() : lightSquare(Qt::white), darkSquare(Qt::gray), lightPiece(Qt::black), darkPiece(Qt::black), version(ChessBoard::Traditional) { }
+
+    QColor lightSquare;
+    QColor darkSquare;
+    QColor lightPiece;
+    QColor darkPiece;
+    ChessBoard::Version version;
+    QString pieceTheme;
 };
 
 #endif // CHESSBOARD_H
@@ -0,0 +1,212 @@
+#include "collectionbrowser.h"
+
+#include <QtWidgets>
+#include "collectionfile.h"
+#include "thumbnailcache.h"
+
+CollectionModel::CollectionModel(ThumbnailCache *cache, QObject *parent) :
+    QAbstractListModel(parent)
+{
+    pCollection = 0;
+    pCache = cache;
+    connect(pCache,SIGNAL(ready(quint64)),this,SLOT(thumbnailReady(quint64)));
+}
+
+void CollectionModel::setCollection(const CollectionFile *collection)
+{
+    beginResetModel();
+    pCollection = collection;
+    requested.clear();
+    endResetModel();
+}
+
+int CollectionModel::rowCount(const QModelIndex & parent) const
+{
+    if( parent.isValid() || pCollection == 0 )
+        return 0;
+    return (int)qMin( pCollection->count(), (quint64)INT_MAX );
+}
+
+QVariant CollectionModel::data(const QModelIndex & index, int role) const
+{
+    if( !index.isValid() || pCollection == 0 )
+        return QVariant();
+
+    if( role == Qt::DecorationRole )
+    {
+        QPixmap thumbnail = pCache->thumbnail( ThumbnailCache::key( pCollection->position(index.row()) ) );
+        if( !thumbnail.isNull() )
+            return thumbnail;
+        if( placeholder.width() != pCache->size() )
+        {
+            placeholder = QPixmap( pCache->size(), pCache->size() );
+            placeholder.fill( QColor(230, 230, 230) );
+        }
+        return placeholder;
+    }
+    else if( role == Qt::DisplayRole )
+    {
+        QString title = pCollection->entry(index.row()).title;
+        return title.isEmpty() ? tr("Position %1").arg(index.row() + 1) : title;
+    }
+    else if( role == Qt::ToolTipRole )
+    {
+        CollectionEntry entry = pCollection->entry(index.row());
+        QString side = entry.sideToMove == Piece::White ? tr("White to move") : tr("Black to move");
+        QStringList lines;
+        lines << tr("%1 of %2").arg(index.row() + 1).arg(pCollection->count());
+        if( !entry.title.isEmpty() )
+            lines << entry.title;
+        if( !entry.source.isEmpty() )
+            lines << entry.source;
+        lines << side;
+        return lines.join('\n');
+    }
+    return QVariant();
+}
+
+void CollectionModel::requestThumbnails(int first, int last, int nearbyFirst, int nearbyLast)
+{
+    requested.clear();
+    if( pCollection == 0 )
+        return;
+
+    // what is in view first, then the rows just below and just above it
+    QVector<int> rows;
+    for(int row=first; row<=last; row++)
+        rows << row;
+    for(int row=last+1; row<=nearbyLast; row++)
+        rows << row;
+    for(int row=first-1; row>=nearbyFirst; row--)
+        rows << row;
+
+    QVector<Position> positions;
+    foreach(int row, rows)
+    {
+        Position p = pCollection->position(row);
+        quint64 key = ThumbnailCache::key(p);
+        if( !pCache->thumbnail(key).isNull() )
+            continue;
+        if( !requested.contains(key) )
+            positions << p;
+        requested.insert(key, row);
+    }
+    pCache->request(positions);
+}
+
+void CollectionModel::thumbnailReady(quint64 key)
+{
+    foreach(int row, requested.values(key))
+    {
+        QModelIndex i = index(row);
+        emit dataChanged(i, i, QVector<int>() << Qt::DecorationRole);
+    }
+    requested.remove(key);
+}
+
+CollectionBrowser::CollectionBrowser(QWidget *parent) :
+    QListView(parent)
+{
+    bSettingCurrent = false;
+    cache = new ThumbnailCache(this);
+    model = new CollectionModel(cache, this);
+    setModel(model);
+
+    // list mode with wrapping and uniform items lays out only what is in
+    // view; icon mode would place every item up front
+    setViewMode(QListView::ListMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(true);
+    setResizeMode(QListView::Adjust);
+    setUniformItemSizes(true);
+    setMovement(QListView::Static);
+    setSelectionMode(QAbstractItemView::SingleSelection);
+    setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setWordWrap(false);
+    setTextElideMode(Qt::ElideRight);
+
+    requestTimer = new QTimer(this);
+    requestTimer->setSingleShot(true);
+    requestTimer->setInterval(20);
+    connect(requestTimer,SIGNAL(timeout()),this,SLOT(requestThumbnails()));
+    connect(verticalScrollBar(),SIGNAL(valueChanged(int)),this,SLOT(scheduleThumbnails()));
+    connect(model,SIGNAL(modelReset()),this,SLOT(scheduleThumbnails()));
+    connect(selectionModel(),SIGNAL(currentChanged(QModelIndex,QModelIndex)),this,SLOT(chooseEntry(QModelIndex)));
+
+    setThumbnailSize(96);
+}
+
+void CollectionBrowser::setCollection(const CollectionFile *collection)
+{
+    model->setCollection(collection);
+}
+
+void CollectionBrowser::setBoardStyle(const BoardStyle & style)
+{
+    cache->setStyle(style);
+    viewport()->update();
+    scheduleThumbnails();
+}
+
+void CollectionBrowser::setThumbnailSize(int pixels)
+{
+    cache->setSize(pixels);
+    int size = cache->size();
+    setIconSize( QSize(size, size) );
+    setGridSize( QSize(size + 12, size + fontMetrics().height() + 14) );
+    viewport()->update();
+    scheduleThumbnails();
+}
+
+void CollectionBrowser::setCurrentEntry(quint64 index)
+{
+    QModelIndex i = model->index( (int)index );
+    if( !i.isValid() || i == currentIndex() )
+        return;
+    bSettingCurrent = true;
+    setCurrentIndex(i);
+    bSettingCurrent = false;
+    scrollTo(i);
+}
+
+void CollectionBrowser::resizeEvent(QResizeEvent *event)
+{
+    QListView::resizeEvent(event);
+    scheduleThumbnails();
+}
+
+void CollectionBrowser::showEvent(QShowEvent *event)
+{
+    QListView::showEvent(event);
+    scheduleThumbnails();
+}
+
+void CollectionBrowser::scheduleThumbnails()
+{
+    // a fast scroll asks once it pauses, rather than for every row it passes
+    requestTimer->start();
+}
+
+void CollectionBrowser::requestThumbnails()
+{
+    int count = model->rowCount();
+    if( !isVisible() || count == 0 )
+        return;
+
+    // the items sit on the grid, so what is in view follows from the scroll position
+    QSize grid = gridSize();
+    int columns = qMax( 1, viewport()->width() / grid.width() );
+    int firstLine = verticalScrollBar()->value() / grid.height();
+    int lines = viewport()->height() / grid.height() + 2;
+    int first = qMin( count - 1, firstLine * columns );
+    int last = qMin( count - 1, ( firstLine + lines ) * columns - 1 );
+    int screen = last - first + 1;
+
+    model->requestThumbnails( first, last, qMax(0, first - screen), qMin(count - 1, last + screen) );
+}
+
+void CollectionBrowser::chooseEntry(const QModelIndex & current)
+{
+    if( current.isValid() && !bSettingCurrent )
+        emit entryChosen( current.row() );
+}
@@ -0,0 +1,78 @@
+#ifndef COLLECTIONBROWSER_H
+#define COLLECTIONBROWSER_H
+
+#include <QListView>
+#include <QAbstractListModel>
+#include <QMultiHash>
+
+#include "chessboard.h"
+
+class CollectionFile;
+class ThumbnailCache;
+class QTimer;
+
+// The entries of a collection as rows; the decoration is the thumbnail, if
+// the cache has it. Nothing is read from the collection until a row is
+// asked for, so a model of any size costs nothing to set up.
+class CollectionModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    CollectionModel(ThumbnailCache *cache, QObject *parent = 0);
+
+    void setCollection(const CollectionFile *collection);
+    const CollectionFile * collection() const { return pCollection; }
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    // asks the cache for the thumbnails of these rows, in this order
+    void requestThumbnails(int first, int last, int nearbyFirst, int nearbyLast);
+
+private slots:
+    void thumbnailReady(quint64 key);
+
+private:
+    const CollectionFile *pCollection;
+    ThumbnailCache *pCache;
+    mutable QPixmap placeholder;
+    QMultiHash<quint64, int> requested;     // rows waiting for each thumbnail
+};
+
+// A grid of thumbnails of every position in a collection. Only the rows in
+// view are laid out and painted, and only they and a screenful either side
+// are drawn, on a pool of threads, so scrolling through even 100,000
+// positions never waits for drawing.
+class CollectionBrowser : public QListView
+{
+    Q_OBJECT
+public:
+    explicit CollectionBrowser(QWidget *parent = 0);
+
+    // the collection must stay open until another is set
+    void setCollection(const CollectionFile *collection);
+    void setBoardStyle(const BoardStyle & style);
+    void setThumbnailSize(int pixels);
+
+    void setCurrentEntry(quint64 index);
+
+signals:
+    void entryChosen(quint64 index);
+
+protected:
+    void resizeEvent(QResizeEvent *event);
+    void showEvent(QShowEvent *event);
+
+private slots:
+    void scheduleThumbnails();
+    void requestThumbnails();
+    void chooseEntry(const QModelIndex & current);
+
+private:
+    ThumbnailCache *cache;
+    CollectionModel *model;
+    QTimer *requestTimer;
+    bool bSettingCurrent;
+};
+
+#endif // COLLECTIONBROWSER_H
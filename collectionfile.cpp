@@ -0,0 +1,249 @@
+#include "collectionfile.h"
+
+#include <QtCore>
+#include <QtEndian>
+
+static const char collectionMagic[4] = { 'C', 'H', 'C', '1' };
+
+CollectionFile::CollectionFile()
+{
+    pData = 0;
+    pIndex = 0;
+    nSize = 0;
+    nCount = 0;
+    nIndexOffset = 0;
+}
+
+CollectionFile::~CollectionFile()
+{
+    close();
+}
+
+bool CollectionFile::open(const QString & filename)
+{
+    close();
+
+    file.setFileName(filename);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+
+    nSize = file.size();
+    if( nSize < HeaderSize )
+    {
+        qDebug() << "Not a collection:" << filename;
+        file.close();
+        return false;
+    }
+
+    const uchar *data = file.map(0, nSize);
+    if( data == 0 )
+    {
+        qDebug() << "Could not map:" << filename << file.errorString();
+        file.close();
+        return false;
+    }
+
+    quint64 count = qFromLittleEndian<quint64>( data + 8 );
+    quint64 indexOffset = qFromLittleEndian<quint64>( data + 16 );
+    if( memcmp(data, collectionMagic, 4) != 0
+            || qFromLittleEndian<quint32>( data + 4 ) != FormatVersion
+            || indexOffset > quint64(nSize) || count > ( quint64(nSize) - indexOffset ) / 8 )
+    {
+        qDebug() << "Not a collection, or not a complete one:" << filename;
+        file.unmap( const_cast<uchar*>(data) );
+        file.close();
+        return false;
+    }
+
+    pData = data;
+    nCount = count;
+    nIndexOffset = indexOffset;
+    pIndex = data + indexOffset;
+    return true;
+}
+
+void CollectionFile::close()
+{
+    if( pData != 0 )
+        file.unmap( const_cast<uchar*>(pData) );
+    file.close();
+    pData = 0;
+    pIndex = 0;
+    nSize = 0;
+    nCount = 0;
+    nIndexOffset = 0;
+}
+
+// the record, with its title and source, must lie between the header and
+// the index; only the records asked for are checked, so that opening a
+// collection does not read all of it
+const uchar * CollectionFile::record(quint64 index) const
+{
+    if( pData == 0 || index >= nCount )
+        return 0;
+    quint64 offset = qFromLittleEndian<quint64>( pIndex + 8 * index );
+    if( offset < HeaderSize || offset > nIndexOffset || nIndexOffset - offset < RecordHeaderSize + 32 )
+        return 0;
+    quint64 text = quint64( qFromLittleEndian<quint16>( pData + offset + 2 ) ) + qFromLittleEndian<quint16>( pData + offset + 4 );
+    if( nIndexOffset - offset - RecordHeaderSize - 32 < text )
+        return 0;
+    return pData + offset;
+}
+
+Position CollectionFile::position(quint64 index, bool *ok) const
+{
+    Position p;
+    const uchar *r = record(index);
+    if( ok != 0 )
+        *ok = r != 0;
+    if( r != 0 )
+        memcpy( p.data(), r + RecordHeaderSize, 32 );
+    return p;
+}
+
+Piece::Color CollectionFile::sideToMove(quint64 index, bool *ok) const
+{
+    const uchar *r = record(index);
+    if( ok != 0 )
+        *ok = r != 0;
+    return r != 0 && r[0] ? Piece::Black : Piece::White;
+}
+
+CollectionEntry CollectionFile::entry(quint64 index, bool *ok) const
+{
+    CollectionEntry e;
+    const uchar *r = record(index);
+    if( ok != 0 )
+        *ok = r != 0;
+    if( r == 0 )
+        return e;
+
+    quint16 titleLength = qFromLittleEndian<quint16>( r + 2 );
+    quint16 sourceLength = qFromLittleEndian<quint16>( r + 4 );
+    const char *text = reinterpret_cast<const char*>( r + RecordHeaderSize + 32 );
+
+    memcpy( e.position.data(), r + RecordHeaderSize, 32 );
+    e.sideToMove = r[0] ? Piece::Black : Piece::White;
+    e.title = QString::fromUtf8( text, titleLength );
+    e.source = QString::fromUtf8( text + titleLength, sourceLength );
+    return e;
+}
+
+CollectionWriter::CollectionWriter()
+{
+    bSkipDuplicates = false;
+    nSkipped = 0;
+}
+
+CollectionWriter::~CollectionWriter()
+{
+    if( file.isOpen() )
+        finish();
+}
+
+bool CollectionWriter::open(const QString & filename)
+{
+    offsets.clear();
+    keys.clear();
+    nSkipped = 0;
+    file.setFileName(filename);
+    if(!file.open(QFile::WriteOnly|QFile::Truncate))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+
+    // the count and index offset are filled in by finish()
+    uchar header[CollectionFile::HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, collectionMagic, 4);
+    qToLittleEndian<quint32>( CollectionFile::FormatVersion, header + 4 );
+    return file.write( reinterpret_cast<const char*>(header), sizeof(header) ) == sizeof(header);
+}
+
+bool CollectionWriter::append(const CollectionEntry & entry)
+{
+    if( bSkipDuplicates )
+    {
+        quint64 key = entry.position.key(entry.sideToMove);
+        if( keys.contains(key) )
+        {
+            nSkipped++;
+            return true;
+        }
+        keys << key;
+    }
+
+    QByteArray title = entry.title.toUtf8().left(0xFFFF);
+    QByteArray source = entry.source.toUtf8().left(0xFFFF);
+
+    uchar header[CollectionFile::RecordHeaderSize];
+    memset(header, 0, sizeof(header));
+    header[0] = entry.sideToMove == Piece::Black ? 1 : 0;
+    qToLittleEndian<quint16>( title.size(), header + 2 );
+    qToLittleEndian<quint16>( source.size(), header + 4 );
+
+    offsets << file.pos();
+    if( file.write( reinterpret_cast<const char*>(header), sizeof(header) ) != sizeof(header)
+            || file.write( reinterpret_cast<const char*>( entry.position.data() ), 32 ) != 32
+            || file.write( title ) != title.size()
+            || file.write( source ) != source.size() )
+    {
+        qDebug() << "Could not write:" << file.fileName() << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool CollectionWriter::finish()
+{
+    if( !file.isOpen() )
+        return false;
+
+    quint64 indexOffset = file.pos();
+    QByteArray index( offsets.count() * 8, Qt::Uninitialized );
+    for(int i=0; i<offsets.count(); i++)
+        qToLittleEndian<quint64>( offsets.at(i), reinterpret_cast<uchar*>( index.data() ) + 8 * i );
+    bool ok = file.write(index) == index.size();
+
+    uchar counts[16];
+    qToLittleEndian<quint64>( offsets.count(), counts );
+    qToLittleEndian<quint64>( indexOffset, counts + 8 );
+    ok = ok && file.seek(8) && file.write( reinterpret_cast<const char*>(counts), 16 ) == 16;
+
+    file.close();
+    return ok;
+}
+
+int CollectionWriter::importChsDirectory(const QString & dir)
+{
+    QDir base(dir);
+    int before = offsets.count();
+    QDirIterator it(dir, QStringList() << "*.chs", QDir::Files, QDirIterator::Subdirectories);
+    while( it.hasNext() )
+    {
+        QString path = it.next();
+        QFile chs(path);
+        if(!chs.open(QFile::ReadOnly))
+        {
+            qDebug() << "Could not open:" << path;
+            continue;
+        }
+        QByteArray text = chs.readAll();
+
+        CollectionEntry entry;
+        if( !entry.position.parse( text.constData(), text.size(), &entry.sideToMove ) )
+        {
+            qDebug() << "Could not read a position from:" << path;
+            continue;
+        }
+        entry.title = it.fileInfo().completeBaseName();
+        entry.source = base.relativeFilePath(path);
+        if( !append(entry) )
+            break;
+    }
+    return offsets.count() - before;
+}
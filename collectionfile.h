@@ -0,0 +1,90 @@
+#ifndef COLLECTIONFILE_H
+#define COLLECTIONFILE_H
+
+#include <QFile>
+#include <QVector>
+#include <QSet>
+
+#include "position.h"
+
+// A collection (.chc) holds many positions with a title, a source and the
+// side to move. The file is little-endian:
+//
+//   header   "CHC1", quint32 format version, quint64 count, quint64 index offset
+//   records  quint8 side to move, quint8 0, quint16 title bytes, quint16 source bytes,
+//            quint16 0, 32 bytes of Position, then the UTF-8 title and source
+//   index    count quint64 record offsets
+//
+// The reader maps the file and finds a record through the index, so any
+// position is reached in constant time without reading the rest.
+
+struct CollectionEntry
+{
+    CollectionEntry() { sideToMove = Piece::White; }
+
+    Position position;
+    Piece::Color sideToMove;
+    QString title;
+    QString source;
+};
+
+class CollectionFile
+{
+public:
+    enum { FormatVersion = 1, HeaderSize = 24, RecordHeaderSize = 8 };
+
+    CollectionFile();
+    ~CollectionFile();
+
+    bool open(const QString & filename);
+    void close();
+    bool isOpen() const { return pData != 0; }
+
+    QString fileName() const { return file.fileName(); }
+    quint64 count() const { return nCount; }
+
+    // open() checks only the header and the index, so that it takes the same
+    // time for any size of file; a record is checked when it is read, and one
+    // that does not lie within the file gives an empty entry and sets ok to false
+    Position position(quint64 index, bool *ok = 0) const;
+    Piece::Color sideToMove(quint64 index, bool *ok = 0) const;
+    CollectionEntry entry(quint64 index, bool *ok = 0) const;
+
+private:
+    const uchar * record(quint64 index) const;
+
+    QFile file;
+    const uchar *pData;
+    qint64 nSize;
+    quint64 nCount;
+    quint64 nIndexOffset;
+    const uchar *pIndex;
+};
+
+class CollectionWriter
+{
+public:
+    CollectionWriter();
+    ~CollectionWriter();
+
+    bool open(const QString & filename);
+    // with skipDuplicates, entries whose board and side to move are already in the file are left out
+    void setSkipDuplicates(bool skip) { bSkipDuplicates = skip; }
+    bool append(const CollectionEntry & entry);
+    bool finish(); // writes the index; the file is incomplete until this is called
+
+    quint64 count() const { return offsets.count(); }
+    quint64 skipped() const { return nSkipped; }
+
+    // streams every .chs file below dir into the collection; returns the number imported
+    int importChsDirectory(const QString & dir);
+
+private:
+    QFile file;
+    QVector<quint64> offsets;
+    bool bSkipDuplicates;
+    QSet<quint64> keys;
+    quint64 nSkipped;
+};
+
+#endif // COLLECTIONFILE_H
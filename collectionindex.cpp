@@ -0,0 +1,209 @@
+#include "collectionindex.h"
+
+#include <QtCore>
+#include <QtEndian>
+#include <algorithm>
+
+#include "collectionfile.h"
+
+static const char indexMagic[4] = { 'C', 'H', 'X', '1' };
+
+struct KeyEntry
+{
+    quint64 key;
+    quint64 index;
+
+    bool operator<(const KeyEntry & other) const { return key < other.key || ( key == other.key && index < other.index ); }
+};
+
+CollectionIndex::CollectionIndex()
+{
+    pData = 0;
+    pPositions = 0;
+    pKeys = 0;
+    nCount = 0;
+}
+
+CollectionIndex::~CollectionIndex()
+{
+    close();
+}
+
+QString CollectionIndex::fileNameFor(const QString & collectionFileName)
+{
+    QFileInfo info(collectionFileName);
+    return info.absoluteDir().absoluteFilePath( info.completeBaseName() + ".chx" );
+}
+
+bool CollectionIndex::build(const CollectionFile & collection, const QString & filename)
+{
+    QFile out(filename);
+    if(!out.open(QFile::WriteOnly|QFile::Truncate))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+
+    uchar header[HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, indexMagic, 4);
+    qToLittleEndian<quint32>( FormatVersion, header + 4 );
+    qToLittleEndian<quint64>( collection.count(), header + 8 );
+    QFileInfo info( collection.fileName() );
+    qToLittleEndian<quint64>( info.size(), header + 16 );
+    qToLittleEndian<quint64>( info.lastModified().toMSecsSinceEpoch(), header + 24 );
+    bool ok = out.write( reinterpret_cast<const char*>(header), sizeof(header) ) == sizeof(header);
+
+    // positions go out in blocks as they are read; the keys are sorted at the end
+    QVector<KeyEntry> keys;
+    keys.reserve( collection.count() );
+    QByteArray block;
+    for(quint64 i=0; i<collection.count() && ok; i++)
+    {
+        Position p = collection.position(i);
+        KeyEntry k;
+        k.key = p.key( collection.sideToMove(i) );
+        k.index = i;
+        keys << k;
+
+        block.append( reinterpret_cast<const char*>( p.data() ), 32 );
+        if( block.size() >= 1 << 20 || i + 1 == collection.count() )
+        {
+            ok = out.write(block) == block.size();
+            block.clear();
+        }
+    }
+
+    std::sort( keys.begin(), keys.end() );
+    QByteArray keyData( keys.count() * 16, Qt::Uninitialized );
+    uchar *d = reinterpret_cast<uchar*>( keyData.data() );
+    for(int i=0; i<keys.count(); i++)
+    {
+        qToLittleEndian<quint64>( keys.at(i).key, d + 16 * i );
+        qToLittleEndian<quint64>( keys.at(i).index, d + 16 * i + 8 );
+    }
+    ok = ok && out.write(keyData) == keyData.size();
+
+    if( !ok )
+    {
+        qDebug() << "Could not write:" << filename << out.errorString();
+        out.close();
+        out.remove();
+        return false;
+    }
+    return true;
+}
+
+bool CollectionIndex::open(const QString & filename, const CollectionFile & collection)
+{
+    close();
+
+    file.setFileName(filename);
+    if(!file.open(QFile::ReadOnly))
+        return false;
+
+    qint64 size = file.size();
+    if( size < HeaderSize )
+    {
+        file.close();
+        return false;
+    }
+    const uchar *data = file.map(0, size);
+    if( data == 0 )
+    {
+        qDebug() << "Could not map:" << filename << file.errorString();
+        file.close();
+        return false;
+    }
+
+    // a collection rewritten in place keeps its size and count, but not its modification time
+    QFileInfo info( collection.fileName() );
+    quint64 count = qFromLittleEndian<quint64>( data + 8 );
+    if( memcmp(data, indexMagic, 4) != 0
+            || qFromLittleEndian<quint32>( data + 4 ) != FormatVersion
+            || count != collection.count()
+            || qFromLittleEndian<quint64>( data + 16 ) != quint64( info.size() )
+            || qFromLittleEndian<quint64>( data + 24 ) != quint64( info.lastModified().toMSecsSinceEpoch() )
+            || quint64(size) != HeaderSize + count * 48 )
+    {
+        file.unmap( const_cast<uchar*>(data) );
+        file.close();
+        return false;
+    }
+
+    pData = data;
+    nCount = count;
+    pPositions = data + HeaderSize;
+    pKeys = data + HeaderSize + count * 32;
+    return true;
+}
+
+bool CollectionIndex::openOrBuild(const CollectionFile & collection)
+{
+    QString filename = fileNameFor( collection.fileName() );
+    if( open(filename, collection) )
+        return true;
+    return build(collection, filename) && open(filename, collection);
+}
+
+void CollectionIndex::close()
+{
+    if( pData != 0 )
+        file.unmap( const_cast<uchar*>(pData) );
+    file.close();
+    pData = 0;
+    pPositions = 0;
+    pKeys = 0;
+    nCount = 0;
+}
+
+quint64 CollectionIndex::keyAt(quint64 i) const
+{
+    return qFromLittleEndian<quint64>( pKeys + 16 * i );
+}
+
+quint64 CollectionIndex::indexAt(quint64 i) const
+{
+    return qFromLittleEndian<quint64>( pKeys + 16 * i + 8 );
+}
+
+QList<quint64> CollectionIndex::find(quint64 key) const
+{
+    // lower bound
+    quint64 low = 0, high = nCount;
+    while( low < high )
+    {
+        quint64 middle = low + ( high - low ) / 2;
+        if( keyAt(middle) < key )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    QList<quint64> result;
+    for(quint64 i=low; i<nCount && keyAt(i) == key; i++)
+        result << indexAt(i);
+    return result;
+}
+
+QList< QList<quint64> > CollectionIndex::duplicates() const
+{
+    QList< QList<quint64> > groups;
+    quint64 i = 0;
+    while( i < nCount )
+    {
+        quint64 key = keyAt(i);
+        quint64 end = i + 1;
+        while( end < nCount && keyAt(end) == key )
+            end++;
+        if( end - i > 1 )
+        {
+            QList<quint64> group;
+            for(quint64 j=i; j<end; j++)
+                group << indexAt(j);
+            groups << group;
+        }
+        i = end;
+    }
+    return groups;
+}
@@ -0,0 +1,58 @@
+#ifndef COLLECTIONINDEX_H
+#define COLLECTIONINDEX_H
+
+#include <QFile>
+#include <QList>
+
+class CollectionFile;
+
+// An index (.chx) beside a collection, for finding positions without
+// reading the collection's records. It is little-endian:
+//
+//   header     "CHX1", quint32 format version, quint64 count,
+//              quint64 size and quint64 modification time (ms since the
+//              epoch) of the collection file when indexed
+//   positions  count packed Positions of 32 bytes, in collection order
+//   keys       count pairs of quint64 Zobrist key (board and side to move)
+//              and quint64 collection index, sorted by key
+//
+// The positions lie back to back so that PositionQuery can scan them; the
+// sorted keys make finding a position, or every duplicate, a matter of a
+// binary search or a single pass.
+class CollectionIndex
+{
+public:
+    enum { FormatVersion = 2, HeaderSize = 32 };
+
+    CollectionIndex();
+    ~CollectionIndex();
+
+    static QString fileNameFor(const QString & collectionFileName);
+    static bool build(const CollectionFile & collection, const QString & filename);
+
+    // fails if the index does not belong to the collection as it now is
+    bool open(const QString & filename, const CollectionFile & collection);
+    // opens the index beside the collection, building it first if it is missing or out of date
+    bool openOrBuild(const CollectionFile & collection);
+    void close();
+
+    quint64 count() const { return nCount; }
+    const quint8 * positions() const { return pPositions; }
+
+    // collection indexes of the positions with this key
+    QList<quint64> find(quint64 key) const;
+    // groups of collection indexes that share a key, each group in collection order
+    QList< QList<quint64> > duplicates() const;
+
+private:
+    quint64 keyAt(quint64 i) const;
+    quint64 indexAt(quint64 i) const;
+
+    QFile file;
+    const uchar *pData;
+    const quint8 *pPositions;
+    const uchar *pKeys;
+    quint64 nCount;
+};
+
+#endif // COLLECTIONINDEX_H
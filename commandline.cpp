@@ -0,0 +1,472 @@
+#include "commandline.h"
+
+#include <QtCore>
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+
+#include "batchrenderer.h"
+#include "collectionfile.h"
+#include "pgnrenderer.h"
+#include "batchsolver.h"
+#include "collectionindex.h"
+#include "positionquery.h"
+#include "renderserver.h"
+#include "pagecomposer.h"
+#include "enginepool.h"
+#include "animationwriter.h"
+
+// options that select a mode without a window
+static const char * const headlessOptions[] = { "render", "import", "pgn", "solve", "index", "duplicates", "query", "serve", "compose", "frame-times", "analyse", "animate", 0 };
+
+// times whole-board repaints, one-square repaints after a piece changes, and
+// hit tests, for the current scene or the older one with an item per square
+static void measureFrames(bool itemPerSquare, int frames, QTextStream & out)
+{
+    ChessBoard board;
+    board.setItemPerSquare(itemPerSquare);
+    board.setInitialPositions();
+
+    const int edge = 8 * board.squareSize();
+    QImage image(edge, edge, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int n=0; n<frames; n++)
+        board.render( &painter, QRectF(0, 0, edge, edge), QRectF(0, 0, edge, edge) );
+    qint64 full = timer.nsecsElapsed();
+
+    timer.restart();
+    for(int n=0; n<frames; n++)
+    {
+        int i = n % 8, j = ( n / 8 ) % 8;
+        board.setItem( i, j, n % 2 ? Piece() : Piece(Piece::Knight, Piece::White) );
+        QRectF square( j * board.squareSize(), i * board.squareSize(), board.squareSize(), board.squareSize() );
+        board.render( &painter, square, square );
+    }
+    qint64 single = timer.nsecsElapsed();
+
+    const int hits = frames * 100;
+    int found = 0;
+    timer.restart();
+    for(int n=0; n<hits; n++)
+        found += board.items( QPointF( ( n * 7 ) % edge, ( n * 13 ) % edge ) ).count();
+    qint64 hitTests = timer.nsecsElapsed();
+    painter.end();
+
+    out << QString("%1: full frame %2 ms, one square %3 us, hit test %4 us (%5 items, %6 under a point)")
+           .arg( itemPerSquare ? "item per square" : "single item" )
+           .arg( full / 1e6 / frames, 0, 'f', 3 ).arg( single / 1e3 / frames, 0, 'f', 1 )
+           .arg( hitTests / 1e3 / hits, 0, 'f', 2 ).arg( board.items().count() )
+           .arg( (double)found / hits, 0, 'f', 1 ) << Qt::endl;
+}
+
+bool CommandLine::isHeadless(int argc, char *argv[])
+{
+    for(int i=1; i<argc; i++)
+    {
+        QByteArray arg(argv[i]);
+        for(int j=0; headlessOptions[j] != 0; j++)
+        {
+            QByteArray option = QByteArray("--") + headlessOptions[j];
+            if( arg == option || arg.startsWith(option + "=") )
+                return true;
+        }
+    }
+    return false;
+}
+
+CommandLine::CommandLine(const QStringList & arguments)
+{
+    args = arguments;
+}
+
+int CommandLine::exec()
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Chess diagram editor. Without arguments the editor window is shown.");
+    parser.addHelpOption();
+
+    QCommandLineOption renderOption("render", "Render a .chs file, a directory of .chs files, a collection (.chc), or a list file of positions to SVG.", "path");
+    QCommandLineOption importOption("import", "Import every .chs file below a directory into the collection given with --to.", "dir");
+    QCommandLineOption toOption("to", "Collection file (.chc) to write, with --compose the .pdf or .svg document, or with --animate the animation.", "file");
+    QCommandLineOption pgnOption("pgn", "Render a diagram for every ply of every game in a PGN file.", "file");
+    QCommandLineOption taggedOption("tagged", "With --pgn, only render positions after moves marked with $201 or a [#] comment.");
+    QCommandLineOption solveOption("solve", "Find the shortest mate in each position of a collection (.chc), .chs file or list file, and report positions with more than one key move.", "path");
+    QCommandLineOption mateOption("mate", "With --solve, the most moves to look for a mate in.", "n", "3");
+    QCommandLineOption uniqueOption("unique", "With --import, leave out positions that are already in the collection.");
+    QCommandLineOption indexOption("index", "Build the position index (.chx) for a collection.", "file");
+    QCommandLineOption duplicatesOption("duplicates", "List the positions that occur more than once in a collection.", "file");
+    QCommandLineOption queryOption("query", "List the positions in the collection given with --in that match a pattern such as \"Kg1 q7\".", "pattern");
+    QCommandLineOption inOption("in", "Collection file (.chc) to search.", "file");
+    QCommandLineOption serveOption("serve", "Keep running and render diagrams on request, on a port of localhost or a local socket with this name.", "port or name");
+    QCommandLineOption cacheOption("cache-mb", "With --serve, megabytes of finished diagrams to keep.", "n", "64");
+    QCommandLineOption pngOption("png", "With --render, write PNG images this many pixels wide instead of SVG.", "pixels");
+    QCommandLineOption dpiOption("dpi", "Resolution recorded in PNG images.", "dpi", "600");
+    QCommandLineOption composeOption("compose", "Lay out the positions of a collection (.chc), .chs file, directory or list file on pages, written to the .pdf or .svg file given with --to.", "path");
+    QCommandLineOption columnsOption("columns", "With --compose, diagrams across a page.", "n", "2");
+    QCommandLineOption rowsOption("rows", "With --compose, diagrams down a page.", "n", "3");
+    QCommandLineOption pageSizeOption("page-size", "With --compose, a4, a5 or letter.", "size", "a4");
+    QCommandLineOption animateOption("animate", "Animate the moves of a PGN game, or the positions of a collection (.chc) or list file in order, written to the .png (APNG), .gif or .svg file given with --to.", "path");
+    QCommandLineOption delayOption("delay", "With --animate, milliseconds each position is shown; the last is shown three times as long.", "ms", "1000");
+    QCommandLineOption squareOption("square", "With --animate, the width of a square in pixels.", "pixels", "45");
+    QCommandLineOption analyseOption("analyse", "Evaluate each position of a collection (.chc), .chs file or list file with the UCI engine given with --engine, running one copy of the engine per thread.", "path");
+    QCommandLineOption engineOption("engine", "UCI engine program for --analyse.", "program");
+    QCommandLineOption depthOption("depth", "With --analyse, the depth to search each position to.", "plies", "20");
+    QCommandLineOption movetimeOption("movetime", "With --analyse, search each position for this long instead of to a depth.", "ms");
+    QCommandLineOption frameTimesOption("frame-times", "Time this many repaints of the board as one item and as an item per square.", "frames");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Directory for rendered files.", "dir", ".");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of worker threads.", "n", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption sceneSvgOption("scene-svg", "Write SVG by replaying the scene through QSvgGenerator, as older versions did, for comparison.");
+    QCommandLineOption secularOption("secular", "Use the secularized pieces.");
+    QCommandLineOption piecesOption("pieces", "Draw the pieces from this piece set rather than the built-in one.", "name");
+    QCommandLineOption lightSquareOption("light-square", "Light square color.", "color", "#ffffff");
+    QCommandLineOption darkSquareOption("dark-square", "Dark square color.", "color", "#a0a0a0");
+    QCommandLineOption lightPieceOption("light-piece", "Light piece color.", "color", "#000000");
+    QCommandLineOption darkPieceOption("dark-piece", "Dark piece color.", "color", "#000000");
+
+    parser.addOption(renderOption);
+    parser.addOption(importOption);
+    parser.addOption(toOption);
+    parser.addOption(pgnOption);
+    parser.addOption(taggedOption);
+    parser.addOption(solveOption);
+    parser.addOption(mateOption);
+    parser.addOption(uniqueOption);
+    parser.addOption(indexOption);
+    parser.addOption(duplicatesOption);
+    parser.addOption(queryOption);
+    parser.addOption(inOption);
+    parser.addOption(serveOption);
+    parser.addOption(cacheOption);
+    parser.addOption(pngOption);
+    parser.addOption(dpiOption);
+    parser.addOption(composeOption);
+    parser.addOption(columnsOption);
+    parser.addOption(rowsOption);
+    parser.addOption(pageSizeOption);
+    parser.addOption(animateOption);
+    parser.addOption(delayOption);
+    parser.addOption(squareOption);
+    parser.addOption(analyseOption);
+    parser.addOption(engineOption);
+    parser.addOption(depthOption);
+    parser.addOption(movetimeOption);
+    parser.addOption(frameTimesOption);
+    parser.addOption(outputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(sceneSvgOption);
+    parser.addOption(secularOption);
+    parser.addOption(piecesOption);
+    parser.addOption(lightSquareOption);
+    parser.addOption(darkSquareOption);
+    parser.addOption(lightPieceOption);
+    parser.addOption(darkPieceOption);
+
+    parser.process(args);
+
+    BoardStyle style;
+    style.version = parser.isSet(secularOption) ? ChessBoard::Secular : ChessBoard::Traditional;
+    style.pieceTheme = parser.value(piecesOption);
+    style.lightSquare = QColor( parser.value(lightSquareOption) );
+    style.darkSquare = QColor( parser.value(darkSquareOption) );
+    style.lightPiece = QColor( parser.value(lightPieceOption) );
+    style.darkPiece = QColor( parser.value(darkPieceOption) );
+
+    if( parser.isSet(renderOption) )
+    {
+        BatchRenderer renderer;
+        renderer.setOutputDirectory( parser.value(outputOption) );
+        renderer.setThreadCount( qMax(1, parser.value(threadsOption).toInt()) );
+        renderer.setSceneSvg( parser.isSet(sceneSvgOption) );
+        renderer.setPngSize( qMax(0, parser.value(pngOption).toInt()) );
+        renderer.setDotsPerInch( qMax(1, parser.value(dpiOption).toInt()) );
+        renderer.setStyle( style );
+
+        foreach(QString path, parser.values(renderOption))
+        {
+            if( !renderer.addInput(path) )
+                return 1;
+        }
+        if( renderer.jobCount() == 0 )
+        {
+            err << "No positions found." << Qt::endl;
+            return 1;
+        }
+        return renderer.render(out) == 0 ? 0 : 1;
+    }
+
+    if( parser.isSet(frameTimesOption) )
+    {
+        int frames = qMax(1, parser.value(frameTimesOption).toInt());
+        measureFrames(true, frames, out);
+        measureFrames(false, frames, out);
+        return 0;
+    }
+
+    if( parser.isSet(composeOption) )
+    {
+        if( !parser.isSet(toOption) )
+        {
+            err << "--compose needs a document to write, given with --to." << Qt::endl;
+            return 1;
+        }
+        QString pageSize = parser.value(pageSizeOption).toLower();
+        QSizeF points;
+        if( pageSize == "a4" )
+            points = QSizeF(595.28, 841.89);
+        else if( pageSize == "a5" )
+            points = QSizeF(419.53, 595.28);
+        else if( pageSize == "letter" )
+            points = QSizeF(612, 792);
+        else
+        {
+            err << "The page size must be a4, a5 or letter." << Qt::endl;
+            return 1;
+        }
+
+        PageComposer composer;
+        composer.setStyle( style );
+        composer.setGrid( parser.value(columnsOption).toInt(), parser.value(rowsOption).toInt() );
+        composer.setPageSize( points );
+        composer.setThreadCount( qMax(1, parser.value(threadsOption).toInt()) );
+        foreach(QString path, parser.values(composeOption))
+        {
+            if( !composer.addInput(path) )
+                return 1;
+        }
+        if( composer.diagramCount() == 0 )
+        {
+            err << "No positions found." << Qt::endl;
+            return 1;
+        }
+        if( !composer.write( parser.value(toOption) ) )
+            return 1;
+        out << QString("Composed %1 diagrams on %2 pages in %3 ms (%4 bytes)")
+               .arg(composer.diagramCount()).arg(composer.pageCount()).arg(composer.milliseconds())
+               .arg( QFileInfo( parser.value(toOption) ).size() ) << Qt::endl;
+        if( composer.skipped() > 0 )
+            out << QString("Left out %1 positions that could not be read").arg(composer.skipped()) << Qt::endl;
+        return 0;
+    }
+
+    if( parser.isSet(animateOption) )
+    {
+        if( !parser.isSet(toOption) )
+        {
+            err << "--animate needs a file to write, given with --to." << Qt::endl;
+            return 1;
+        }
+        bool ok;
+        int square = parser.value(squareOption).toInt(&ok);
+        if( !ok || square < 1 || square > AnimationWriter::MaxSquareSize )
+        {
+            err << QString("--square must be from 1 to %1 pixels.").arg(AnimationWriter::MaxSquareSize) << Qt::endl;
+            return 1;
+        }
+        // the last position is shown three times as long, and must fit too
+        int delay = parser.value(delayOption).toInt(&ok);
+        if( !ok || delay < AnimationWriter::MinDelay || delay > AnimationWriter::MaxDelay / 3 )
+        {
+            err << QString("--delay must be from %1 to %2 ms.").arg(AnimationWriter::MinDelay).arg(AnimationWriter::MaxDelay / 3) << Qt::endl;
+            return 1;
+        }
+        AnimationWriter writer;
+        writer.setStyle( style );
+        writer.setSquareSize( square );
+        writer.setDelays( delay, delay * 3 );
+        writer.setThreadCount( qMax(1, parser.value(threadsOption).toInt()) );
+        foreach(QString path, parser.values(animateOption))
+        {
+            if( !writer.addInput(path) )
+                return 1;
+        }
+        if( writer.frameCount() == 0 )
+        {
+            err << "No positions found." << Qt::endl;
+            return 1;
+        }
+        if( !writer.write( parser.value(toOption) ) )
+            return 1;
+        out << QString("Animated %1 positions in %2 ms (%3 bytes, %4% of the pixels of whole frames)")
+               .arg(writer.frameCount()).arg(writer.milliseconds())
+               .arg( QFileInfo( parser.value(toOption) ).size() )
+               .arg( writer.fractionEncoded() * 100, 0, 'f', 1 ) << Qt::endl;
+        if( writer.skipped() > 0 )
+            out << QString("Left out %1 positions that could not be read").arg(writer.skipped()) << Qt::endl;
+        return 0;
+    }
+
+    if( parser.isSet(analyseOption) )
+    {
+        if( !parser.isSet(engineOption) )
+        {
+            err << "--analyse needs an engine, given with --engine." << Qt::endl;
+            return 1;
+        }
+        EnginePool pool;
+        pool.setEngine( parser.value(engineOption) );
+        pool.setEngineCount( qMax(1, parser.value(threadsOption).toInt()) );
+        if( parser.isSet(movetimeOption) )
+            pool.setLimits( 0, qMax(1, parser.value(movetimeOption).toInt()) );
+        else
+            pool.setLimits( qMax(1, parser.value(depthOption).toInt()), 0 );
+        foreach(QString path, parser.values(analyseOption))
+        {
+            if( !pool.addInput(path) )
+                return 1;
+        }
+        if( pool.jobCount() == 0 )
+        {
+            err << "No positions found." << Qt::endl;
+            return 1;
+        }
+        return pool.analyse(out) == 0 ? 0 : 1;
+    }
+
+    if( parser.isSet(serveOption) )
+    {
+        RenderServer server;
+        server.setDefaultStyle( style );
+        server.setCacheSize( qMax(0, parser.value(cacheOption).toInt()) );
+        if( !server.listen( parser.value(serveOption) ) )
+            return 1;
+        out << "Serving on " << parser.value(serveOption) << Qt::endl;
+        return QCoreApplication::exec();
+    }
+
+    if( parser.isSet(pgnOption) )
+    {
+        PgnRenderer renderer;
+        renderer.setOutputDirectory( parser.value(outputOption) );
+        renderer.setThreadCount( qMax(1, parser.value(threadsOption).toInt()) );
+        renderer.setStyle( style );
+        renderer.setDiagrams( parser.isSet(taggedOption) ? PgnRenderer::TaggedMoves : PgnRenderer::EveryPly );
+        return renderer.render( parser.value(pgnOption), out ) ? 0 : 1;
+    }
+
+    if( parser.isSet(solveOption) )
+    {
+        BatchSolver solver;
+        solver.setThreadCount( qMax(1, parser.value(threadsOption).toInt()) );
+        solver.setMaxMoves( qMax(1, parser.value(mateOption).toInt()) );
+        foreach(QString path, parser.values(solveOption))
+        {
+            if( !solver.addInput(path) )
+                return 1;
+        }
+        if( solver.jobCount() == 0 )
+        {
+            err << "No positions found." << Qt::endl;
+            return 1;
+        }
+        return solver.solve(out) == 0 ? 0 : 1;
+    }
+
+    if( parser.isSet(importOption) )
+    {
+        if( !parser.isSet(toOption) )
+        {
+            err << "--import needs a collection to write, given with --to." << Qt::endl;
+            return 1;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        CollectionWriter writer;
+        writer.setSkipDuplicates( parser.isSet(uniqueOption) );
+        if( !writer.open( parser.value(toOption) ) )
+            return 1;
+        int imported = 0;
+        foreach(QString dir, parser.values(importOption))
+            imported += writer.importChsDirectory(dir);
+        if( !writer.finish() )
+            return 1;
+        out << QString("Imported %1 positions in %2 ms").arg(imported).arg(timer.elapsed()) << Qt::endl;
+        if( writer.skipped() > 0 )
+            out << QString("Left out %1 duplicates").arg(writer.skipped()) << Qt::endl;
+        return 0;
+    }
+
+    if( parser.isSet(indexOption) )
+    {
+        CollectionFile collection;
+        if( !collection.open( parser.value(indexOption) ) )
+            return 1;
+        QElapsedTimer timer;
+        timer.start();
+        if( !CollectionIndex::build( collection, CollectionIndex::fileNameFor(collection.fileName()) ) )
+            return 1;
+        out << QString("Indexed %1 positions in %2 ms").arg(collection.count()).arg(timer.elapsed()) << Qt::endl;
+        return 0;
+    }
+
+    if( parser.isSet(duplicatesOption) )
+    {
+        CollectionFile collection;
+        CollectionIndex index;
+        if( !collection.open( parser.value(duplicatesOption) ) || !index.openOrBuild(collection) )
+            return 1;
+
+        QElapsedTimer timer;
+        timer.start();
+        QList< QList<quint64> > groups = index.duplicates();
+        qint64 elapsed = timer.elapsed();
+
+        quint64 extra = 0;
+        foreach(QList<quint64> group, groups)
+        {
+            QStringList names;
+            foreach(quint64 i, group)
+            {
+                QString title = collection.entry(i).title;
+                names << ( title.isEmpty() ? QString::number(i + 1) : QString("%1 (%2)").arg(i + 1).arg(title) );
+            }
+            out << names.join(", ") << Qt::endl;
+            extra += group.count() - 1;
+        }
+        out << QString("%1 positions occur more than once; %2 copies could be removed (%3 ms)")
+               .arg(groups.count()).arg(extra).arg(elapsed) << Qt::endl;
+        return 0;
+    }
+
+    if( parser.isSet(queryOption) )
+    {
+        PositionQuery query;
+        if( !query.parse( parser.value(queryOption) ) )
+        {
+            err << query.errorString() << Qt::endl;
+            return 1;
+        }
+        if( !parser.isSet(inOption) )
+        {
+            err << "--query needs a collection to search, given with --in." << Qt::endl;
+            return 1;
+        }
+        CollectionFile collection;
+        CollectionIndex index;
+        if( !collection.open( parser.value(inOption) ) || !index.openOrBuild(collection) )
+            return 1;
+
+        QElapsedTimer timer;
+        timer.start();
+        QList<quint64> matches = query.search( index.positions(), index.count(), qMax(1, parser.value(threadsOption).toInt()) );
+        qint64 elapsed = timer.elapsed();
+
+        foreach(quint64 i, matches)
+        {
+            QString title = collection.entry(i).title;
+            out << ( i + 1 ) << ( title.isEmpty() ? QString() : "\t" + title ) << Qt::endl;
+        }
+        out << QString("%1 of %2 positions match (%3 ms)").arg(matches.count()).arg(index.count()).arg(elapsed) << Qt::endl;
+        return 0;
+    }
+
+    parser.showHelp(1);
+    return 1;
+}
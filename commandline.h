@@ -0,0 +1,20 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QStringList>
+
+class CommandLine
+{
+public:
+    // true if the arguments ask for a mode that runs without a window
+    static bool isHeadless(int argc, char *argv[]);
+
+    explicit CommandLine(const QStringList & arguments);
+
+    int exec();
+
+private:
+    QStringList args;
+};
+
+#endif // COMMANDLINE_H
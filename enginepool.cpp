@@ -0,0 +1,198 @@
+#include "enginepool.h"
+
+#include <QtCore>
+#include "positionsource.h"
+
+EnginePool::EnginePool(QObject *parent) :
+    QObject(parent)
+{
+    nEngines = QThread::idealThreadCount();
+    nDepth = 20;
+    nMilliseconds = 0;
+    nTimeout = 5 * 60 * 1000;
+    nNext = 0;
+    nWritten = 0;
+    nFailed = 0;
+    pReport = 0;
+    pLoop = 0;
+    nElapsed = 0;
+
+    watchdog = new QTimer(this);
+    connect(watchdog,SIGNAL(timeout()),this,SLOT(checkTimeouts()));
+}
+
+bool EnginePool::addInput(const QString & path)
+{
+    PositionSource source;
+    if( !source.addInput(path) )
+        return false;
+    // a position that cannot be read keeps its place in the report, as a failure
+    foreach(const PositionSource::Item & item, source.items())
+    {
+        CollectionEntry entry;
+        Job job;
+        job.name = item.name();
+        job.readable = item.read(&entry);
+        job.position = entry.position;
+        job.sideToMove = entry.sideToMove;
+        jobs << job;
+    }
+    return true;
+}
+
+void EnginePool::addPosition(const Position & position, Piece::Color sideToMove, const QString & name)
+{
+    Job job;
+    job.name = name;
+    job.position = position;
+    job.sideToMove = sideToMove;
+    jobs << job;
+}
+
+int EnginePool::analyse(QTextStream & report)
+{
+    evaluations = QVector<EngineEvaluation>( jobs.count() );
+    lines = QVector<QString>( jobs.count() );
+    nNext = 0;
+    nWritten = 0;
+    nFailed = 0;
+    pReport = &report;
+    if( jobs.isEmpty() )
+        return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    clock.start();
+    watchdog->start( qBound(10, nTimeout / 4, 1000) );
+
+    QEventLoop loop;
+    pLoop = &loop;
+    int count = qMin( nEngines, jobs.count() );
+    for(int i=0; i<count; i++)
+    {
+        UciEngine *engine = new UciEngine(this);
+        engine->setLimits(nDepth, nMilliseconds);
+        // the engines share the cores between them
+        engine->setOption("Threads", "1");
+        connect(engine,SIGNAL(ready()),this,SLOT(engineReady()));
+        connect(engine,SIGNAL(finished(EngineEvaluation)),this,SLOT(engineFinished(EngineEvaluation)));
+        connect(engine,SIGNAL(error(QString)),this,SLOT(engineError(QString)));
+        engines << engine;
+        deadlines.insert(engine, clock.elapsed() + nTimeout);
+        engine->start(sProgram, slArguments);
+    }
+    // every engine may have failed to start already
+    if( nWritten < jobs.count() )
+        loop.exec();
+    pLoop = 0;
+    nElapsed = timer.elapsed();
+    watchdog->stop();
+
+    foreach(UciEngine *engine, engines)
+        engine->quit();
+    qDeleteAll(engines);
+    engines.clear();
+    running.clear();
+    deadlines.clear();
+
+    report << QString("Analysed %1 positions in %2 ms with %3 engines (%4 positions/s), %5 not analysed")
+              .arg(jobs.count() - nFailed).arg(nElapsed).arg(count)
+              .arg( nElapsed > 0 ? ( jobs.count() - nFailed ) * 1000.0 / nElapsed : 0.0, 0, 'f', 1 )
+              .arg(nFailed) << Qt::endl;
+    pReport = 0;
+    return nFailed;
+}
+
+void EnginePool::engineReady()
+{
+    dispatch( qobject_cast<UciEngine*>(sender()) );
+}
+
+void EnginePool::engineFinished(const EngineEvaluation & evaluation)
+{
+    UciEngine *engine = qobject_cast<UciEngine*>(sender());
+    if( !running.contains(engine) )
+        return;
+    int i = running.take(engine);
+
+    // the engine gets its next position before anything is written
+    dispatch(engine);
+
+    evaluations[i] = evaluation;
+    lines[i] = QString("%1\t%2\tdepth %3\t%4\t%5").arg(jobs.at(i).name).arg(evaluation.scoreText())
+            .arg(evaluation.depth).arg(evaluation.bestMove).arg(evaluation.pv.join(' '));
+    flush();
+}
+
+void EnginePool::engineError(const QString & message)
+{
+    dropEngine( qobject_cast<UciEngine*>(sender()), message );
+}
+
+void EnginePool::checkTimeouts()
+{
+    qint64 now = clock.elapsed();
+    foreach(UciEngine *engine, deadlines.keys())
+    {
+        if( deadlines.value(engine) > now )
+            continue;
+        qDebug() << "No answer from" << engine->name() << "within" << nTimeout << "ms";
+        engine->kill();
+        dropEngine( engine, tr("no answer within %1 ms").arg(nTimeout) );
+    }
+}
+
+void EnginePool::dropEngine(UciEngine *engine, const QString & message)
+{
+    engines.removeAll(engine);
+    deadlines.remove(engine);
+    engine->deleteLater();
+    if( running.contains(engine) )
+        fail( running.take(engine), message );
+
+    // with no engines left, nothing else will be analysed
+    if( engines.isEmpty() )
+    {
+        while( nNext < jobs.count() )
+            fail( nNext++, message );
+    }
+    flush();
+}
+
+void EnginePool::dispatch(UciEngine *engine)
+{
+    while( nNext < jobs.count() && !jobs.at(nNext).readable )
+    {
+        fail( nNext, tr("could not read the position") );
+        nNext++;
+    }
+    if( nNext < jobs.count() )
+    {
+        running.insert(engine, nNext);
+        deadlines.insert(engine, clock.elapsed() + nMilliseconds + nTimeout);
+        engine->analyse( jobs.at(nNext).position, jobs.at(nNext).sideToMove );
+        nNext++;
+    }
+    else
+    {
+        deadlines.remove(engine);
+    }
+    flush();
+}
+
+void EnginePool::fail(int job, const QString & message)
+{
+    lines[job] = QString("%1\t%2").arg(jobs.at(job).name).arg(message);
+    nFailed++;
+}
+
+void EnginePool::flush()
+{
+    while( nWritten < jobs.count() && !lines.at(nWritten).isEmpty() )
+    {
+        *pReport << lines.at(nWritten) << Qt::endl;
+        nWritten++;
+    }
+    if( nWritten == jobs.count() && pLoop != 0 )
+        pLoop->quit();
+}
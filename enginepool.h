@@ -0,0 +1,94 @@
+#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include "uciengine.h"
+
+class QTextStream;
+class QEventLoop;
+class QTimer;
+
+// Analyses many positions with several copies of a UCI engine at once.
+// Each engine is handed its next position in the same moment it reports a
+// best move, so no engine waits for another or for the results to be
+// written; the results are reported in input order all the same.
+class EnginePool : public QObject
+{
+    Q_OBJECT
+public:
+    struct Job
+    {
+        Job() : sideToMove(Piece::White), readable(true) { }
+
+        QString name;
+        Position position;
+        Piece::Color sideToMove;
+        bool readable;
+    };
+
+    explicit EnginePool(QObject *parent = 0);
+
+    // a collection (.chc), a .chs file, a directory of .chs files, or a list file with one .chs path or position per line
+    bool addInput(const QString & path);
+    void addPosition(const Position & position, Piece::Color sideToMove, const QString & name);
+    int jobCount() const { return jobs.count(); }
+
+    void setEngine(const QString & program, const QStringList & arguments = QStringList()) { sProgram = program; slArguments = arguments; }
+    void setEngineCount(int n) { nEngines = qMax(1, n); }
+    // as UciEngine::setLimits
+    void setLimits(int depth, int milliseconds) { nDepth = depth; nMilliseconds = milliseconds; }
+    // an engine that takes longer than this to start, or to answer one
+    // position beyond its search time, is killed and its position reported
+    // as not analysed
+    void setTimeout(int milliseconds) { nTimeout = qMax(1, milliseconds); }
+
+    // runs until every position has been analysed, writing a line for each;
+    // returns the number that could not be analysed
+    int analyse(QTextStream & report);
+
+    const QVector<EngineEvaluation> & results() const { return evaluations; }
+    qint64 milliseconds() const { return nElapsed; }
+
+private slots:
+    void engineReady();
+    void engineFinished(const EngineEvaluation & evaluation);
+    void engineError(const QString & message);
+    void checkTimeouts();
+
+private:
+
+    void dispatch(UciEngine *engine);
+    void dropEngine(UciEngine *engine, const QString & message);
+    void fail(int job, const QString & message);
+    void flush();
+
+    QList<Job> jobs;
+
+    QString sProgram;
+    QStringList slArguments;
+    int nEngines;
+    int nDepth;
+    int nMilliseconds;
+    int nTimeout;
+
+    QList<UciEngine*> engines;
+    QHash<UciEngine*, int> running;     // the job each engine is working on
+    QHash<UciEngine*, qint64> deadlines;    // on clock, for engines starting or searching
+    QElapsedTimer clock;
+    QTimer *watchdog;
+    QVector<EngineEvaluation> evaluations;
+    QVector<QString> lines;             // a finished job's report, or empty
+    int nNext;
+    int nWritten;
+    int nFailed;
+    QTextStream *pReport;
+    QEventLoop *pLoop;
+    qint64 nElapsed;
+};
+
+#endif // ENGINEPOOL_H
@@ -0,0 +1,30 @@
+# Tests of the UCI engine bridge and the engine pool. The test program is
+# also the engine: started with --fake-engine it answers UCI commands with a
+# scripted search whose score is the material balance, so no chess engine
+# needs to be installed.
+
+QT       += core testlib
+QT       -= gui
+
+TARGET = enginetest
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += tst_uciengine.cpp \
+    ../uciengine.cpp \
+    ../enginepool.cpp \
+    ../collectionfile.cpp \
+    ../positionsource.cpp \
+    ../position.cpp \
+    ../zobrist.cpp
+
+HEADERS += ../uciengine.h \
+    ../enginepool.h \
+    ../collectionfile.h \
+    ../positionsource.h \
+    ../position.h \
+    ../zobrist.h \
+    ../piece.h
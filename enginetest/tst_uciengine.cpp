@@ -0,0 +1,261 @@
+#include <QtTest>
+#include <iostream>
+#include <string>
+
+#include "uciengine.h"
+#include "enginepool.h"
+
+// The fake engine. It reports depths 1 to 3, sleeping for --delay ms before
+// each, with the material balance (P 1, N and B 3, R 5, Q 9) from the side
+// to move's point of view as the score, and a1a2 as the best move. With
+// --crash-after n it exits without a word when asked for search n + 1, and
+// with --hang-after n it goes on running but never answers that search.
+static int fakeEngine(int argc, char *argv[])
+{
+    int delay = 0, crashAfter = -1, hangAfter = -1;
+    for(int i=2; i+1<argc; i++)
+    {
+        if( QByteArray(argv[i]) == "--delay" )
+            delay = atoi(argv[++i]);
+        else if( QByteArray(argv[i]) == "--crash-after" )
+            crashAfter = atoi(argv[++i]);
+        else if( QByteArray(argv[i]) == "--hang-after" )
+            hangAfter = atoi(argv[++i]);
+    }
+
+    int searches = 0;
+    int score = 0;
+    std::string line;
+    while( std::getline(std::cin, line) )
+    {
+        QByteArray command = QByteArray(line.c_str()).trimmed();
+        if( command == "uci" )
+        {
+            std::cout << "id name Fake\nid author Nobody\nuciok" << std::endl;
+        }
+        else if( command == "isready" )
+        {
+            std::cout << "readyok" << std::endl;
+        }
+        else if( command.startsWith("position fen ") )
+        {
+            QList<QByteArray> fields = command.mid(13).split(' ');
+            QByteArray placement = fields.value(0);
+            score = 0;
+            for(int i=0; i<placement.size(); i++)
+            {
+                char c = placement.at(i);
+                int value = QByteArray("PNBRQ").indexOf(QChar(c).toUpper().toLatin1());
+                if( value < 0 )
+                    continue;
+                const int values[5] = { 1, 3, 3, 5, 9 };
+                score += ( QChar(c).isUpper() ? 100 : -100 ) * values[value];
+            }
+            if( fields.value(1) == "b" )
+                score = -score;
+        }
+        else if( command.startsWith("go") )
+        {
+            if( searches == hangAfter )
+                continue;
+            if( searches++ == crashAfter )
+                return 1;
+            for(int depth=1; depth<=3; depth++)
+            {
+                QThread::msleep(delay);
+                std::cout << "info depth " << depth << " score cp " << score << " nodes " << depth * 1000 << " time " << depth * delay << " pv a1a2 h8h7" << std::endl;
+            }
+            std::cout << "bestmove a1a2 ponder h8h7" << std::endl;
+        }
+        else if( command == "quit" )
+        {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+class TestUciEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void evaluation();
+    void newPositionStopsSearch();
+    void missingEngine();
+    void quitLaterDoesNotWait();
+    void poolKeepsInputOrder();
+    void poolSurvivesCrash();
+    void poolTimesOut();
+
+private:
+    static QStringList fakeArguments(int delay, int crashAfter = -1, int hangAfter = -1);
+    static Position position(const char *fen, Piece::Color *side = 0);
+};
+
+QStringList TestUciEngine::fakeArguments(int delay, int crashAfter, int hangAfter)
+{
+    return QStringList() << "--fake-engine" << "--delay" << QString::number(delay) << "--crash-after" << QString::number(crashAfter)
+                         << "--hang-after" << QString::number(hangAfter);
+}
+
+Position TestUciEngine::position(const char *fen, Piece::Color *side)
+{
+    Position p;
+    p.parse( QString(fen), side );
+    return p;
+}
+
+void TestUciEngine::evaluation()
+{
+    UciEngine engine;
+    QSignalSpy ready(&engine, SIGNAL(ready()));
+    QSignalSpy info(&engine, SIGNAL(info(EngineEvaluation)));
+    QSignalSpy finished(&engine, SIGNAL(finished(EngineEvaluation)));
+    engine.start( QCoreApplication::applicationFilePath(), fakeArguments(0) );
+    QVERIFY( ready.wait(5000) );
+    QCOMPARE( engine.name(), QString("Fake") );
+
+    // White is a queen up and it is Black's move: the engine says -9, which is +9 for White
+    Piece::Color side = Piece::White;
+    Position p = position("4k3/8/8/8/8/8/8/3QK3 b", &side);
+    QCOMPARE( side, Piece::Black );
+    engine.analyse(p, side);
+    QVERIFY( finished.wait(5000) );
+
+    QCOMPARE( info.count(), 3 );
+    EngineEvaluation e = finished.at(0).at(0).value<EngineEvaluation>();
+    QCOMPARE( e.depth, 3 );
+    QCOMPARE( e.score, 900 );
+    QVERIFY( !e.mate );
+    QCOMPARE( e.scoreText(), QString("+9.00") );
+    QCOMPARE( e.bestMove, QString("a1a2") );
+    QCOMPARE( e.pv, QStringList() << "a1a2" << "h8h7" );
+    QVERIFY( !engine.isSearching() );
+}
+
+void TestUciEngine::newPositionStopsSearch()
+{
+    UciEngine engine;
+    QSignalSpy finished(&engine, SIGNAL(finished(EngineEvaluation)));
+    engine.start( QCoreApplication::applicationFilePath(), fakeArguments(100) );
+
+    // the first position waits for the engine to start and is then replaced
+    engine.analyse( position("4k3/8/8/8/8/8/8/3QK3 w"), Piece::White );
+    QTRY_VERIFY_WITH_TIMEOUT( engine.isSearching(), 5000 );
+    engine.analyse( position("3qk3/8/8/8/8/8/8/4K3 w"), Piece::White );
+
+    QVERIFY( finished.wait(5000) );
+    QTest::qWait(200);
+    QCOMPARE( finished.count(), 1 );
+    QCOMPARE( finished.at(0).at(0).value<EngineEvaluation>().score, -900 );
+}
+
+void TestUciEngine::missingEngine()
+{
+    UciEngine engine;
+    QSignalSpy error(&engine, SIGNAL(error(QString)));
+    engine.start("/nonexistent/engine");
+    QVERIFY( error.count() > 0 || error.wait(5000) );
+    QVERIFY( !engine.isReady() );
+}
+
+void TestUciEngine::quitLaterDoesNotWait()
+{
+    // the engine is busy for most of a second and only reads the quit after its search
+    UciEngine *engine = new UciEngine;
+    QPointer<UciEngine> guard(engine);
+    QSignalSpy ready(engine, SIGNAL(ready()));
+    engine->start( QCoreApplication::applicationFilePath(), fakeArguments(300) );
+    QVERIFY( ready.wait(5000) );
+    engine->analyse( position("4k3/8/8/8/8/8/8/3QK3 w"), Piece::White );
+    QTRY_VERIFY_WITH_TIMEOUT( engine->isSearching(), 5000 );
+
+    QElapsedTimer timer;
+    timer.start();
+    engine->quitLater();
+    QVERIFY( timer.elapsed() < 100 );
+    QVERIFY( !guard.isNull() );
+    QTRY_VERIFY_WITH_TIMEOUT( guard.isNull(), 5000 );
+}
+
+void TestUciEngine::poolKeepsInputOrder()
+{
+    EnginePool pool;
+    pool.setEngine( QCoreApplication::applicationFilePath(), fakeArguments(1) );
+    pool.setEngineCount(4);
+    pool.setLimits(3, 0);
+
+    // alternately a white and a black rook up, with an extra pawn for every tenth
+    for(int i=0; i<40; i++)
+    {
+        const char *fen = i % 2 ? "r3k3/8/8/8/8/8/8/4K3 w" : "4k3/8/8/8/8/8/8/R3K3 w";
+        Position p = position(fen);
+        if( i % 10 == 0 )
+            p.set(6, 0, Piece(Piece::Pawn, Piece::White));
+        pool.addPosition(p, Piece::White, QString("p%1").arg(i));
+    }
+
+    QString output;
+    QTextStream report(&output);
+    QCOMPARE( pool.analyse(report), 0 );
+
+    QCOMPARE( pool.results().count(), 40 );
+    for(int i=0; i<40; i++)
+        QCOMPARE( pool.results().at(i).score, ( i % 2 ? -500 : 500 ) + ( i % 10 == 0 ? 100 : 0 ) );
+
+    QStringList lines = output.split('\n', Qt::SkipEmptyParts);
+    QCOMPARE( lines.count(), 41 );
+    for(int i=0; i<40; i++)
+        QVERIFY( lines.at(i).startsWith( QString("p%1\t").arg(i) ) );
+}
+
+void TestUciEngine::poolSurvivesCrash()
+{
+    // each engine dies on its third position; what could not be analysed is still reported
+    EnginePool pool;
+    pool.setEngine( QCoreApplication::applicationFilePath(), fakeArguments(1, 2) );
+    pool.setEngineCount(2);
+    pool.setLimits(3, 0);
+    for(int i=0; i<10; i++)
+        pool.addPosition( position("4k3/8/8/8/8/8/8/4K3 w"), Piece::White, QString("p%1").arg(i) );
+
+    QString output;
+    QTextStream report(&output);
+    QCOMPARE( pool.analyse(report), 6 );
+    QCOMPARE( output.split('\n', Qt::SkipEmptyParts).count(), 11 );
+}
+
+void TestUciEngine::poolTimesOut()
+{
+    // each engine stops answering on its second position and is killed; the rest go unanalysed
+    EnginePool pool;
+    pool.setEngine( QCoreApplication::applicationFilePath(), fakeArguments(1, -1, 1) );
+    pool.setEngineCount(2);
+    pool.setLimits(3, 0);
+    pool.setTimeout(500);
+    for(int i=0; i<6; i++)
+        pool.addPosition( position("4k3/8/8/8/8/8/8/4K3 w"), Piece::White, QString("p%1").arg(i) );
+
+    QString output;
+    QTextStream report(&output);
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE( pool.analyse(report), 4 );
+    QVERIFY( timer.elapsed() < 5000 );
+    QStringList lines = output.split('\n', Qt::SkipEmptyParts);
+    QCOMPARE( lines.count(), 7 );
+    QVERIFY( lines.at(2).contains("no answer") );
+}
+
+int main(int argc, char *argv[])
+{
+    if( argc > 1 && QByteArray(argv[1]) == "--fake-engine" )
+        return fakeEngine(argc, argv);
+
+    QCoreApplication app(argc, argv);
+    TestUciEngine test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_uciengine.moc"
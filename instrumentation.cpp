@@ -0,0 +1,124 @@
+#include "instrumentation.h"
+
+#include <QtCore>
+
+// events kept for the trace; beyond this only the totals are updated
+enum { MaxEvents = 1 << 20 };
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 duration;
+    int thread;
+};
+
+QAtomicInt Instrumentation::nEnabled;
+QAtomicInteger<quint64> Instrumentation::counters[Instrumentation::CounterCount];
+
+static QMutex mutex;
+static QElapsedTimer traceClock;
+static QVector<TraceEvent> events;
+// by name rather than by pointer, since each translation unit may have its own copy of a literal
+static QList<QByteArray> names;
+static QHash<QByteArray,Instrumentation::Timing> totals;
+static QHash<Qt::HANDLE,int> threads;
+
+void Instrumentation::setEnabled(bool on)
+{
+    QMutexLocker locker(&mutex);
+    if( !traceClock.isValid() )
+        traceClock.start();
+    nEnabled = on ? 1 : 0;
+}
+
+void Instrumentation::reset()
+{
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<CounterCount; i++)
+        counters[i] = 0;
+    events.clear();
+    names.clear();
+    totals.clear();
+    threads.clear();
+}
+
+const char * Instrumentation::counterName(Counter c)
+{
+    static const char * const counterNames[CounterCount] = { "SVG parses", "items created", "items deleted", "full rebuilds", "effect renders", "exports" };
+    return counterNames[c];
+}
+
+qint64 Instrumentation::now()
+{
+    return traceClock.isValid() ? traceClock.nsecsElapsed() : 0;
+}
+
+void Instrumentation::record(const char *name, qint64 start, qint64 end)
+{
+    QMutexLocker locker(&mutex);
+
+    // the names are literals, so they need not be copied
+    QByteArray key = QByteArray::fromRawData( name, qstrlen(name) );
+    Timing & t = totals[key];
+    if( t.count == 0 )
+        names << key;
+    t.count++;
+    t.total += end - start;
+    t.max = qMax( t.max, end - start );
+
+    if( events.count() < MaxEvents )
+    {
+        Qt::HANDLE id = QThread::currentThreadId();
+        QHash<Qt::HANDLE,int>::const_iterator it = threads.constFind(id);
+        int thread = it != threads.constEnd() ? it.value() : threads.count() + 1;
+        if( it == threads.constEnd() )
+            threads.insert(id, thread);
+
+        TraceEvent e;
+        e.name = name;
+        e.start = start;
+        e.duration = end - start;
+        e.thread = thread;
+        events << e;
+    }
+}
+
+QList< QPair<QByteArray,Instrumentation::Timing> > Instrumentation::timings()
+{
+    QMutexLocker locker(&mutex);
+    QList< QPair<QByteArray,Timing> > list;
+    foreach(const QByteArray & name, names)
+        list << qMakePair( name, totals.value(name) );
+    return list;
+}
+
+bool Instrumentation::writeTrace(const QString & filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    foreach(const TraceEvent & e, events)
+    {
+        out += "{\"name\":\"" + QByteArray(e.name) + "\",\"cat\":\"chess\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(e.thread)
+                + ",\"ts\":" + QByteArray::number( e.start / 1000.0, 'f', 3 ) + ",\"dur\":" + QByteArray::number( e.duration / 1000.0, 'f', 3 ) + "},\n";
+        if( out.size() > ( 1 << 20 ) )
+        {
+            file.write(out);
+            out.clear();
+        }
+    }
+
+    // the counters at the end of the trace
+    out += "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" + QByteArray::number( now() / 1000.0, 'f', 3 ) + ",\"args\":{";
+    for(int i=0; i<CounterCount; i++)
+        out += QByteArray( i > 0 ? "," : "" ) + "\"" + counterName( (Counter)i ) + "\":" + QByteArray::number( counters[i].load() );
+    out += "}}\n]}\n";
+    return file.write(out) == out.size();
+}
@@ -0,0 +1,68 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+// Counters and scoped timers on the paths that make the board slow. It is
+// all off until setEnabled(true), and while off a counter or a timer is a
+// single test of a flag. When on, each counter is an atomic add and each
+// timer adds an event that writeTrace() saves as Chrome trace JSON, for
+// chrome://tracing or Perfetto. Timer names must be string literals.
+class Instrumentation
+{
+public:
+    enum Counter { SvgParses, ItemsCreated, ItemsDeleted, FullRebuilds, EffectRenders, Exports, CounterCount };
+
+    struct Timing
+    {
+        Timing() : count(0), total(0), max(0) { }
+        quint64 count;
+        qint64 total;   // nanoseconds
+        qint64 max;
+    };
+
+    static inline bool isEnabled() { return nEnabled.load() != 0; }
+    static void setEnabled(bool on);
+    static void reset();
+
+    static inline void count(Counter c) { if( isEnabled() ) counters[c].fetchAndAddRelaxed(1); }
+    static quint64 counter(Counter c) { return counters[c].load(); }
+    static const char * counterName(Counter c);
+
+    // by name, in the order first seen
+    static QList< QPair<QByteArray,Timing> > timings();
+
+    static bool writeTrace(const QString & filename);
+
+    // for ScopedTimer
+    static qint64 now();
+    static void record(const char *name, qint64 start, qint64 end);
+
+private:
+    static QAtomicInt nEnabled;
+    static QAtomicInteger<quint64> counters[CounterCount];
+};
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *name) : sName( Instrumentation::isEnabled() ? name : 0 ), nStart(0)
+    {
+        if( sName != 0 )
+            nStart = Instrumentation::now();
+    }
+    ~ScopedTimer()
+    {
+        if( sName != 0 )
+            Instrumentation::record( sName, nStart, Instrumentation::now() );
+    }
+
+private:
+    const char *sName;
+    qint64 nStart;
+};
+
+#endif // INSTRUMENTATION_H
@@ -1,9 +1,18 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "commandline.h"
 
 int main(int argc, char *argv[])
 {
+    bool headless = CommandLine::isHeadless(argc, argv);
+    if( headless && qgetenv("QT_QPA_PLATFORM").isEmpty() )
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication a(argc, argv);
+
+    if( headless )
+        return CommandLine(a.arguments()).exec();
+
     MainWindow w;
     w.show();
 
@@ -1,25 +1,81 @@
 #include "mainwindow.h"
 
 #include <QtWidgets>
+#include <QtConcurrent>
 #include <QGraphicsSvgItem>
-#include <QSvgGenerator>
 #include "chessboard.h"
+#include "collectionfile.h"
+#include "collectionindex.h"
+#include "bitboardposition.h"
+#include "tiledpngwriter.h"
+#include "pagecomposer.h"
+#include "instrumentation.h"
+#include "performanceoverlay.h"
+#include "uciengine.h"
+#include "collectionbrowser.h"
+#include "piecetheme.h"
+#include "animationwriter.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     scene = new ChessBoard;
     settings = 0;
+    rZoom = 1.0;
+    collection = 0;
+    collectionIndex = 0;
+    nCollectionIndex = 0;
+    eSideToMove = Piece::White;
+    solver = new MateSolver;
+    nSolveMoves = 0;
+    solveWatcher = new QFutureWatcher<MateResult>(this);
+    connect(solveWatcher,SIGNAL(finished()),this,SLOT(showMateResult()));
+    undoStack = new QUndoStack(this);
+    browser = new CollectionBrowser;
+    browserDock = new QDockWidget(tr("Collection"), this);
+    browserDock->setWidget(browser);
+    addDockWidget(Qt::LeftDockWidgetArea, browserDock);
+    browserDock->hide();
+    connect(browser,SIGNAL(entryChosen(quint64)),this,SLOT(showCollectionEntry(quint64)));
+    engine = 0;
+    analyseTimer = new QTimer(this);
+    analyseTimer->setSingleShot(true);
+    connect(analyseTimer,SIGNAL(timeout()),this,SLOT(analyseBoard()));
     setupMenus();
     getSettings();
-    QGraphicsView *view = new QGraphicsView(scene);
+    scene->setUndoStack(undoStack);
+    // the other piece sets are read in the background, so that choosing one is immediate
+    QtConcurrent::run(PieceTheme::preload);
+    view = new QGraphicsView(scene);
     setCentralWidget(view);
+    overlay = new PerformanceOverlay(view);
+    overlay->move(8, 8);
+    connect(scene,SIGNAL(placementChanged()),this,SLOT(showPlacement()));
+
+    engineLabel = new QLabel;
+    engineLabel->setWordWrap(true);
+    engineLabel->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+    engineLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    engineLabel->setMinimumWidth(200);
+    engineDock = new QDockWidget(tr("Engine"), this);
+    engineDock->setWidget(engineLabel);
+    addDockWidget(Qt::RightDockWidgetArea, engineDock);
+    engineDock->hide();
+    // the side to move is set after the board when a position is opened, so wait for both
+    connect(scene,SIGNAL(changed()),analyseTimer,SLOT(start()));
+    applyZoom();
 }
 
 MainWindow::~MainWindow()
 {
     setSettings();
     delete settings;
+    delete engine;
+    delete collectionIndex;
+    delete collection;
+    solver->stop();
+    solveWatcher->waitForFinished();
+    delete solver;
 }
 
 
@@ -30,12 +86,18 @@ void MainWindow::getSettings()
 
     settings = new QSettings("AdamBaker", "Chess");
 
+    sEnginePath = settings->value("engine-path").toString();
     scene->setVersion( settings->value("piece-mode","0").toUInt() );
     if(scene->version()==ChessBoard::Traditional)
         traditional->setChecked(true);
     else
         secularized->setChecked(true);
+    scene->setPieceTheme( settings->value("piece-theme","").toString() );
+    foreach(QAction *action, themeGroup->actions())
+        action->setChecked( action->data().toString() == scene->pieceTheme() );
     scene->fromString( settings->value("piece-positions","").toString() );
+    QString annotations = settings->value("annotations","").toString();
+    scene->setAnnotations( Annotations::take(annotations) );
     scene->setLightPieceColor( colorFromString( settings->value("light-piece-color", "0 0 0" ).toString() ) );
     scene->setDarkPieceColor( colorFromString( settings->value("dark-piece-color", "0 0 0" ).toString() ) );
     scene->setLightSquareColor( colorFromString( settings->value("light-square-color", "255 255 255" ).toString() ) );
@@ -47,8 +109,11 @@ void MainWindow::setSettings()
     if( settings == 0 || scene == 0)
         return;
 
+    settings->setValue("engine-path",sEnginePath);
     settings->setValue("piece-mode",scene->version());
+    settings->setValue("piece-theme",scene->pieceTheme());
     settings->setValue("piece-positions",scene->toString());
+    settings->setValue("annotations",scene->annotations().toString());
     settings->setValue("light-piece-color",stringFromColor(scene->lightPieceColor()));
     settings->setValue("dark-piece-color",stringFromColor(scene->darkPieceColor()));
     settings->setValue("light-square-color",stringFromColor(scene->lightSquareColor()));
@@ -64,8 +129,55 @@ void MainWindow::setupMenus()
     file->addAction(tr("Save"),this,SLOT(save()),QKeySequence::Save);
     file->addAction(tr("Open"),this,SLOT(open()),QKeySequence::Open);
     file->addAction(tr("Create SVG"),this,SLOT(createSvg()),QKeySequence::Print);
+    file->addAction(tr("Export PNG..."),this,SLOT(exportPng()));
+    file->addAction(tr("Export animation..."),this,SLOT(exportAnimation()));
+    file->addAction(tr("Check position"),this,SLOT(checkPosition()));
+    file->addAction(tr("Solve mate..."),this,SLOT(solveMate()),QKeySequence(Qt::CTRL + Qt::Key_M));
+    file->addSeparator();
+    file->addAction(tr("Open collection"),this,SLOT(openCollection()));
+    previousPosition = file->addAction(tr("Previous position"),this,SLOT(showPreviousPosition()),QKeySequence(Qt::Key_PageUp));
+    nextPosition = file->addAction(tr("Next position"),this,SLOT(showNextPosition()),QKeySequence(Qt::Key_PageDown));
+    goToPosition = file->addAction(tr("Go to position..."),this,SLOT(goToCollectionPosition()),QKeySequence(Qt::CTRL + Qt::Key_G));
+    previousPosition->setEnabled(false);
+    nextPosition->setEnabled(false);
+    findPosition = file->addAction(tr("Find in collection"),this,SLOT(findInCollection()),QKeySequence::Find);
+    composePages = file->addAction(tr("Lay out collection on pages..."),this,SLOT(composeCollection()));
+    goToPosition->setEnabled(false);
+    findPosition->setEnabled(false);
+    composePages->setEnabled(false);
+    file->addSeparator();
     file->addAction(tr("Quit"),this,SLOT(close()),QKeySequence::Quit);
 
+    QMenu *edit = new QMenu(tr("Edit"));
+    QAction *undo = undoStack->createUndoAction(this);
+    undo->setShortcut(QKeySequence::Undo);
+    edit->addAction(undo);
+    QAction *redo = undoStack->createRedoAction(this);
+    redo->setShortcut(QKeySequence::Redo);
+    edit->addAction(redo);
+    edit->addSeparator();
+    QMenu *annotationColor = edit->addMenu(tr("Annotation color"));
+    QActionGroup *annotationColors = new QActionGroup(this);
+    annotationColors->setExclusive(true);
+    const QString colorNames[4] = { tr("Green"), tr("Red"), tr("Yellow"), tr("Blue") };
+    for(int c=Annotations::Green; c<=Annotations::Blue; c++)
+    {
+        QAction *action = annotationColor->addAction(colorNames[c]);
+        action->setData(c);
+        action->setCheckable(true);
+        action->setChecked( c == scene->annotationColor() );
+        annotationColors->addAction(action);
+    }
+    connect(annotationColors,SIGNAL(triggered(QAction*)),scene,SLOT(setAnnotationColor(QAction*)));
+    edit->addAction(tr("Clear annotations"),scene,SLOT(clearAnnotations()));
+
+    QMenu *engineMenu = new QMenu(tr("Engine"));
+    analyseAction = engineMenu->addAction(tr("Analyse"));
+    analyseAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_E));
+    analyseAction->setCheckable(true);
+    connect(analyseAction,SIGNAL(toggled(bool)),this,SLOT(setAnalysing(bool)));
+    engineMenu->addAction(tr("Choose engine..."),this,SLOT(chooseEngine()));
+
     QMenu *colors = new QMenu(tr("Colors"));
     colors->addAction(tr("Set Light Square Color"),this,SLOT(setLightSquareColor()));
     colors->addAction(tr("Set Dark Square Color"),this,SLOT(setDarkSquareColor()));
@@ -87,11 +199,156 @@ void MainWindow::setupMenus()
     versionGroup->setExclusive(true);
     versionGroup->addAction(traditional);
     versionGroup->addAction(secularized);
-    connect(versionGroup,SIGNAL(triggered(QAction*)),scene,SLOT(setVersion(QAction*)));
+    connect(versionGroup,SIGNAL(triggered(QAction*)),this,SLOT(setPieceVersion(QAction*)));
+    version->addSeparator();
+    themeGroup = new QActionGroup(this);
+    themeGroup->setExclusive(true);
+    QStringList themes = PieceTheme::available();
+    themes.prepend(QString());
+    foreach(QString name, themes)
+    {
+        QAction *action = version->addAction( name.isEmpty() ? tr("Standard set") : name );
+        action->setData(name);
+        action->setCheckable(true);
+        action->setChecked( name.isEmpty() );
+        themeGroup->addAction(action);
+    }
+    connect(themeGroup,SIGNAL(triggered(QAction*)),this,SLOT(setPieceTheme(QAction*)));
+
+    QMenu *viewMenu = new QMenu(tr("View"));
+    viewMenu->addAction(tr("Zoom in"),this,SLOT(zoomIn()),QKeySequence::ZoomIn);
+    viewMenu->addAction(tr("Zoom out"),this,SLOT(zoomOut()),QKeySequence::ZoomOut);
+    viewMenu->addAction(tr("Actual size"),this,SLOT(resetZoom()),QKeySequence(Qt::CTRL + Qt::Key_0));
+    viewMenu->addSeparator();
+    QAction *showBrowser = browserDock->toggleViewAction();
+    showBrowser->setText(tr("Collection browser"));
+    showBrowser->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_B));
+    viewMenu->addAction(showBrowser);
+    viewMenu->addSeparator();
+    QAction *showOverlay = viewMenu->addAction(tr("Performance overlay"));
+    showOverlay->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_P));
+    showOverlay->setCheckable(true);
+    connect(showOverlay,SIGNAL(toggled(bool)),this,SLOT(setPerformanceOverlay(bool)));
+    viewMenu->addAction(tr("Save performance trace..."),this,SLOT(savePerformanceTrace()));
 
     menuBar()->addMenu(file);
+    menuBar()->addMenu(edit);
+    menuBar()->addMenu(engineMenu);
     menuBar()->addMenu(colors);
     menuBar()->addMenu(version);
+    menuBar()->addMenu(viewMenu);
+}
+
+void MainWindow::chooseEngine()
+{
+    QString filename = QFileDialog::getOpenFileName(this,tr("Choose a UCI engine"),sEnginePath);
+    if(filename.isEmpty())
+        return;
+    sEnginePath = filename;
+    if( analyseAction->isChecked() )
+        startEngine();
+}
+
+void MainWindow::startEngine()
+{
+    // the old engine is left to quit on its own, rather than waited for here
+    if( engine != 0 )
+    {
+        disconnect(engine,0,this,0);
+        engine->quitLater();
+    }
+    engine = new UciEngine;
+    engine->setLimits(0, 0);
+    connect(engine,SIGNAL(info(EngineEvaluation)),this,SLOT(showEvaluation(EngineEvaluation)));
+    connect(engine,SIGNAL(finished(EngineEvaluation)),this,SLOT(showEvaluation(EngineEvaluation)));
+    connect(engine,SIGNAL(error(QString)),this,SLOT(showEngineError(QString)));
+    engine->start(sEnginePath);
+    engineLabel->setText( tr("Starting %1...").arg( QFileInfo(sEnginePath).fileName() ) );
+    analyseBoard();
+}
+
+void MainWindow::setAnalysing(bool on)
+{
+    if( !on )
+    {
+        if( engine != 0 )
+            engine->stop();
+        engineDock->hide();
+        return;
+    }
+
+    if( sEnginePath.isEmpty() )
+        chooseEngine();
+    if( sEnginePath.isEmpty() )
+    {
+        analyseAction->setChecked(false);
+        return;
+    }
+    engineDock->show();
+    if( engine == 0 || !engine->isRunning() )
+        startEngine();
+    else
+        analyseBoard();
+}
+
+void MainWindow::analyseBoard()
+{
+    // the engine searches until the board changes; a new position replaces the old search
+    if( engine != 0 && analyseAction->isChecked() )
+        engine->analyse( scene->position(), eSideToMove );
+}
+
+void MainWindow::showEvaluation(const EngineEvaluation & evaluation)
+{
+    engineLabel->setText( tr("<b>%1</b> at depth %2 (%3)<br>%4")
+                          .arg(evaluation.scoreText()).arg(evaluation.depth).arg(engine->name())
+                          .arg(evaluation.pv.join(' ')) );
+}
+
+void MainWindow::showEngineError(const QString & message)
+{
+    engineLabel->setText(message);
+    statusBar()->showMessage(message);
+    analyseAction->setChecked(false);
+}
+
+void MainWindow::showPlacement()
+{
+    if( !scene->isPlacing() )
+    {
+        statusBar()->clearMessage();
+        return;
+    }
+    Piece p = scene->placement();
+    if( p.type() == Piece::None )
+    {
+        statusBar()->showMessage( tr("Click squares to empty them. Press Escape to stop.") );
+        return;
+    }
+    const QString names[6] = { tr("king"), tr("queen"), tr("bishop"), tr("knight"), tr("rook"), tr("pawn") };
+    QString color = p.color() == Piece::White ? tr("white") : tr("black");
+    statusBar()->showMessage( tr("Click squares to place a %1 %2. Press Escape to stop.").arg(color).arg(names[p.type()]) );
+}
+
+void MainWindow::setPerformanceOverlay(bool on)
+{
+    // measuring starts with the overlay and goes on until it is hidden
+    Instrumentation::setEnabled(on);
+    overlay->setVisible(on);
+}
+
+void MainWindow::savePerformanceTrace()
+{
+    if( !Instrumentation::isEnabled() && Instrumentation::timings().isEmpty() )
+    {
+        QMessageBox::information(this,tr("Chess"),tr("Nothing has been measured. Turn on View|Performance overlay, use the program, and then save the trace."));
+        return;
+    }
+    QString filename = QFileDialog::getSaveFileName(this,tr("Chess"),QString(),tr("Chrome trace files (*.json)"));
+    if(filename.isEmpty())
+        return;
+    if( !Instrumentation::writeTrace(filename) )
+        QMessageBox::warning(this,tr("Chess"),tr("Could not write %1").arg(filename));
 }
 
 void MainWindow::save()
@@ -99,6 +356,7 @@ void MainWindow::save()
     QString filename = QFileDialog::getSaveFileName(this,tr("Chess"),QString(),tr("Chess Files (*.chs)"));
     if(filename.isEmpty())
         return;
+    ScopedTimer timer("save");
 
     QFile file(filename);
     if(!file.open(QFile::WriteOnly|QFile::Text))
@@ -108,14 +366,18 @@ void MainWindow::save()
     }
     QTextStream stream(&file);
     stream << scene->toString();
+    // on a line of their own after the position, which older versions ignore
+    if( !scene->annotations().isEmpty() )
+        stream << "\n" << scene->annotations().toString() << "\n";
     file.close();
 }
 
 void MainWindow::open()
 {
-    QString filename = QFileDialog::getOpenFileName(this,tr("Chess"),QString(),tr("Chess Files (*.chs)"));
+    QString filename = QFileDialog::getOpenFileName(this,tr("Chess"),QString(),tr("Chess Files (*.chs *.fen)"));
     if(filename.isEmpty())
         return;
+    ScopedTimer timer("open");
 
     QFile file(filename);
     if(!file.open(QFile::ReadOnly|QFile::Text))
@@ -124,8 +386,17 @@ void MainWindow::open()
         return;
     }
     QTextStream stream(&file);
-    scene->fromString( stream.readAll() );
+    eSideToMove = Piece::White;
+    QString text = stream.readAll();
+    Annotations annotations = Annotations::take(text);
+    bool ok = scene->fromString( text, &eSideToMove );
     file.close();
+    scene->setAnnotations(annotations);
+
+    if( !ok )
+        QMessageBox::warning(this,tr("Chess"),tr("%1 is not a .chs or FEN position.").arg(filename));
+    else
+        reportProblems();
 }
 
 void MainWindow::createSvg()
@@ -134,44 +405,348 @@ void MainWindow::createSvg()
     if(filename.isEmpty())
         return;
 
-    scene->setSvgRender(true);
+    scene->writeSvg(filename);
+}
+
+void MainWindow::exportPng()
+{
+    bool ok;
+    int pixels = QInputDialog::getInt(this,tr("Chess"),tr("Width and height in pixels:"),4800,16,100000,100,&ok);
+    if(!ok)
+        return;
+    int dpi = QInputDialog::getInt(this,tr("Chess"),tr("Dots per inch:"),600,1,10000,50,&ok);
+    if(!ok)
+        return;
+
+    QString filename = QFileDialog::getSaveFileName(this,tr("Chess"),QString(),tr("PNG Files (*.png)"));
+    if(filename.isEmpty())
+        return;
+    QFile file(filename);
+    if(!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    TiledPngWriter writer;
+    writer.setSize( QSize(pixels, pixels) );
+    writer.setDotsPerInch(dpi);
+    bool written = writer.write(scene, &file);
+    QApplication::restoreOverrideCursor();
+
+    if( written )
+        statusBar()->showMessage( tr("Wrote %1 x %1 pixels (%2 inches) in %3 ms, %4 ms per megapixel, %5 MB at most in memory")
+                                  .arg(pixels).arg( (double)pixels / dpi, 0, 'f', 2 )
+                                  .arg( writer.milliseconds() ).arg( writer.millisecondsPerMegapixel(), 0, 'f', 1 )
+                                  .arg( writer.peakBytes() / 1048576.0, 0, 'f', 1 ) );
+    else
+        QMessageBox::warning(this,tr("Chess"),tr("Could not write %1").arg(filename));
+}
+
+void MainWindow::checkPosition()
+{
+    if( !reportProblems() )
+        QMessageBox::information(this,tr("Chess"),tr("The position is legal."));
+}
+
+void MainWindow::solveMate()
+{
+    if( reportProblems() )
+        return;
+    bool ok;
+    int n = QInputDialog::getInt(this,tr("Chess"),tr("Look for mate in at most:"),3,1,20,1,&ok);
+    if(!ok)
+        return;
+
+    // a search still running for an earlier request is abandoned
+    solver->stop();
+    solveWatcher->waitForFinished();
+
+    solvedPosition.setPosition( scene->position(), eSideToMove );
+    nSolveMoves = n;
+    QString side = eSideToMove == Piece::White ? tr("White") : tr("Black");
+    statusBar()->showMessage( tr("Looking for a mate in %1 for %2...").arg(n).arg(side) );
+    solveWatcher->setFuture( QtConcurrent::run(solver, &MateSolver::solve, solvedPosition, n) );
+}
+
+void MainWindow::showMateResult()
+{
+    MateResult result = solveWatcher->result();
+    statusBar()->clearMessage();
+    if( result.stopped )
+        return;
+
+    QStringList keys;
+    foreach(BitboardPosition::Move m, result.keys)
+        keys << solvedPosition.moveToSan(m);
+
+    QString text;
+    if( result.mateIn == 0 )
+        text = tr("There is no forced mate in %1 moves or fewer.").arg(nSolveMoves);
+    else if( result.isUnique() )
+        text = tr("Mate in %1. The key move is %2.").arg(result.mateIn).arg(keys.first());
+    else
+        text = tr("Mate in %1, but the puzzle is cooked: %2 all mate in %1.").arg(result.mateIn).arg(keys.join(", "));
+    statusBar()->showMessage( tr("%1 positions searched in %2 ms").arg(result.nodes).arg(result.milliseconds) );
+    QMessageBox::information(this,tr("Chess"),text);
+}
+
+// warns about a position that could not occur in a game; returns whether there was anything to report
+bool MainWindow::reportProblems()
+{
+    QStringList problems = BitboardPosition::problems( scene->position(), eSideToMove );
+    if( problems.isEmpty() )
+        return false;
+    QMessageBox::warning(this,tr("Chess"),tr("The position is not legal:\n\n%1").arg(problems.join("\n")));
+    return true;
+}
+
+void MainWindow::openCollection()
+{
+    QString filename = QFileDialog::getOpenFileName(this,tr("Chess"),QString(),tr("Chess Collections (*.chc)"));
+    if(filename.isEmpty())
+        return;
+
+    CollectionFile *opened = new CollectionFile;
+    if( !opened->open(filename) || opened->count() == 0 )
+    {
+        QMessageBox::warning(this,tr("Chess"),tr("%1 is not a collection, or it is empty.").arg(filename));
+        delete opened;
+        return;
+    }
+    browser->setCollection(opened);
+    browser->setBoardStyle(scene->style());
+    browserDock->show();
+    delete collectionIndex;
+    collectionIndex = 0;
+    delete collection;
+    collection = opened;
+
+    previousPosition->setEnabled(true);
+    nextPosition->setEnabled(true);
+    goToPosition->setEnabled(true);
+    findPosition->setEnabled(true);
+    composePages->setEnabled(true);
+    showCollectionEntry(0);
+}
+
+void MainWindow::showPreviousPosition()
+{
+    if( collection != 0 && nCollectionIndex > 0 )
+        showCollectionEntry(nCollectionIndex - 1);
+}
+
+void MainWindow::showNextPosition()
+{
+    if( collection != 0 && nCollectionIndex + 1 < collection->count() )
+        showCollectionEntry(nCollectionIndex + 1);
+}
+
+void MainWindow::goToCollectionPosition()
+{
+    if( collection == 0 )
+        return;
+    bool ok;
+    int n = QInputDialog::getInt(this,tr("Chess"),tr("Position number:"),nCollectionIndex + 1,1,qMin<quint64>(collection->count(),INT_MAX),1,&ok);
+    if(ok)
+        showCollectionEntry(n - 1);
+}
+
+// shows the next entry of the collection with the position on the board, going round to the start
+void MainWindow::findInCollection()
+{
+    if( collection == 0 )
+        return;
+    if( collectionIndex == 0 )
+    {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        collectionIndex = new CollectionIndex;
+        bool ok = collectionIndex->openOrBuild(*collection);
+        QApplication::restoreOverrideCursor();
+        if( !ok )
+        {
+            QMessageBox::warning(this,tr("Chess"),tr("Could not index %1.").arg(collection->fileName()));
+            delete collectionIndex;
+            collectionIndex = 0;
+            return;
+        }
+    }
+
+    QList<quint64> matches = collectionIndex->find( scene->position().key(eSideToMove) );
+    if( matches.isEmpty() )
+    {
+        QMessageBox::information(this,tr("Chess"),tr("The position is not in the collection."));
+        return;
+    }
+    quint64 next = matches.first();
+    foreach(quint64 i, matches)
+    {
+        if( i > nCollectionIndex )
+        {
+            next = i;
+            break;
+        }
+    }
+    showCollectionEntry(next);
+    statusBar()->showMessage( tr("The position occurs %n time(s) in the collection.", 0, matches.count()) );
+}
+
+void MainWindow::exportAnimation()
+{
+    QString source = QFileDialog::getOpenFileName(this,tr("Positions to animate"),QString(),tr("PGN Games (*.pgn);;Collections (*.chc);;Lists of positions (*.txt);;All Files (*)"));
+    if(source.isEmpty())
+        return;
+    bool ok;
+    int squareSize = QInputDialog::getInt(this,tr("Chess"),tr("Width of a square in pixels:"),45,8,500,5,&ok);
+    if(!ok)
+        return;
+    QString filename = QFileDialog::getSaveFileName(this,tr("Chess"),QString(),tr("Animated PNG Files (*.png);;GIF Files (*.gif);;Animated SVG Files (*.svg)"));
+    if(filename.isEmpty())
+        return;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    AnimationWriter writer;
+    writer.setStyle( scene->style() );
+    writer.setSquareSize(squareSize);
+    bool written = writer.addInput(source) && writer.frameCount() > 0 && writer.write(filename);
+    QApplication::restoreOverrideCursor();
 
-    QSvgGenerator generator;
-    generator.setFileName(filename);
-    generator.setSize(QSize(200, 200));
-    generator.setViewBox(QRect(0, 0, 200, 200));
-    QPainter painter(&generator);
-    scene->render(&painter);
+    if( written )
+        statusBar()->showMessage( tr("Wrote %1 positions in %2 ms, encoding %3% of the pixels of whole frames")
+                                  .arg(writer.frameCount()).arg(writer.milliseconds())
+                                  .arg( writer.fractionEncoded() * 100, 0, 'f', 1 ) );
+    else
+        QMessageBox::warning(this,tr("Chess"),tr("Could not write %1").arg(filename));
+}
+
+void MainWindow::composeCollection()
+{
+    if( collection == 0 )
+        return;
+    bool ok;
+    int columns = QInputDialog::getInt(this,tr("Chess"),tr("Diagrams across a page:"),2,1,8,1,&ok);
+    if(!ok)
+        return;
+    int rows = QInputDialog::getInt(this,tr("Chess"),tr("Diagrams down a page:"),3,1,10,1,&ok);
+    if(!ok)
+        return;
+    QString filename = QFileDialog::getSaveFileName(this,tr("Chess"),QString(),tr("PDF Files (*.pdf);;SVG Files (*.svg)"));
+    if(filename.isEmpty())
+        return;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    PageComposer composer;
+    composer.setStyle( scene->style() );
+    composer.setGrid(columns, rows);
+    for(quint64 i=0; i<collection->count(); i++)
+    {
+        CollectionEntry entry = collection->entry(i);
+        composer.addDiagram(entry.position, entry.title);
+    }
+    bool written = composer.write(filename);
+    QApplication::restoreOverrideCursor();
 
-    scene->setSvgRender(false);
+    if( written )
+        statusBar()->showMessage( tr("Wrote %1 diagrams on %2 pages in %3 ms").arg(composer.diagramCount()).arg(composer.pageCount()).arg(composer.milliseconds()) );
+    else
+        QMessageBox::warning(this,tr("Chess"),tr("Could not write %1").arg(filename));
+}
+
+void MainWindow::showCollectionEntry(quint64 index)
+{
+    bool ok;
+    CollectionEntry entry = collection->entry(index, &ok);
+    if( !ok )
+    {
+        statusBar()->showMessage( tr("Position %1 of the collection is damaged").arg(index + 1) );
+        return;
+    }
+    nCollectionIndex = index;
+    scene->setPosition(entry.position);
+    scene->clearAnnotations();
+    eSideToMove = entry.sideToMove;
+    browser->setCurrentEntry(index);
+
+    QString title = entry.title.isEmpty() ? tr("Position %1").arg(index + 1) : entry.title;
+    QString side = entry.sideToMove == Piece::White ? tr("White to move") : tr("Black to move");
+    setWindowTitle( tr("%1 (%2 of %3, %4) - Chess").arg(title).arg(index + 1).arg(collection->count()).arg(side) );
 }
 
 void MainWindow::setLightSquareColor()
 {
     QColor col = QColorDialog::getColor(scene->lightSquareColor(), this, tr("Choose a color") );
     if(col.isValid())
+    {
         scene->setLightSquareColor(col);
+        browser->setBoardStyle(scene->style());
+    }
 }
 
 void MainWindow::setDarkSquareColor()
 {
     QColor col = QColorDialog::getColor(scene->darkSquareColor(), this, tr("Choose a color") );
     if(col.isValid())
+    {
         scene->setDarkSquareColor(col);
+        browser->setBoardStyle(scene->style());
+    }
 }
 
 void MainWindow::setLightPieceColor()
 {
     QColor col = QColorDialog::getColor(scene->lightPieceColor(), this, tr("Choose a color") );
     if(col.isValid())
+    {
         scene->setLightPieceColor(col);
+        browser->setBoardStyle(scene->style());
+    }
 }
 
 void MainWindow::setDarkPieceColor()
 {
     QColor col = QColorDialog::getColor(scene->darkPieceColor(), this, tr("Choose a color") );
     if(col.isValid())
+    {
         scene->setDarkPieceColor(col);
+        browser->setBoardStyle(scene->style());
+    }
+}
+
+void MainWindow::setPieceVersion(QAction *action)
+{
+    scene->setVersion(action);
+    browser->setBoardStyle(scene->style());
+}
+
+void MainWindow::setPieceTheme(QAction *action)
+{
+    scene->setPieceTheme(action);
+    browser->setBoardStyle(scene->style());
+}
+
+void MainWindow::zoomIn()
+{
+    rZoom = qMin( rZoom * 1.25, 16.0 );
+    applyZoom();
+}
+
+void MainWindow::zoomOut()
+{
+    rZoom = qMax( rZoom / 1.25, 0.25 );
+    applyZoom();
+}
+
+void MainWindow::resetZoom()
+{
+    rZoom = 1.0;
+    applyZoom();
+}
+
+void MainWindow::applyZoom()
+{
+    view->setTransform( QTransform::fromScale(rZoom, rZoom) );
+    scene->setPixelScale( rZoom, view->devicePixelRatioF() );
 }
 
 QColor MainWindow::colorFromString(QString s) const
@@ -2,9 +2,25 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QFutureWatcher>
+
+#include "piece.h"
+#include "matesolver.h"
 
 class ChessBoard;
 class QSettings;
+class QGraphicsView;
+class CollectionFile;
+class CollectionIndex;
+class PerformanceOverlay;
+class QUndoStack;
+class QLabel;
+class QDockWidget;
+class QTimer;
+class QActionGroup;
+class UciEngine;
+class CollectionBrowser;
+struct EngineEvaluation;
 
 class MainWindow : public QMainWindow
 {
@@ -17,7 +33,33 @@ public:
 
 private:
     ChessBoard *scene;
+    QGraphicsView *view;
+    PerformanceOverlay *overlay;
+    QUndoStack *undoStack;
     QSettings *settings;
+    qreal rZoom;
+
+    CollectionFile *collection;
+    CollectionIndex *collectionIndex;
+    quint64 nCollectionIndex;
+    CollectionBrowser *browser;
+    QDockWidget *browserDock;
+    QAction *previousPosition, *nextPosition, *goToPosition, *findPosition, *composePages;
+
+    Piece::Color eSideToMove;
+
+    MateSolver *solver;
+    QFutureWatcher<MateResult> *solveWatcher;
+    BitboardPosition solvedPosition;
+    int nSolveMoves;
+
+    UciEngine *engine;
+    QString sEnginePath;
+    QDockWidget *engineDock;
+    QLabel *engineLabel;
+    QAction *analyseAction;
+    QTimer *analyseTimer;
+    void startEngine();
 
     void getSettings();
     void setSettings();
@@ -27,16 +69,49 @@ private:
     QString stringFromColor(QColor c) const;
 
     QAction *traditional, *secularized;
+    QActionGroup *themeGroup;
+
+    void applyZoom();
+    bool reportProblems();
 
 private slots:
     void save();
     void open();
     void createSvg();
+    void exportPng();
+    void exportAnimation();
+    void checkPosition();
+    void solveMate();
+    void showMateResult();
+
+    void openCollection();
+    void showPreviousPosition();
+    void showNextPosition();
+    void goToCollectionPosition();
+    void findInCollection();
+    void composeCollection();
+    void showCollectionEntry(quint64 index);
 
     void setLightSquareColor();
     void setDarkSquareColor();
     void setLightPieceColor();
     void setDarkPieceColor();
+    void setPieceVersion(QAction *action);
+    void setPieceTheme(QAction *action);
+
+    void zoomIn();
+    void zoomOut();
+    void resetZoom();
+
+    void chooseEngine();
+    void setAnalysing(bool on);
+    void analyseBoard();
+    void showEvaluation(const EngineEvaluation & evaluation);
+    void showEngineError(const QString & message);
+
+    void showPlacement();
+    void setPerformanceOverlay(bool on);
+    void savePerformanceTrace();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,214 @@
+#include "matesolver.h"
+
+#include <QtCore>
+
+class MateSearch
+{
+public:
+    explicit MateSearch(MateSolver *solver) : solver(solver), nodes(0) { }
+
+    bool attackerMates(const BitboardPosition & p, int n);
+    bool defenderLoses(const BitboardPosition & p, int n);
+
+    MateSolver *solver;
+    quint64 nodes;
+};
+
+// whether the side to move can force mate in at most n moves
+bool MateSearch::attackerMates(const BitboardPosition & p, int n)
+{
+    int known = solver->probe(p.key(), n);
+    if( known != 0 )
+        return known == MateSolver::Mates;
+
+    nodes++;
+    BitboardPosition::Move moves[BitboardPosition::MaxMoves];
+    int count = p.legalMoves(moves);
+
+    // checks first, since most mates are found through them; the last move has to be one
+    bool quiet[BitboardPosition::MaxMoves];
+    bool found = false;
+    for(int i=0; i<count && !found; i++)
+    {
+        BitboardPosition after = p;
+        after.makeMove(moves[i]);
+        quiet[i] = !after.inCheck();
+        if( !quiet[i] )
+            found = defenderLoses(after, n);
+    }
+    for(int i=0; i<count && !found && n > 1; i++)
+    {
+        if( !quiet[i] )
+            continue;
+        BitboardPosition after = p;
+        after.makeMove(moves[i]);
+        found = defenderLoses(after, n);
+    }
+
+    // an interrupted search proves nothing
+    if( solver->bStop.load() )
+        return false;
+    solver->store(p.key(), n, found ? MateSolver::Mates : MateSolver::NoMate);
+    return found;
+}
+
+// whether the side to move, having just been given the attacker's nth move
+// from the end, is mated now or after every reply
+bool MateSearch::defenderLoses(const BitboardPosition & p, int n)
+{
+    nodes++;
+    BitboardPosition::Move replies[BitboardPosition::MaxMoves];
+    int count = p.legalMoves(replies);
+    if( count == 0 )
+        return p.inCheck();
+    if( n == 1 || solver->bStop.load() )
+        return false;
+
+    for(int i=0; i<count; i++)
+    {
+        BitboardPosition after = p;
+        after.makeMove(replies[i]);
+        if( !attackerMates(after, n - 1) )
+            return false;
+    }
+    return true;
+}
+
+// the moves at the root for one depth, and which of them mate
+struct RootJob
+{
+    BitboardPosition position;
+    BitboardPosition::Move moves[BitboardPosition::MaxMoves];
+    bool mates[BitboardPosition::MaxMoves];
+    int count;
+    int n;
+    QAtomicInt next;
+    QAtomicInteger<quint64> nodes;
+    QSemaphore done;
+};
+
+class RootWorker : public QRunnable
+{
+public:
+    RootWorker(MateSolver *solver, RootJob *job) : solver(solver), job(job) { }
+
+    void run();
+
+private:
+    MateSolver *solver;
+    RootJob *job;
+};
+
+void RootWorker::run()
+{
+    MateSearch search(solver);
+    int i;
+    while( (i = job->next.fetchAndAddRelaxed(1)) < job->count )
+    {
+        BitboardPosition after = job->position;
+        after.makeMove(job->moves[i]);
+        job->mates[i] = search.defenderLoses(after, job->n);
+    }
+    job->nodes.fetchAndAddRelaxed(search.nodes);
+    job->done.release();
+}
+
+MateSolver::MateSolver(int tableMegabytes)
+{
+    quint64 entries = 1;
+    while( entries * 2 * 2 * sizeof(quint64) <= (quint64)tableMegabytes * 1024 * 1024 )
+        entries *= 2;
+    table = new QAtomicInteger<quint64>[entries * 2];
+    nMask = entries - 1;
+
+    nThreads = 1;
+    setThreadCount( QThread::idealThreadCount() );
+    bStop = 0;
+}
+
+MateSolver::~MateSolver()
+{
+    stop();
+    pool.waitForDone();
+    delete[] table;
+}
+
+void MateSolver::setThreadCount(int n)
+{
+    nThreads = qMax(1, n);
+    // the thread calling solve() does a share of the work itself
+    pool.setMaxThreadCount( qMax(1, nThreads - 1) );
+}
+
+void MateSolver::clear()
+{
+    for(quint64 i=0; i<(nMask + 1) * 2; i++)
+        table[i].store(0);
+}
+
+int MateSolver::probe(quint64 key, int n) const
+{
+    const QAtomicInteger<quint64> *entry = table + ( key & nMask ) * 2;
+    quint64 check = entry[0].load();
+    quint64 data = entry[1].load();
+    if( data == 0 || ( check ^ data ) != key )
+        return 0;
+
+    int depth = data >> 8;
+    int bound = data & 0xFF;
+    if( bound == Mates && depth <= n )
+        return Mates;
+    if( bound == NoMate && depth >= n )
+        return NoMate;
+    return 0;
+}
+
+void MateSolver::store(quint64 key, int n, Bound bound)
+{
+    QAtomicInteger<quint64> *entry = table + ( key & nMask ) * 2;
+    quint64 data = ( (quint64)n << 8 ) | bound;
+    entry[0].store(key ^ data);
+    entry[1].store(data);
+}
+
+MateResult MateSolver::solve(const BitboardPosition & position, int maxMoves)
+{
+    MateResult result;
+    QElapsedTimer timer;
+    timer.start();
+    bStop = 0;
+
+    RootJob job;
+    job.position = position;
+    job.count = position.legalMoves(job.moves);
+    job.nodes = 0;
+
+    for(int n=1; n<=maxMoves && job.count > 0; n++)
+    {
+        job.n = n;
+        job.next = 0;
+        int helpers = qMin(nThreads, job.count) - 1;
+        for(int i=0; i<helpers; i++)
+            pool.start( new RootWorker(this, &job) );
+        RootWorker(this, &job).run();
+        job.done.acquire(helpers + 1);
+
+        if( bStop.load() )
+        {
+            result.stopped = true;
+            break;
+        }
+        for(int i=0; i<job.count; i++)
+            if( job.mates[i] )
+                result.keys << job.moves[i];
+        if( !result.keys.isEmpty() )
+        {
+            result.mateIn = n;
+            break;
+        }
+    }
+
+    result.nodes = job.nodes.load() + 1;
+    result.milliseconds = timer.elapsed();
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef MATESOLVER_H
+#define MATESOLVER_H
+
+#include <QList>
+#include <QAtomicInteger>
+#include <QThreadPool>
+
+#include "bitboardposition.h"
+
+struct MateResult
+{
+    MateResult() : mateIn(0), nodes(0), milliseconds(0), stopped(false) { }
+
+    bool isUnique() const { return keys.count() == 1; }
+
+    int mateIn;     // 0 if there is no mate within the limit
+    QList<BitboardPosition::Move> keys;     // every first move that mates in mateIn
+    quint64 nodes;
+    qint64 milliseconds;
+    bool stopped;
+};
+
+// Finds the shortest forced mate for the side to move and every key move
+// that achieves it, so that cooked puzzles show up. The search is a
+// depth-first proof search with cutoffs; the first moves are shared out
+// among worker threads, which share one transposition table.
+//
+// solve() may be called from several threads at once, and stop() from any
+// thread.
+class MateSolver
+{
+public:
+    explicit MateSolver(int tableMegabytes = 64);
+    ~MateSolver();
+
+    void setThreadCount(int n);
+    int threadCount() const { return nThreads; }
+
+    MateResult solve(const BitboardPosition & position, int maxMoves);
+
+    void stop() { bStop.store(1); }
+    void clear();
+
+private:
+    friend class MateSearch;
+    friend class RootWorker;
+
+    enum Bound { Mates = 1, NoMate = 2 };
+
+    // n is the number of moves of the side to move
+    int probe(quint64 key, int n) const;
+    void store(quint64 key, int n, Bound bound);
+
+    // each entry is a pair: the key xor the data, and the data, so a torn
+    // write by another thread fails the key check instead of giving a wrong answer
+    QAtomicInteger<quint64> *table;
+    quint64 nMask;
+
+    int nThreads;
+    QThreadPool pool;
+    QAtomicInt bStop;
+};
+
+#endif // MATESOLVER_H
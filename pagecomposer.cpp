@@ -0,0 +1,561 @@
+#include "pagecomposer.h"
+
+#include <QtCore>
+#include <QPainter>
+#include <QPaintEngine>
+#include <zlib.h>
+#include <climits>
+
+#include "positionsource.h"
+#include "svgboardwriter.h"
+#include "piecerenderercache.h"
+#include "instrumentation.h"
+
+// pages built at once before they are written, per thread
+enum { PagesPerThread = 16, PieceSize = 45 };
+
+static QByteArray num(qreal v)
+{
+    QByteArray s = QByteArray::number(v, 'f', 3);
+    while( s.endsWith('0') )
+        s.chop(1);
+    if( s.endsWith('.') )
+        s.chop(1);
+    if( s == "-0" )
+        s = "0";
+    return s;
+}
+
+static QByteArray pdfColor(QColor c)
+{
+    return num( c.redF() ) + " " + num( c.greenF() ) + " " + num( c.blueF() );
+}
+
+static QByteArray pdfString(const QString & text)
+{
+    QByteArray latin = text.toLatin1();
+    QByteArray s = "(";
+    for(int i=0; i<latin.size(); i++)
+    {
+        if( latin.at(i) == '(' || latin.at(i) == ')' || latin.at(i) == '\\' )
+            s += '\\';
+        s += latin.at(i);
+    }
+    return s + ")";
+}
+
+static QByteArray compressed(const QByteArray & data)
+{
+    uLongf length = compressBound( data.size() );
+    QByteArray out( length, Qt::Uninitialized );
+    compress2( reinterpret_cast<Bytef*>( out.data() ), &length, reinterpret_cast<const Bytef*>( data.constData() ), data.size(), Z_DEFAULT_COMPRESSION );
+    out.resize( length );
+    return out;
+}
+
+// Records what a piece's picture draws as PDF path operators, so that a piece
+// can be written once as a form XObject. The artwork is plain filled and
+// stroked paths; gradients and opacity are not carried over.
+class PdfOutlineEngine : public QPaintEngine
+{
+public:
+    PdfOutlineEngine() : QPaintEngine(AllFeatures) { }
+
+    bool begin(QPaintDevice *) { return true; }
+    bool end() { return true; }
+    void updateState(const QPaintEngineState &) { }
+    void drawPath(const QPainterPath & path) { emitPath(path, true); }
+    void drawPolygon(const QPointF *points, int pointCount, PolygonDrawMode mode);
+    void drawPixmap(const QRectF &, const QPixmap &, const QRectF &) { }
+    Type type() const { return User; }
+
+    QColor tint;
+    QByteArray content;
+
+private:
+    void emitPath(const QPainterPath & path, bool fill);
+    QColor color(QColor c) const { return tint == Qt::black ? c : SvgBoardWriter::tinted(c, tint); }
+};
+
+void PdfOutlineEngine::drawPolygon(const QPointF *points, int pointCount, PolygonDrawMode mode)
+{
+    if( pointCount < 2 )
+        return;
+    QPainterPath path( points[0] );
+    for(int i=1; i<pointCount; i++)
+        path.lineTo( points[i] );
+    if( mode != PolylineMode )
+        path.closeSubpath();
+    path.setFillRule( mode == OddEvenMode ? Qt::OddEvenFill : Qt::WindingFill );
+    emitPath( path, mode != PolylineMode );
+}
+
+void PdfOutlineEngine::emitPath(const QPainterPath & path, bool fill)
+{
+    const QPen pen = state->pen();
+    const QBrush brush = state->brush();
+    const QTransform transform = state->transform();
+    bool stroke = pen.style() != Qt::NoPen && pen.brush().style() != Qt::NoBrush;
+    fill = fill && brush.style() != Qt::NoBrush;
+    if( !fill && !stroke )
+        return;
+
+    if( fill )
+        content += pdfColor( color( brush.color() ) ) + " rg\n";
+    if( stroke )
+    {
+        qreal width = pen.isCosmetic() ? qMax<qreal>(pen.widthF(), 1.0) : pen.widthF() * qSqrt( qAbs( transform.determinant() ) );
+        int cap = pen.capStyle() == Qt::RoundCap ? 1 : ( pen.capStyle() == Qt::SquareCap ? 2 : 0 );
+        int join = pen.joinStyle() == Qt::RoundJoin ? 1 : ( pen.joinStyle() == Qt::BevelJoin ? 2 : 0 );
+        content += pdfColor( color( pen.color() ) ) + " RG " + num(width) + " w " + QByteArray::number(cap) + " J "
+                + QByteArray::number(join) + " j " + num( pen.miterLimit() ) + " M\n";
+    }
+
+    const QPainterPath mapped = transform.map(path);
+    QPointF start;
+    for(int i=0; i<mapped.elementCount(); i++)
+    {
+        const QPainterPath::Element & e = mapped.elementAt(i);
+        if( e.isMoveTo() )
+        {
+            start = e;
+            content += num(e.x) + " " + num(e.y) + " m\n";
+        }
+        else if( e.isLineTo() )
+        {
+            bool last = i + 1 == mapped.elementCount() || mapped.elementAt(i+1).isMoveTo();
+            if( last && QPointF(e) == start )
+                content += "h\n";
+            else
+                content += num(e.x) + " " + num(e.y) + " l\n";
+        }
+        else if( e.isCurveTo() && i + 2 < mapped.elementCount() )
+        {
+            const QPainterPath::Element & c2 = mapped.elementAt(i+1);
+            const QPainterPath::Element & end = mapped.elementAt(i+2);
+            content += num(e.x) + " " + num(e.y) + " " + num(c2.x) + " " + num(c2.y) + " " + num(end.x) + " " + num(end.y) + " c\n";
+            i += 2;
+        }
+    }
+
+    bool oddEven = mapped.fillRule() == Qt::OddEvenFill;
+    if( fill && stroke )
+        content += oddEven ? "B*\n" : "B\n";
+    else if( fill )
+        content += oddEven ? "f*\n" : "f\n";
+    else
+        content += "S\n";
+}
+
+class PdfOutlineDevice : public QPaintDevice
+{
+public:
+    QPaintEngine * paintEngine() const { return const_cast<PdfOutlineEngine*>(&engine); }
+
+    PdfOutlineEngine engine;
+
+protected:
+    int metric(PaintDeviceMetric m) const;
+};
+
+int PdfOutlineDevice::metric(PaintDeviceMetric m) const
+{
+    switch(m)
+    {
+    case PdmWidth:
+    case PdmHeight:
+        return PieceSize;
+    case PdmWidthMM:
+    case PdmHeightMM:
+        return qRound( PieceSize * 25.4 / 72 );
+    case PdmNumColors:
+        return INT_MAX;
+    case PdmDepth:
+        return 32;
+    case PdmDevicePixelRatio:
+        return 1;
+    case PdmDevicePixelRatioScaled:
+        return int( devicePixelRatioFScale() );
+    default:
+        return 72;
+    }
+}
+
+// the piece drawn in a PieceSize square, as the content of a form XObject
+static QByteArray pieceForm(Piece p, const BoardStyle & style)
+{
+    PdfOutlineDevice device;
+    device.engine.tint = p.color() == Piece::White ? style.lightPiece : style.darkPiece;
+    QPainter painter(&device);
+    PieceRendererCache::instance()->render( &painter, p, style.version, style.pieceTheme, QRectF(0, 0, PieceSize, PieceSize) );
+    painter.end();
+    return device.engine.content;
+}
+
+// Numbers objects and remembers where each starts, for the cross-reference table.
+class PdfObjects
+{
+public:
+    explicit PdfObjects(QIODevice *device) : device(device), nOffset(0), bOk(true) { }
+
+    void write(const QByteArray & data)
+    {
+        bOk = bOk && device->write(data) == data.size();
+        nOffset += data.size();
+    }
+    void object(int number, const QByteArray & body)
+    {
+        begin(number);
+        write( body + "\nendobj\n" );
+    }
+    void stream(int number, const QByteArray & dictionary, const QByteArray & data)
+    {
+        begin(number);
+        write( "<< " + dictionary + " /Filter /FlateDecode /Length " + QByteArray::number( data.size() ) + " >>\nstream\n" );
+        write( data );
+        write( "\nendstream\nendobj\n" );
+    }
+    bool finish(int count)
+    {
+        qint64 start = nOffset;
+        QByteArray table = "xref\n0 " + QByteArray::number(count) + "\n0000000000 65535 f \n";
+        for(int i=1; i<count; i++)
+            table += QByteArray::number( offsets.value(i) ).rightJustified(10, '0') + " 00000 n \n";
+        write( table );
+        write( "trailer\n<< /Size " + QByteArray::number(count) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(start) + "\n%%EOF\n" );
+        return bOk;
+    }
+
+private:
+    void begin(int number)
+    {
+        offsets.insert(number, nOffset);
+        write( QByteArray::number(number) + " 0 obj\n" );
+    }
+
+    QIODevice *device;
+    qint64 nOffset;
+    bool bOk;
+    QHash<int,qint64> offsets;
+};
+
+class PageWorker : public QRunnable
+{
+public:
+    PageWorker(const PageComposer *composer, bool pdf, int first, int count, QByteArray *pages, QAtomicInt *next)
+        : composer(composer), pdf(pdf), first(first), count(count), pages(pages), next(next) { }
+
+    void run()
+    {
+        int i;
+        while( (i = next->fetchAndAddRelaxed(1)) < count )
+        {
+            ScopedTimer timer("page");
+            pages[i] = composer->pageContent(first + i, pdf);
+        }
+    }
+
+private:
+    const PageComposer *composer;
+    bool pdf;
+    int first;
+    int count;
+    QByteArray *pages;
+    QAtomicInt *next;
+};
+
+PageComposer::PageComposer()
+{
+    nSkipped = 0;
+    nColumns = 2;
+    nRows = 3;
+    sPageSize = QSizeF(595.28, 841.89);
+    rMargin = 42;
+    rCaptionSize = 9;
+    bNumbered = true;
+    nThreads = QThread::idealThreadCount();
+    nMilliseconds = 0;
+}
+
+bool PageComposer::addInput(const QString & path)
+{
+    PositionSource source;
+    if( !source.addInput(path) )
+        return false;
+    foreach(const PositionSource::Item & item, source.items())
+    {
+        CollectionEntry entry;
+        if( item.read(&entry) )
+            addDiagram(entry.position, entry.title);
+        else
+            nSkipped++;
+    }
+    return true;
+}
+
+int PageComposer::pageCount() const
+{
+    int perPage = nColumns * nRows;
+    return ( diagrams.count() + perPage - 1 ) / perPage;
+}
+
+QList<PageComposer::Cell> PageComposer::cells(int page) const
+{
+    const int perPage = nColumns * nRows;
+    const qreal cellWidth = ( sPageSize.width() - 2 * rMargin ) / nColumns;
+    const qreal cellHeight = ( sPageSize.height() - 2 * rMargin ) / nRows;
+    const qreal captionHeight = rCaptionSize * 2;
+    const qreal side = qMin( cellWidth, cellHeight - captionHeight ) * 0.9;
+
+    QList<Cell> cells;
+    for(int k=0; k<perPage; k++)
+    {
+        int index = page * perPage + k;
+        if( index >= diagrams.count() )
+            break;
+        qreal x = rMargin + ( k % nColumns ) * cellWidth + ( cellWidth - side ) / 2;
+        qreal y = rMargin + ( k / nColumns ) * cellHeight + ( cellHeight - captionHeight - side ) / 2;
+
+        Cell cell;
+        cell.board = QRectF(x, y, side, side);
+        cell.caption = QPointF(x, y + side + rCaptionSize * 1.5);
+        const QString & caption = diagrams.at(index).caption;
+        if( bNumbered )
+            cell.text = caption.isEmpty() ? QString("%1.").arg(index + 1) : QString("%1. %2").arg(index + 1).arg(caption);
+        else
+            cell.text = caption;
+        cells << cell;
+    }
+    return cells;
+}
+
+void PageComposer::usedPieces(bool used[2][6]) const
+{
+    for(int c=0; c<2; c++)
+        for(int t=0; t<6; t++)
+            used[c][t] = false;
+    foreach(const Diagram & diagram, diagrams)
+    {
+        for(int i=0; i<64; i++)
+        {
+            Piece p = Position::pieceFromCode( diagram.position.code(i) );
+            if( p.type() != Piece::None )
+                used[p.color()][p.type()] = true;
+        }
+    }
+}
+
+QByteArray PageComposer::pageContent(int page, bool pdf) const
+{
+    const int perPage = nColumns * nRows;
+    QList<Cell> layout = cells(page);
+    QByteArray out;
+
+    if( pdf )
+    {
+        // y runs down the page, as in SVG; text is flipped back with its own matrix
+        out += "1 0 0 -1 0 " + num( sPageSize.height() ) + " cm\n";
+        for(int k=0; k<layout.count(); k++)
+        {
+            const Cell & cell = layout.at(k);
+            const Position & position = diagrams.at(page * perPage + k).position;
+            const qreal x = cell.board.x(), y = cell.board.y(), w = cell.board.width() / 8;
+
+            out += pdfColor( mStyle.lightSquare ) + " rg " + num(x) + " " + num(y) + " " + num(8 * w) + " " + num(8 * w) + " re f\n";
+            out += pdfColor( mStyle.darkSquare ) + " rg\n";
+            for(int i=0; i<8; i++)
+                for(int j=0; j<8; j++)
+                    if( i % 2 != j % 2 )
+                        out += num(x + j * w) + " " + num(y + i * w) + " " + num(w) + " " + num(w) + " re\n";
+            out += "f\n0 G 0.5 w " + num(x) + " " + num(y) + " " + num(8 * w) + " " + num(8 * w) + " re S\n";
+
+            const QByteArray scale = num( w / PieceSize );
+            for(int i=0; i<8; i++)
+            {
+                for(int j=0; j<8; j++)
+                {
+                    Piece p = position.at(i,j);
+                    if( p.type() != Piece::None )
+                        out += "q " + scale + " 0 0 " + scale + " " + num(x + j * w) + " " + num(y + i * w) + " cm /P" + SvgBoardWriter::pieceId(p) + " Do Q\n";
+                }
+            }
+
+            if( !cell.text.isEmpty() )
+                out += "BT 0 g /F1 " + num(rCaptionSize) + " Tf 1 0 0 -1 " + num( cell.caption.x() ) + " " + num( cell.caption.y() ) + " Tm "
+                        + pdfString(cell.text) + " Tj ET\n";
+        }
+        return compressed(out);
+    }
+
+    out += "<g transform=\"translate(0," + num( page * sPageSize.height() ) + ")\">\n";
+    out += "<rect width=\"" + num( sPageSize.width() ) + "\" height=\"" + num( sPageSize.height() ) + "\" fill=\"#ffffff\"/>\n";
+    for(int k=0; k<layout.count(); k++)
+    {
+        const Cell & cell = layout.at(k);
+        const Position & position = diagrams.at(page * perPage + k).position;
+        const qreal w = cell.board.width() / 8;
+
+        out += "<g transform=\"translate(" + num( cell.board.x() ) + "," + num( cell.board.y() ) + ") scale(" + num( w / PieceSize ) + ")\">";
+        out += "<use xlink:href=\"#board\"/>";
+        for(int i=0; i<8; i++)
+        {
+            for(int j=0; j<8; j++)
+            {
+                Piece p = position.at(i,j);
+                if( p.type() != Piece::None )
+                    out += "<use xlink:href=\"#" + SvgBoardWriter::pieceId(p) + "\" x=\"" + QByteArray::number(j * PieceSize) + "\" y=\"" + QByteArray::number(i * PieceSize) + "\"/>";
+            }
+        }
+        out += "</g>\n";
+        out += "<rect x=\"" + num( cell.board.x() ) + "\" y=\"" + num( cell.board.y() ) + "\" width=\"" + num( cell.board.width() ) + "\" height=\"" + num( cell.board.height() )
+                + "\" fill=\"none\" stroke=\"#000000\" stroke-width=\"0.5\"/>\n";
+        if( !cell.text.isEmpty() )
+            out += "<text x=\"" + num( cell.caption.x() ) + "\" y=\"" + num( cell.caption.y() ) + "\">" + cell.text.toHtmlEscaped().toUtf8() + "</text>\n";
+    }
+    out += "</g>\n";
+    return out;
+}
+
+QVector<QByteArray> PageComposer::buildPages(int first, int count, bool pdf) const
+{
+    QVector<QByteArray> pages(count);
+    QAtomicInt next(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount( qMax(1, nThreads) );
+    for(int i=0; i<pool.maxThreadCount(); i++)
+        pool.start( new PageWorker(this, pdf, first, count, pages.data(), &next) );
+    pool.waitForDone();
+    return pages;
+}
+
+bool PageComposer::write(const QString & filename)
+{
+    QFile file(filename);
+    if(!file.open(QFile::WriteOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+    if( QFileInfo(filename).suffix().toLower() == "svg" )
+        return writeSvg(&file);
+    else
+        return writePdf(&file);
+}
+
+bool PageComposer::writePdf(QIODevice *device)
+{
+    if( device == 0 || !device->isWritable() )
+        return false;
+    ScopedTimer scopedTimer("pdf pages");
+    Instrumentation::count(Instrumentation::Exports);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1 catalog, 2 page tree, 3 resources, 4 font, then the pieces, then each page and its content
+    bool used[2][6];
+    usedPieces(used);
+    QByteArray pieceResources;
+    QList<Piece> pieces;
+    for(int c=0; c<2; c++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            if( !used[c][t] )
+                continue;
+            Piece p( (Piece::Type)t, (Piece::Color)c );
+            pieceResources += " /P" + SvgBoardWriter::pieceId(p) + " " + QByteArray::number( 5 + pieces.count() ) + " 0 R";
+            pieces << p;
+        }
+    }
+    const int firstPage = 5 + pieces.count();
+    const int pages = pageCount();
+
+    PdfObjects pdf(device);
+    pdf.write( "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n" );
+    pdf.object( 1, "<< /Type /Catalog /Pages 2 0 R >>" );
+
+    QByteArray kids;
+    for(int i=0; i<pages; i++)
+        kids += QByteArray::number( firstPage + 2 * i ) + " 0 R ";
+    pdf.object( 2, "<< /Type /Pages /Count " + QByteArray::number(pages) + " /MediaBox [0 0 " + num( sPageSize.width() ) + " " + num( sPageSize.height() ) + "] /Kids [" + kids + "] >>" );
+    pdf.object( 3, "<< /Font << /F1 4 0 R >> /XObject <<" + pieceResources + " >> >>" );
+    pdf.object( 4, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>" );
+
+    for(int i=0; i<pieces.count(); i++)
+        pdf.stream( 5 + i, "/Type /XObject /Subtype /Form /BBox [0 0 45 45]", compressed( pieceForm( pieces.at(i), mStyle ) ) );
+
+    const int batch = qMax(1, nThreads) * PagesPerThread;
+    for(int first=0; first<pages; first+=batch)
+    {
+        QVector<QByteArray> content = buildPages( first, qMin(batch, pages - first), true );
+        for(int i=0; i<content.count(); i++)
+        {
+            int number = firstPage + 2 * ( first + i );
+            pdf.object( number, "<< /Type /Page /Parent 2 0 R /Resources 3 0 R /Contents " + QByteArray::number(number + 1) + " 0 R >>" );
+            pdf.stream( number + 1, QByteArray(), content.at(i) );
+        }
+    }
+
+    bool ok = pdf.finish( firstPage + 2 * pages );
+    nMilliseconds = timer.elapsed();
+    return ok;
+}
+
+bool PageComposer::writeSvg(QIODevice *device)
+{
+    if( device == 0 || !device->isWritable() )
+        return false;
+    ScopedTimer scopedTimer("svg pages");
+    Instrumentation::count(Instrumentation::Exports);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the pages are stacked one above the other
+    const int pages = pageCount();
+    const QByteArray width = num( sPageSize.width() );
+    const QByteArray height = num( sPageSize.height() * pages );
+
+    QByteArray darkSquares;
+    for(int i=0; i<8; i++)
+        for(int j=0; j<8; j++)
+            if( i % 2 != j % 2 )
+                darkSquares += "M" + QByteArray::number(j * PieceSize) + " " + QByteArray::number(i * PieceSize) + "h45v45h-45z";
+
+    QByteArray head;
+    head += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    head += "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\""
+            " width=\"" + width + "pt\" height=\"" + height + "pt\" viewBox=\"0 0 " + width + " " + height + "\""
+            " font-family=\"Helvetica, Arial, sans-serif\" font-size=\"" + num(rCaptionSize) + "\">\n";
+    head += "<defs>\n";
+    head += "<g id=\"board\"><rect width=\"360\" height=\"360\" fill=\"" + mStyle.lightSquare.name().toLatin1() + "\"/>"
+            "<path fill=\"" + mStyle.darkSquare.name().toLatin1() + "\" d=\"" + darkSquares + "\"/></g>\n";
+    bool used[2][6];
+    usedPieces(used);
+    for(int c=0; c<2; c++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            if( !used[c][t] )
+                continue;
+            Piece p( (Piece::Type)t, (Piece::Color)c );
+            QColor tint = p.color() == Piece::White ? mStyle.lightPiece : mStyle.darkPiece;
+            head += SvgBoardWriter::pieceDefinition(p, mStyle.version, mStyle.pieceTheme, tint, SvgBoardWriter::pieceId(p), PieceSize);
+        }
+    }
+    head += "</defs>\n";
+    bool ok = device->write(head) == head.size();
+
+    const int batch = qMax(1, nThreads) * PagesPerThread;
+    for(int first=0; first<pages && ok; first+=batch)
+    {
+        QVector<QByteArray> content = buildPages( first, qMin(batch, pages - first), false );
+        for(int i=0; i<content.count() && ok; i++)
+            ok = device->write( content.at(i) ) == content.at(i).size();
+    }
+    ok = ok && device->write("</svg>\n") == 7;
+
+    nMilliseconds = timer.elapsed();
+    return ok;
+}
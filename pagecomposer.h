@@ -0,0 +1,86 @@
+#ifndef PAGECOMPOSER_H
+#define PAGECOMPOSER_H
+
+#include <QStringList>
+#include <QSizeF>
+#include <QRectF>
+#include <QVector>
+
+#include "chessboard.h"
+#include "position.h"
+
+class QIODevice;
+
+// Lays out many diagrams on pages, a grid of boards with a caption under
+// each, and writes the pages as one PDF or SVG document. Each piece is
+// defined once per document (a form XObject in PDF, a <defs> entry in SVG)
+// and every board places it by reference, so a book of thousands of
+// diagrams stays small. The pages are built on a pool of threads and
+// written in order.
+class PageComposer
+{
+public:
+    struct Diagram
+    {
+        Position position;
+        QString caption;
+    };
+
+    PageComposer();
+
+    // a collection (.chc), a .chs file, a directory of .chs files, or a list file with one .chs path or position per line;
+    // positions that cannot be read are counted by skipped()
+    bool addInput(const QString & path);
+    void addDiagram(const Position & position, const QString & caption);
+    int diagramCount() const { return diagrams.count(); }
+    int skipped() const { return nSkipped; }
+
+    void setStyle(const BoardStyle & style) { mStyle = style; }
+    void setGrid(int columns, int rows) { nColumns = qMax(1, columns); nRows = qMax(1, rows); }
+    // in points; the default is A4
+    void setPageSize(const QSizeF & size) { sPageSize = size; }
+    void setMargin(qreal points) { rMargin = points; }
+    // captions are numbered from 1 in the order the diagrams were added
+    void setNumbered(bool numbered) { bNumbered = numbered; }
+    void setThreadCount(int n) { nThreads = n; }
+
+    int pageCount() const;
+
+    // the format is chosen by the suffix, .pdf or .svg
+    bool write(const QString & filename);
+    bool writePdf(QIODevice *device);
+    bool writeSvg(QIODevice *device);
+
+    qint64 milliseconds() const { return nMilliseconds; }
+
+private:
+    struct Cell
+    {
+        QRectF board;
+        QPointF caption;    // start of the baseline
+        QString text;
+    };
+
+    friend class PageWorker;
+    QByteArray pageContent(int page, bool pdf) const;
+    QList<Cell> cells(int page) const;
+    void usedPieces(bool used[2][6]) const;
+    // pages first to first + count - 1, as PDF content streams (compressed) or SVG groups
+    QVector<QByteArray> buildPages(int first, int count, bool pdf) const;
+
+    QList<Diagram> diagrams;
+    int nSkipped;
+
+    BoardStyle mStyle;
+    int nColumns;
+    int nRows;
+    QSizeF sPageSize;
+    qreal rMargin;
+    qreal rCaptionSize;
+    bool bNumbered;
+    int nThreads;
+
+    qint64 nMilliseconds;
+};
+
+#endif // PAGECOMPOSER_H
@@ -0,0 +1,54 @@
+#include "performanceoverlay.h"
+
+#include <QtWidgets>
+#include "instrumentation.h"
+
+PerformanceOverlay::PerformanceOverlay(QWidget *parent) :
+    QLabel(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAutoFillBackground(true);
+    QPalette p = palette();
+    p.setColor( QPalette::Window, QColor(0, 0, 0, 180) );
+    p.setColor( QPalette::WindowText, Qt::white );
+    setPalette(p);
+    setFont( QFontDatabase::systemFont(QFontDatabase::FixedFont) );
+    setMargin(6);
+    setTextFormat(Qt::PlainText);
+
+    timer = new QTimer(this);
+    connect(timer,SIGNAL(timeout()),this,SLOT(refresh()));
+    hide();
+}
+
+void PerformanceOverlay::showEvent(QShowEvent *event)
+{
+    refresh();
+    timer->start(500);
+    QLabel::showEvent(event);
+}
+
+void PerformanceOverlay::hideEvent(QHideEvent *event)
+{
+    timer->stop();
+    QLabel::hideEvent(event);
+}
+
+void PerformanceOverlay::refresh()
+{
+    QStringList lines;
+    for(int i=0; i<Instrumentation::CounterCount; i++)
+        lines << QString("%1 %2").arg( Instrumentation::counterName( (Instrumentation::Counter)i ), -16 ).arg( Instrumentation::counter( (Instrumentation::Counter)i ) );
+
+    QList< QPair<QByteArray,Instrumentation::Timing> > timings = Instrumentation::timings();
+    if( !timings.isEmpty() )
+        lines << QString() << QString("%1 %2 %3 %4").arg("", -20).arg("count", 7).arg("avg ms", 8).arg("max ms", 8);
+    for(int i=0; i<timings.count(); i++)
+    {
+        const Instrumentation::Timing & t = timings.at(i).second;
+        lines << QString("%1 %2 %3 %4").arg( QString::fromLatin1( timings.at(i).first ), -20 ).arg( t.count, 7 )
+                 .arg( t.total / 1e6 / qMax<quint64>(1, t.count), 8, 'f', 3 ).arg( t.max / 1e6, 8, 'f', 3 );
+    }
+    setText( lines.join("\n") );
+    adjustSize();
+}
@@ -0,0 +1,27 @@
+#ifndef PERFORMANCEOVERLAY_H
+#define PERFORMANCEOVERLAY_H
+
+#include <QLabel>
+
+class QTimer;
+
+// The instrumentation counters and timings, drawn over the board and
+// refreshed twice a second while visible.
+class PerformanceOverlay : public QLabel
+{
+    Q_OBJECT
+public:
+    explicit PerformanceOverlay(QWidget *parent = 0);
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+
+private slots:
+    void refresh();
+
+private:
+    QTimer *timer;
+};
+
+#endif // PERFORMANCEOVERLAY_H
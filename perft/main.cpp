@@ -0,0 +1,157 @@
+#include <QtCore>
+
+#include "bitboardposition.h"
+
+// The standard test positions with their published node counts
+// (https://www.chessprogramming.org/Perft_Results).
+struct PerftCase
+{
+    const char *name;
+    const char *fen;
+    int depth;
+    quint64 nodes;
+};
+
+static const PerftCase suite[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, Q_UINT64_C(4865609) },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, Q_UINT64_C(4085603) },
+    { "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, Q_UINT64_C(674624) },
+    { "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, Q_UINT64_C(422333) },
+    { "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, Q_UINT64_C(2103487) },
+    { "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, Q_UINT64_C(3894594) },
+    { 0, 0, 0, 0 }
+};
+
+static quint64 perft(const BitboardPosition & position, int depth, bool divide, QTextStream & out)
+{
+    if( !divide )
+        return position.perft(depth);
+
+    BitboardPosition::Move moves[BitboardPosition::MaxMoves];
+    int n = position.legalMoves(moves);
+    quint64 total = 0;
+    for(int i=0; i<n; i++)
+    {
+        BitboardPosition after = position;
+        after.makeMove(moves[i]);
+        quint64 nodes = depth > 1 ? after.perft(depth - 1) : 1;
+        out << BitboardPosition::moveToUci(moves[i]) << ": " << nodes << Qt::endl;
+        total += nodes;
+    }
+    return total;
+}
+
+// moves whose SAN does not lead back to them, in the tree to this depth
+static int sanMismatches(const BitboardPosition & position, int depth, QTextStream & err)
+{
+    BitboardPosition::Move moves[BitboardPosition::MaxMoves];
+    int n = position.legalMoves(moves);
+    int mismatches = 0;
+    for(int i=0; i<n; i++)
+    {
+        QByteArray san = position.moveToSan(moves[i]).toLatin1();
+        BitboardPosition::Move m;
+        if( !position.moveFromSan(san.constData(), san.size(), &m) || m.from != moves[i].from || m.to != moves[i].to || m.promotion != moves[i].promotion )
+        {
+            err << "SAN " << san << " does not read back as " << BitboardPosition::moveToUci(moves[i]) << Qt::endl;
+            mismatches++;
+        }
+        if( depth > 1 )
+        {
+            BitboardPosition after = position;
+            after.makeMove(moves[i]);
+            mismatches += sanMismatches(after, depth - 1, err);
+        }
+    }
+    return mismatches;
+}
+
+static void report(QTextStream & out, const QString & label, quint64 nodes, qint64 ms)
+{
+    out << label << ": " << nodes << " nodes in " << ms << " ms";
+    if( ms > 0 )
+        out << " (" << qRound64( nodes * 1000.0 / ms ) << " nodes/s)";
+    out << Qt::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Counts the leaf nodes of the legal move tree. Without --fen, runs the standard suite and checks the counts, and that the SAN of every move two plies deep reads back as that move.");
+    parser.addHelpOption();
+    QCommandLineOption fenOption("fen", "Position to count from.", "fen");
+    QCommandLineOption depthOption(QStringList() << "d" << "depth", "Depth to count to.", "n");
+    QCommandLineOption divideOption("divide", "With --fen, print the count below each root move.");
+    parser.addOption(fenOption);
+    parser.addOption(depthOption);
+    parser.addOption(divideOption);
+    parser.process(a);
+
+    if( parser.isSet(fenOption) )
+    {
+        QByteArray fen = parser.value(fenOption).toLatin1();
+        BitboardPosition position;
+        if( !position.setFen(fen.constData(), fen.size()) )
+        {
+            err << "Could not read the position: " << fen << Qt::endl;
+            return 1;
+        }
+        int depth = parser.isSet(depthOption) ? parser.value(depthOption).toInt() : 4;
+
+        QElapsedTimer timer;
+        timer.start();
+        quint64 nodes = perft(position, depth, parser.isSet(divideOption), out);
+        report(out, QString("depth %1").arg(depth), nodes, timer.elapsed());
+        return 0;
+    }
+
+    int failures = 0;
+    quint64 totalNodes = 0;
+    QElapsedTimer total;
+    total.start();
+    for(int i=0; suite[i].name != 0; i++)
+    {
+        BitboardPosition position;
+        position.setFen(suite[i].fen, qstrlen(suite[i].fen));
+        int depth = parser.isSet(depthOption) ? qMin( parser.value(depthOption).toInt(), suite[i].depth ) : suite[i].depth;
+
+        QElapsedTimer timer;
+        timer.start();
+        quint64 nodes = position.perft(depth);
+        report(out, QString("%1, depth %2").arg(suite[i].name).arg(depth), nodes, timer.elapsed());
+        totalNodes += nodes;
+
+        if( depth == suite[i].depth && nodes != suite[i].nodes )
+        {
+            err << suite[i].name << ": expected " << suite[i].nodes << " nodes" << Qt::endl;
+            failures++;
+        }
+        // PGN games are replayed through moveFromSan
+        if( sanMismatches(position, 2, err) != 0 )
+            failures++;
+    }
+    report(out, "total", totalNodes, total.elapsed());
+
+    // a pawn on its last rank is refused by setFen, and has no moves after setPosition
+    static const char stuckFen[] = "P3k3/8/8/8/8/8/8/4K3 w - - 0 1";
+    BitboardPosition stuck;
+    if( stuck.setFen(stuckFen, qstrlen(stuckFen)) )
+    {
+        err << "A pawn on the last rank was accepted: " << stuckFen << Qt::endl;
+        failures++;
+    }
+    Position placed;
+    placed.parseFen(stuckFen, qstrlen(stuckFen));
+    stuck.setPosition(placed, Piece::White);
+    if( stuck.perft(1) != 5 )
+    {
+        err << "A pawn on the last rank was given moves: " << stuckFen << Qt::endl;
+        failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
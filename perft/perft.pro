@@ -0,0 +1,22 @@
+# Move generator benchmark: counts the leaf nodes of the legal move tree
+# and checks them against published perft results.
+
+QT       += core
+QT       -= gui
+
+TARGET = perft
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    ../bitboardposition.cpp \
+    ../position.cpp \
+    ../zobrist.cpp
+
+HEADERS += ../bitboardposition.h \
+    ../position.h \
+    ../zobrist.h \
+    ../piece.h
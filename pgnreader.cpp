@@ -0,0 +1,217 @@
+#include "pgnreader.h"
+
+#include <QIODevice>
+#include <QDebug>
+#include <string.h>
+
+static inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+PgnReader::PgnReader(QIODevice *device)
+{
+    pDevice = device;
+    nPos = 0;
+    nLine = 0;
+    bPushedBack = false;
+    ePushedType = EndOfInput;
+}
+
+bool PgnReader::nextLine()
+{
+    if( pDevice->atEnd() )
+        return false;
+    line = pDevice->readLine();
+    nPos = 0;
+    nLine++;
+    return true;
+}
+
+PgnReader::TokenType PgnReader::readToken(QByteArray & text, QByteArray & value)
+{
+    if( bPushedBack )
+    {
+        bPushedBack = false;
+        text = pushedText;
+        value = pushedValue;
+        return ePushedType;
+    }
+
+    forever
+    {
+        if( nPos >= line.size() )
+        {
+            if( !nextLine() )
+                return EndOfInput;
+            if( line.startsWith('%') ) // escape mechanism: ignore the line
+                nPos = line.size();
+            continue;
+        }
+
+        char c = line.at(nPos);
+        if( isSpace(c) )
+        {
+            nPos++;
+            continue;
+        }
+
+        switch(c)
+        {
+        case '[':
+        {
+            int end = line.indexOf(']', nPos);
+            if( end < 0 )
+                end = line.size();
+            QByteArray tag = line.mid(nPos + 1, end - nPos - 1).trimmed();
+            nPos = end + 1;
+            int space = tag.indexOf(' ');
+            text = tag.left(space);
+            value = space < 0 ? QByteArray() : tag.mid(space + 1).trimmed();
+            if( value.startsWith('"') && value.endsWith('"') && value.size() >= 2 )
+                value = value.mid(1, value.size() - 2);
+            value.replace("\\\"", "\"");
+            value.replace("\\\\", "\\");
+            return Tag;
+        }
+        case '{':
+        {
+            text.clear();
+            nPos++;
+            forever
+            {
+                int end = line.indexOf('}', nPos);
+                if( end >= 0 )
+                {
+                    text += line.mid(nPos, end - nPos);
+                    nPos = end + 1;
+                    break;
+                }
+                text += line.mid(nPos);
+                if( !nextLine() )
+                    break;
+            }
+            text = text.simplified();
+            return Comment;
+        }
+        case ';':
+            text = line.mid(nPos + 1).trimmed();
+            nPos = line.size();
+            return Comment;
+        case '(':
+            nPos++;
+            return VariationStart;
+        case ')':
+            nPos++;
+            return VariationEnd;
+        case '*':
+            nPos++;
+            text = "*";
+            return Result;
+        case '$':
+        {
+            int start = ++nPos;
+            while( nPos < line.size() && line.at(nPos) >= '0' && line.at(nPos) <= '9' )
+                nPos++;
+            value = line.mid(start, nPos - start);
+            return Nag;
+        }
+        case '}':
+        case ']':
+            // nothing opened it; skip it rather than stop on it
+            qDebug() << "Unmatched" << QByteArray(1, c) << "in PGN at line" << nLine;
+            nPos++;
+            text = QByteArray(1, c);
+            return Error;
+        default:
+            break;
+        }
+
+        int start = nPos;
+        while( nPos < line.size() && !isSpace(line.at(nPos)) && !strchr("{}();[$", line.at(nPos)) )
+            nPos++;
+        text = line.mid(start, nPos - start);
+        if( text.isEmpty() )
+        {
+            qDebug() << "Unexpected" << QByteArray(1, c) << "in PGN at line" << nLine;
+            nPos++;
+            return Error;
+        }
+
+        if( text == "1-0" || text == "0-1" || text == "1/2-1/2" )
+            return Result;
+        if( text.at(0) >= '0' && text.at(0) <= '9' && !text.startsWith("0-0") )
+        {
+            // move number, possibly run together with the move as in "12.e4"
+            int dot = text.lastIndexOf('.');
+            if( dot < 0 )
+                continue;
+            text = text.mid(dot + 1);
+        }
+        while( text.startsWith('.') )
+            text = text.mid(1);
+        if( text.isEmpty() )
+            continue;
+        return Symbol;
+    }
+}
+
+bool PgnReader::readGame(PgnVisitor *visitor)
+{
+    bool started = false;
+    bool inMoves = false;
+    bool skipping = false;
+    int depth = 0;
+    QByteArray text, value;
+
+    forever
+    {
+        TokenType type = readToken(text, value);
+        switch(type)
+        {
+        case EndOfInput:
+            if( started )
+                visitor->endGame("*");
+            return started;
+        case Tag:
+            if( inMoves )
+            {
+                // a new game began without a result for the last one
+                bPushedBack = true;
+                ePushedType = type;
+                pushedText = text;
+                pushedValue = value;
+                visitor->endGame("*");
+                return true;
+            }
+            started = true;
+            visitor->tag(text, value);
+            break;
+        case Symbol:
+            started = true;
+            inMoves = true;
+            if( depth == 0 && !skipping && !visitor->move(text) )
+                skipping = true;
+            break;
+        case Nag:
+            if( depth == 0 && !skipping )
+                visitor->nag( value.toInt() );
+            break;
+        case Comment:
+            if( depth == 0 && !skipping )
+                visitor->comment(text);
+            break;
+        case VariationStart:
+            depth++;
+            break;
+        case VariationEnd:
+            if( depth > 0 )
+                depth--;
+            break;
+        case Error:
+            break;
+        case Result:
+            if( depth > 0 )
+                break;
+            visitor->endGame(text);
+            return true;
+        }
+    }
+}
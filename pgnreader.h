@@ -0,0 +1,48 @@
+#ifndef PGNREADER_H
+#define PGNREADER_H
+
+#include <QByteArray>
+
+class QIODevice;
+
+// Receives the parts of a game as PgnReader finds them. Only the main line
+// is reported; variations are skipped.
+class PgnVisitor
+{
+public:
+    virtual ~PgnVisitor() { }
+
+    virtual void tag(const QByteArray & name, const QByteArray & value) { Q_UNUSED(name); Q_UNUSED(value); }
+    // return false to skip the rest of the game's moves
+    virtual bool move(const QByteArray & san) = 0;
+    virtual void nag(int n) { Q_UNUSED(n); }
+    virtual void comment(const QByteArray & text) { Q_UNUSED(text); }
+    virtual void endGame(const QByteArray & result) { Q_UNUSED(result); }
+};
+
+// Reads PGN from a device a line at a time, so memory use does not depend
+// on the size of the file or of a game.
+class PgnReader
+{
+public:
+    explicit PgnReader(QIODevice *device);
+
+    // reads one game; returns false when there are no more
+    bool readGame(PgnVisitor *visitor);
+
+private:
+    enum TokenType { EndOfInput, Tag, Symbol, Result, Nag, Comment, VariationStart, VariationEnd, Error };
+
+    TokenType readToken(QByteArray & text, QByteArray & value);
+    bool nextLine();
+
+    QIODevice *pDevice;
+    QByteArray line;
+    int nPos;
+    int nLine;
+    bool bPushedBack;
+    TokenType ePushedType;
+    QByteArray pushedText, pushedValue;
+};
+
+#endif // PGNREADER_H
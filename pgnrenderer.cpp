@@ -0,0 +1,160 @@
+#include "pgnrenderer.h"
+
+#include <QtCore>
+#include "svgboardwriter.h"
+
+class DiagramTask : public QRunnable
+{
+public:
+    DiagramTask(const Position & position, const BoardStyle & style, const QString & filename, QSemaphore *queueSlots, QAtomicInt *failed)
+        : position(position), style(style), filename(filename), queueSlots(queueSlots), failed(failed) { }
+
+    void run()
+    {
+        QFile file(filename);
+        if( !file.open(QFile::WriteOnly) || !SvgBoardWriter().write(position, style, &file) )
+        {
+            qDebug() << "Could not write:" << filename;
+            failed->ref();
+        }
+        queueSlots->release();
+    }
+
+private:
+    Position position;
+    BoardStyle style;
+    QString filename;
+    QSemaphore *queueSlots;
+    QAtomicInt *failed;
+};
+
+PgnRenderer::PgnRenderer()
+{
+    nThreads = QThread::idealThreadCount();
+    eDiagrams = EveryPly;
+    game.setStartingPosition();
+    nPly = 0;
+    bGameFailed = false;
+    bPending = false;
+    bPendingWanted = false;
+    nPendingPly = 0;
+    nGames = 0;
+    nPlies = 0;
+    nDiagrams = 0;
+    nLastProgress = 0;
+}
+
+bool PgnRenderer::render(const QString & filename, QTextStream & report)
+{
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return false;
+    }
+    QDir().mkpath(sOutputDirectory);
+    sBaseName = QFileInfo(filename).completeBaseName();
+
+    pool.setMaxThreadCount(nThreads);
+    queueSlots.release( nThreads * 4 - queueSlots.available() );
+    nFailed = 0;
+    timer.start();
+
+    PgnReader reader(&file);
+    while( reader.readGame(this) )
+        progress(report, false);
+
+    pool.waitForDone();
+    progress(report, true);
+    return nFailed.load() == 0;
+}
+
+void PgnRenderer::progress(QTextStream & report, bool final)
+{
+    qint64 elapsed = timer.elapsed();
+    if( !final && elapsed - nLastProgress < 5000 )
+        return;
+    nLastProgress = elapsed;
+
+    double seconds = qMax<qint64>(elapsed, 1) / 1000.0;
+    report << QString("%1 %2 games, %3 plies, %4 diagrams in %5 s (%6 games/s, %7 plies/s)")
+              .arg( final ? "Done:" : "..." )
+              .arg(nGames).arg(nPlies).arg(nDiagrams)
+              .arg(seconds, 0, 'f', 1)
+              .arg(nGames / seconds, 0, 'f', 0)
+              .arg(nPlies / seconds, 0, 'f', 0) << Qt::endl;
+}
+
+void PgnRenderer::tag(const QByteArray & name, const QByteArray & value)
+{
+    if( name == "FEN" )
+        fen = value;
+}
+
+bool PgnRenderer::move(const QByteArray & san)
+{
+    if( nPly == 0 && !bGameFailed )
+    {
+        // first move of the game: set up the start position now that all tags are in
+        if( !fen.isEmpty() && !game.setFen( fen.constData(), fen.size() ) )
+        {
+            qDebug() << "Game" << nGames + 1 << "has an unreadable FEN tag:" << fen;
+            bGameFailed = true;
+            return false;
+        }
+    }
+
+    flushPending();
+    BitboardPosition::Move m;
+    if( !game.moveFromSan( san.constData(), san.size(), &m ) )
+    {
+        qDebug() << "Game" << nGames + 1 << "has an illegal or unreadable move at ply" << nPly + 1 << ":" << san;
+        bGameFailed = true;
+        return false;
+    }
+    game.makeMove(m);
+    nPly++;
+    nPlies++;
+
+    bPending = true;
+    bPendingWanted = eDiagrams == EveryPly;
+    nPendingPly = nPly;
+    return true;
+}
+
+void PgnRenderer::nag(int n)
+{
+    if( n == 201 )
+        bPendingWanted = bPending;
+}
+
+void PgnRenderer::comment(const QByteArray & text)
+{
+    if( text.contains("[#]") )
+        bPendingWanted = bPending;
+}
+
+void PgnRenderer::endGame(const QByteArray & result)
+{
+    Q_UNUSED(result);
+    flushPending();
+    nGames++;
+
+    game.setStartingPosition();
+    nPly = 0;
+    fen.clear();
+    bGameFailed = false;
+}
+
+void PgnRenderer::flushPending()
+{
+    if( bPending && bPendingWanted )
+    {
+        QString name = QString("%1-%2-%3.svg").arg(sBaseName).arg(nGames + 1, 5, 10, QChar('0')).arg(nPendingPly, 3, 10, QChar('0'));
+        queueSlots.acquire();
+        pool.start( new DiagramTask( game.position(), mStyle, QDir(sOutputDirectory).absoluteFilePath(name), &queueSlots, &nFailed ) );
+        nDiagrams++;
+    }
+    bPending = false;
+    bPendingWanted = false;
+}
@@ -0,0 +1,69 @@
+#ifndef PGNRENDERER_H
+#define PGNRENDERER_H
+
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QElapsedTimer>
+
+#include "pgnreader.h"
+#include "bitboardposition.h"
+#include "chessboard.h"
+
+class QTextStream;
+
+// Renders diagrams from a PGN file: the reading thread parses games and
+// applies their moves while a pool of threads writes the SVG files. The
+// number of diagrams waiting to be written is bounded, so memory use stays
+// flat however large the file is.
+class PgnRenderer : public PgnVisitor
+{
+public:
+    enum Diagrams { EveryPly, TaggedMoves };
+
+    PgnRenderer();
+
+    void setOutputDirectory(const QString & dir) { sOutputDirectory = dir; }
+    void setThreadCount(int n) { nThreads = n; }
+    void setStyle(const BoardStyle & style) { mStyle = style; }
+    // TaggedMoves renders after moves marked with $201 or a "[#]" comment
+    void setDiagrams(Diagrams d) { eDiagrams = d; }
+
+    bool render(const QString & filename, QTextStream & report);
+
+    void tag(const QByteArray & name, const QByteArray & value);
+    bool move(const QByteArray & san);
+    void nag(int n);
+    void comment(const QByteArray & text);
+    void endGame(const QByteArray & result);
+
+private:
+    void flushPending();
+    void progress(QTextStream & report, bool final);
+
+    QString sOutputDirectory;
+    QString sBaseName;
+    int nThreads;
+    BoardStyle mStyle;
+    Diagrams eDiagrams;
+
+    QThreadPool pool;
+    QSemaphore queueSlots;
+    QAtomicInt nFailed;
+
+    BitboardPosition game;
+    int nPly;
+    bool bGameFailed;
+    QByteArray fen;
+
+    bool bPending;
+    bool bPendingWanted;
+    int nPendingPly;
+
+    quint64 nGames;
+    quint64 nPlies;
+    quint64 nDiagrams;
+    QElapsedTimer timer;
+    qint64 nLastProgress;
+};
+
+#endif // PGNRENDERER_H
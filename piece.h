@@ -0,0 +1,28 @@
+#ifndef PIECE_H
+#define PIECE_H
+
+class Piece
+{
+public:
+    enum Type { King, Queen, Bishop, Knight, Rook, Pawn, None };
+    enum Color { White, Black };
+
+    Piece() { eType = None; eColor = White; }
+    Piece(Type t, Color c) { eType = t; eColor = c; }
+
+    bool operator==(const Piece & other) const { return eType == other.eType && ( eType == None || eColor == other.eColor ); }
+    bool operator!=(const Piece & other) const { return !(*this == other); }
+
+    bool hasSecularVariant() const { if( eType == King || eType == Bishop ) return true; else return false; }
+
+    Type type() const { return eType; }
+    Color color() const { return eColor; }
+    void setType(Type t) { eType = t; }
+    void setColor(Color c) { eColor = c; }
+
+private:
+    Type eType;
+    Color eColor;
+};
+
+#endif // PIECE_H
@@ -0,0 +1,82 @@
+#include "piecepixmapcache.h"
+
+#include <QPainter>
+#include "piecerenderercache.h"
+#include "instrumentation.h"
+
+uint qHash(const PiecePixmapCache::Key & key, uint seed)
+{
+    return qHash( (key.type << 16) | (key.color << 8) | key.version , seed ) ^ qHash( key.theme , seed )
+            ^ qHash( key.tint , seed ) ^ qHash( key.size * 1024 + qRound(key.dpr * 64) , seed );
+}
+
+PiecePixmapCache * PiecePixmapCache::instance()
+{
+    static PiecePixmapCache cache;
+    return &cache;
+}
+
+QPixmap PiecePixmapCache::pixmap(Piece p, ChessBoard::Version v, const QString & theme, QColor tint, int size, qreal dpr)
+{
+    if( p.type() == Piece::None )
+        return QPixmap();
+    if( !p.hasSecularVariant() )
+        v = ChessBoard::Traditional;
+
+    Key key;
+    key.type = p.type();
+    key.color = p.color();
+    key.version = v;
+    key.theme = theme;
+    key.tint = tint.rgba();
+    key.size = size;
+    key.dpr = dpr;
+
+    QHash<Key,QPixmap>::const_iterator it = pixmaps.constFind(key);
+    if( it != pixmaps.constEnd() )
+        return it.value();
+
+    // colour or zoom changes leave stale entries behind; keep the cache from growing without bound
+    if( pixmaps.count() >= 256 )
+        pixmaps.clear();
+
+    ScopedTimer timer("piece pixmap");
+    Instrumentation::count(Instrumentation::EffectRenders);
+
+    int edge = qMax( 1, qRound(size * dpr) );
+    QImage image( edge, edge, QImage::Format_ARGB32_Premultiplied );
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    PieceRendererCache::instance()->render( &painter, p, v, theme, QRectF(0, 0, edge, edge) );
+    painter.end();
+
+    QPixmap result = QPixmap::fromImage( colorize(image, tint) );
+    pixmaps.insert(key, result);
+    return result;
+}
+
+QImage PiecePixmapCache::colorize(const QImage & source, QColor tint)
+{
+    QImage image = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    // grayscale, screen the tint over it, then restore the original alpha
+    for(int y=0; y<image.height(); y++)
+    {
+        QRgb *line = reinterpret_cast<QRgb*>( image.scanLine(y) );
+        for(int x=0; x<image.width(); x++)
+        {
+            int g = qGray(line[x]);
+            line[x] = qRgba( g, g, g, qAlpha(line[x]) );
+        }
+    }
+
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Screen);
+    painter.fillRect(image.rect(), tint);
+    painter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+    painter.drawImage(0, 0, source);
+    painter.end();
+
+    return image;
+}
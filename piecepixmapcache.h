@@ -0,0 +1,46 @@
+#ifndef PIECEPIXMAPCACHE_H
+#define PIECEPIXMAPCACHE_H
+
+#include <QHash>
+#include <QPixmap>
+#include <QColor>
+
+#include "chessboard.h"
+
+// Pre-tinted piece pixmaps, so that on-screen pieces are plain pixmap blits
+// rather than an SVG render plus a QGraphicsColorizeEffect on every repaint.
+// QPixmap belongs to the GUI thread, and so does this cache.
+class PiecePixmapCache
+{
+public:
+    static PiecePixmapCache * instance();
+
+    // size is in device-independent pixels; the pixmap is size*dpr pixels wide
+    QPixmap pixmap(Piece p, ChessBoard::Version v, const QString & theme, QColor tint, int size, qreal dpr);
+
+    // the same tint QGraphicsColorizeEffect applies at full strength
+    static QImage colorize(const QImage & source, QColor tint);
+
+private:
+    PiecePixmapCache() { }
+
+    struct Key
+    {
+        quint8 type, color, version;
+        QString theme;
+        QRgb tint;
+        int size;
+        qreal dpr;
+
+        bool operator==(const Key & other) const
+        {
+            return type == other.type && color == other.color && version == other.version && theme == other.theme
+                    && tint == other.tint && size == other.size && dpr == other.dpr;
+        }
+    };
+    friend uint qHash(const Key & key, uint seed);
+
+    QHash<Key,QPixmap> pixmaps;
+};
+
+#endif // PIECEPIXMAPCACHE_H
@@ -0,0 +1,74 @@
+#include "piecerenderercache.h"
+
+#include <QThreadStorage>
+#include <QPainter>
+#include <QSvgRenderer>
+#include "piecetheme.h"
+#include "instrumentation.h"
+
+QAtomicInt PieceRendererCache::nParseCount;
+
+static QThreadStorage<PieceRendererCache*> caches;
+
+PieceRendererCache::~PieceRendererCache()
+{
+    qDeleteAll(pictures);
+    qDeleteAll(renderers);
+}
+
+PieceRendererCache * PieceRendererCache::instance()
+{
+    if( !caches.hasLocalData() )
+        caches.setLocalData( new PieceRendererCache );
+    return caches.localData();
+}
+
+void PieceRendererCache::render(QPainter *painter, Piece p, ChessBoard::Version v, const QString & theme, const QRectF & bounds)
+{
+    if( p.type() == Piece::None )
+        return;
+
+    Pictures *&set = pictures[theme];
+    if( set == 0 )
+    {
+        set = new Pictures;
+        set->theme = PieceTheme::theme(theme);
+    }
+
+    // each thread plays its own copy, since playing a picture moves through its data
+    QPicture & picture = set->pictures[v][p.color()][p.type()];
+    if( picture.isNull() )
+    {
+        QByteArray data = set->theme->picture(p, v);
+        if( data.isEmpty() )
+            return;
+        picture.setData( data.constData(), data.size() );
+    }
+
+    QRectF box = set->theme->viewBox(p, v);
+    if( box.isEmpty() )
+        return;
+    painter->save();
+    painter->translate( bounds.topLeft() );
+    painter->scale( bounds.width() / box.width(), bounds.height() / box.height() );
+    painter->translate( -box.topLeft() );
+    painter->drawPicture( 0, 0, picture );
+    painter->restore();
+}
+
+QSvgRenderer * PieceRendererCache::renderer(Piece p, ChessBoard::Version v, const QString & theme)
+{
+    if( p.type() == Piece::None )
+        return 0;
+
+    QString filename = PieceTheme::theme(theme)->filename(p, v);
+    QSvgRenderer *& r = renderers[filename];
+    if( r == 0 )
+    {
+        ScopedTimer timer("svg parse");
+        r = new QSvgRenderer( filename );
+        nParseCount.ref();
+        Instrumentation::count(Instrumentation::SvgParses);
+    }
+    return r;
+}
@@ -0,0 +1,48 @@
+#ifndef PIECERENDERERCACHE_H
+#define PIECERENDERERCACHE_H
+
+#include <QHash>
+#include <QPicture>
+
+#include "chessboard.h"
+
+class QSvgRenderer;
+class QPainter;
+class PieceTheme;
+
+// Holds the pieces of each theme as QPictures, read from the theme's
+// recorded painter commands, and a parsed QSvgRenderer for any artwork file
+// a QGraphicsSvgItem needs. There is one cache per thread, since neither
+// may be shared across threads; all boards on a thread share them.
+class PieceRendererCache
+{
+public:
+    ~PieceRendererCache();
+
+    static PieceRendererCache * instance();
+
+    // draws the piece scaled to fill bounds
+    void render(QPainter *painter, Piece p, ChessBoard::Version v, const QString & theme, const QRectF & bounds);
+
+    QSvgRenderer * renderer(Piece p, ChessBoard::Version v, const QString & theme);
+
+    // total number of SVG files parsed, by all caches and themes
+    static int parseCount() { return nParseCount.load(); }
+
+private:
+    PieceRendererCache() { }
+
+    friend class PieceTheme;
+
+    struct Pictures
+    {
+        const PieceTheme *theme;
+        QPicture pictures[2][2][6];
+    };
+    QHash<QString,Pictures*> pictures;
+    QHash<QString,QSvgRenderer*> renderers;
+
+    static QAtomicInt nParseCount;
+};
+
+#endif // PIECERENDERERCACHE_H
@@ -0,0 +1,258 @@
+#include "piecetheme.h"
+
+#include <QtCore>
+#include <QPainter>
+#include <QPicture>
+#include <QSvgRenderer>
+#include <string.h>
+#include "piecerenderercache.h"
+#include "instrumentation.h"
+
+// recursive, since an unknown set is the built-in one, looked up in turn
+static QMutex themeMutex(QMutex::Recursive);
+static QHash<QString,PieceTheme*> themes;
+
+PieceTheme::PieceTheme(const QString & name, const QString & directory)
+{
+    sName = name;
+    sDirectory = directory;
+    for(int v=0; v<2; v++)
+    {
+        for(int c=0; c<2; c++)
+        {
+            for(int t=0; t<6; t++)
+            {
+                QString builtIn = ChessBoard::pieceFilename( Piece( (Piece::Type)t, (Piece::Color)c ), (ChessBoard::Version)v );
+                QString own = directory.isEmpty() ? QString() : directory + "/" + QFileInfo(builtIn).fileName();
+                filenames[v][c][t] = !own.isEmpty() && QFile::exists(own) ? own : builtIn;
+            }
+        }
+    }
+}
+
+QStringList PieceTheme::directories()
+{
+    QStringList result = QStandardPaths::locateAll(QStandardPaths::AppDataLocation, "pieces", QStandardPaths::LocateDirectory);
+    QString beside = QCoreApplication::applicationDirPath() + "/pieces";
+    if( QFileInfo(beside).isDir() && !result.contains(beside) )
+        result << beside;
+    return result;
+}
+
+QStringList PieceTheme::available()
+{
+    QStringList names;
+    foreach(QString directory, directories())
+    {
+        foreach(QFileInfo info, QDir(directory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot))
+        {
+            if( !names.contains(info.fileName()) && !QDir(info.filePath()).entryList(QStringList() << "*.svg", QDir::Files).isEmpty() )
+                names << info.fileName();
+        }
+    }
+    names.sort(Qt::CaseInsensitive);
+    return names;
+}
+
+const PieceTheme * PieceTheme::theme(const QString & name)
+{
+    QMutexLocker locker(&themeMutex);
+    PieceTheme *t = themes.value(name);
+    if( t != 0 )
+        return t;
+
+    QString directory;
+    foreach(QString d, directories())
+    {
+        if( !name.isEmpty() && QFileInfo(d + "/" + name).isDir() )
+        {
+            directory = d + "/" + name;
+            break;
+        }
+    }
+
+    if( !name.isEmpty() && directory.isEmpty() )
+    {
+        // remembered under the name, so that an unknown set is looked for only once
+        qDebug() << "Could not open:" << name;
+        t = const_cast<PieceTheme*>( theme(QString()) );
+    }
+    else
+    {
+        t = new PieceTheme(name, directory);
+        t->load();
+    }
+    themes.insert(name, t);
+    return t;
+}
+
+void PieceTheme::preload()
+{
+    theme(QString());
+    foreach(QString name, available())
+        theme(name);
+}
+
+QString PieceTheme::filename(Piece p, ChessBoard::Version v) const
+{
+    if( p.type() == Piece::None )
+        return QString();
+    return filenames[v][p.color()][p.type()];
+}
+
+QByteArray PieceTheme::picture(Piece p, ChessBoard::Version v) const
+{
+    if( p.type() == Piece::None )
+        return QByteArray();
+    return pictures[v][p.color()][p.type()];
+}
+
+QRectF PieceTheme::viewBox(Piece p, ChessBoard::Version v) const
+{
+    if( p.type() == Piece::None )
+        return QRectF();
+    return viewBoxes[v][p.color()][p.type()];
+}
+
+void PieceTheme::load()
+{
+    ScopedTimer timer("piece theme");
+
+    // one file per source directory, so sets of the same name in different places do not clash
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pieces";
+    QString path = QString("%1/%2.chp").arg(directory).arg( qHash( sDirectory.isEmpty() ? QString(":/resources") : sDirectory ), 8, 16, QChar('0') );
+
+    QByteArray sources = signature();
+    if( readCache(path, sources) )
+        return;
+
+    parse();
+    if( !QDir().mkpath(directory) )
+    {
+        qDebug() << "Could not open:" << directory;
+        return;
+    }
+    writeCache(path, sources);
+}
+
+QByteArray PieceTheme::signature() const
+{
+    // reading the files is cheap next to parsing them, and unlike their
+    // times it also works for the built-in set
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for(int v=0; v<2; v++)
+    {
+        for(int c=0; c<2; c++)
+        {
+            for(int t=0; t<6; t++)
+            {
+                QFile file( filenames[v][c][t] );
+                hash.addData( filenames[v][c][t].toUtf8() );
+                if( file.open(QFile::ReadOnly) )
+                    hash.addData( &file );
+            }
+        }
+    }
+    return hash.result();
+}
+
+bool PieceTheme::readCache(const QString & path, const QByteArray & signature)
+{
+    QFile file(path);
+    if( !file.open(QFile::ReadOnly) )
+        return false;
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    char magic[4];
+    quint32 format = 0, streamVersion = 0;
+    QByteArray sources;
+    if( in.readRawData(magic, 4) != 4 || memcmp(magic, "CHP1", 4) != 0 )
+        return false;
+    in >> format >> streamVersion;
+    if( format != FormatVersion || streamVersion != (quint32)in.version() )
+        return false;
+    in >> sources;
+    if( sources != signature )
+        return false;
+
+    for(int v=0; v<2; v++)
+        for(int c=0; c<2; c++)
+            for(int t=0; t<6; t++)
+                in >> viewBoxes[v][c][t] >> pictures[v][c][t];
+
+    if( in.status() != QDataStream::Ok )
+    {
+        for(int v=0; v<2; v++)
+            for(int c=0; c<2; c++)
+                for(int t=0; t<6; t++)
+                    pictures[v][c][t].clear();
+        return false;
+    }
+    return true;
+}
+
+void PieceTheme::writeCache(const QString & path, const QByteArray & signature) const
+{
+    QSaveFile file(path);
+    if( !file.open(QFile::WriteOnly) )
+    {
+        qDebug() << "Could not open:" << path;
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData("CHP1", 4);
+    out << (quint32)FormatVersion << (quint32)out.version() << signature;
+    for(int v=0; v<2; v++)
+        for(int c=0; c<2; c++)
+            for(int t=0; t<6; t++)
+                out << viewBoxes[v][c][t] << pictures[v][c][t];
+
+    if( !file.commit() )
+        qDebug() << "Could not open:" << path;
+}
+
+void PieceTheme::parse()
+{
+    // the secular and traditional sets share most of their files
+    QHash<QString,int> parsed;
+    for(int v=0; v<2; v++)
+    {
+        for(int c=0; c<2; c++)
+        {
+            for(int t=0; t<6; t++)
+            {
+                const QString & filename = filenames[v][c][t];
+                if( parsed.contains(filename) )
+                {
+                    int i = parsed.value(filename);
+                    pictures[v][c][t] = pictures[i / 12][i / 6 % 2][i % 6];
+                    viewBoxes[v][c][t] = viewBoxes[i / 12][i / 6 % 2][i % 6];
+                    continue;
+                }
+                parsed.insert(filename, v * 12 + c * 6 + t);
+
+                ScopedTimer timer("svg parse");
+                QSvgRenderer renderer(filename);
+                PieceRendererCache::nParseCount.ref();
+                Instrumentation::count(Instrumentation::SvgParses);
+                if( !renderer.isValid() )
+                {
+                    qDebug() << "Could not open:" << filename;
+                    continue;
+                }
+
+                // drawn into its own view box, so that the picture's coordinates are the artwork's
+                QRectF box = renderer.viewBoxF();
+                QPicture picture;
+                QPainter painter(&picture);
+                renderer.render(&painter, box);
+                painter.end();
+                viewBoxes[v][c][t] = box;
+                pictures[v][c][t] = QByteArray( picture.data(), picture.size() );
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef PIECETHEME_H
+#define PIECETHEME_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QRectF>
+
+#include "chessboard.h"
+
+// A set of piece artwork. The set without a name is the one built into the
+// resources; any other is a directory under one of directories(), holding
+// SVG files named as the built-in ones are (white-king.svg,
+// black-bishop-secular.svg, ...). A piece the directory lacks is taken from
+// the built-in set.
+//
+// Each set is parsed once into QPicture recordings of the painter commands
+// that draw its pieces, which are written to a cache file (.chp) so that
+// later launches read them back without parsing any SVG. The file is
+// little-endian:
+//
+//   header   "CHP1", quint32 format version, quint32 QDataStream version,
+//            QByteArray SHA-1 of the contents of the set's SVG files
+//   pieces   for each version, colour and type: QRectF view box, QByteArray picture
+//
+// A file whose header does not match is ignored and written afresh.
+class PieceTheme
+{
+public:
+    enum { FormatVersion = 1 };
+
+    // where sets are looked for: "pieces" under the application data
+    // locations and beside the program
+    static QStringList directories();
+    // the names of the sets found there, sorted
+    static QStringList available();
+
+    // the set with this name, read the first time it is asked for; an
+    // unknown name gives the built-in set. Safe to call from any thread,
+    // and the set returned stays valid until the program ends.
+    static const PieceTheme * theme(const QString & name);
+
+    // reads every set, so that choosing one later does not wait for it
+    static void preload();
+
+    QString name() const { return sName; }
+
+    // the SVG file of a piece, for writers that copy the artwork itself
+    QString filename(Piece p, ChessBoard::Version v) const;
+
+    // the recorded painter commands of a piece, in the coordinates of its view box
+    QByteArray picture(Piece p, ChessBoard::Version v) const;
+    QRectF viewBox(Piece p, ChessBoard::Version v) const;
+
+private:
+    PieceTheme(const QString & name, const QString & directory);
+
+    void load();
+    QByteArray signature() const;
+    bool readCache(const QString & path, const QByteArray & signature);
+    void writeCache(const QString & path, const QByteArray & signature) const;
+    void parse();
+
+    QString sName;
+    QString sDirectory;
+    QString filenames[2][2][6];
+    QByteArray pictures[2][2][6];
+    QRectF viewBoxes[2][2][6];
+};
+
+#endif // PIECETHEME_H
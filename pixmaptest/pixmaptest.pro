@@ -0,0 +1,41 @@
+# Tests that the pre-tinted piece pixmaps look like the pieces the scene used
+# to draw: each SVG file on a QGraphicsSvgItem with a QGraphicsColorizeEffect.
+# Run with -platform offscreen where there is no display.
+
+QT       += core gui svg widgets testlib
+
+TARGET = pixmaptest
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += .. ../testsupport
+
+SOURCES += tst_piecepixmapcache.cpp \
+    ../chessboard.cpp \
+    ../boarditem.cpp \
+    ../annotations.cpp \
+    ../annotationitem.cpp \
+    ../piecerenderercache.cpp \
+    ../piecetheme.cpp \
+    ../piecepixmapcache.cpp \
+    ../svgboardwriter.cpp \
+    ../position.cpp \
+    ../zobrist.cpp \
+    ../instrumentation.cpp
+
+HEADERS += ../testsupport/imagecomparison.h \
+    ../chessboard.h \
+    ../boarditem.h \
+    ../annotations.h \
+    ../annotationitem.h \
+    ../piecerenderercache.h \
+    ../piecetheme.h \
+    ../piecepixmapcache.h \
+    ../svgboardwriter.h \
+    ../position.h \
+    ../zobrist.h \
+    ../instrumentation.h \
+    ../piece.h
+
+RESOURCES += ../resources.qrc
@@ -0,0 +1,93 @@
+#include <QtTest>
+#include <QGraphicsScene>
+#include <QGraphicsSvgItem>
+#include <QGraphicsColorizeEffect>
+#include <QSvgRenderer>
+#include <QPainter>
+
+#include "chessboard.h"
+#include "piecepixmapcache.h"
+#include "imagecomparison.h"
+
+class PiecePixmapCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void matchesSvg_data();
+    void matchesSvg();
+
+private:
+    static QImage directRender(Piece p, ChessBoard::Version v, QColor tint, int edge);
+};
+
+void PiecePixmapCacheTest::initTestCase()
+{
+    useTestLocations();
+}
+
+// the piece as the scene drew it before the cache: the SVG file on an item,
+// tinted by a colorize effect at full strength
+QImage PiecePixmapCacheTest::directRender(Piece p, ChessBoard::Version v, QColor tint, int edge)
+{
+    QGraphicsScene scene;
+    QGraphicsSvgItem *item = new QGraphicsSvgItem( ChessBoard::pieceFilename(p, v) );
+    QRectF bounds = item->boundingRect();
+    item->setScale( edge / bounds.width() );
+    QGraphicsColorizeEffect *effect = new QGraphicsColorizeEffect;
+    effect->setColor(tint);
+    effect->setStrength(1.0);
+    item->setGraphicsEffect(effect);
+    scene.addItem(item);
+    scene.setSceneRect( 0, 0, edge, edge );
+
+    QImage image( edge, edge, QImage::Format_ARGB32_Premultiplied );
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    scene.render( &painter, QRectF(0, 0, edge, edge), QRectF(0, 0, edge, edge) );
+    painter.end();
+    return image;
+}
+
+void PiecePixmapCacheTest::matchesSvg_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("color");
+    QTest::addColumn<int>("version");
+    QTest::addColumn<QColor>("tint");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<qreal>("dpr");
+
+    QTest::newRow("white king, 45 px") << (int)Piece::King << (int)Piece::White << (int)ChessBoard::Traditional << QColor(Qt::black) << 45 << 1.0;
+    QTest::newRow("black knight, 45 px") << (int)Piece::Knight << (int)Piece::Black << (int)ChessBoard::Traditional << QColor("#804000") << 45 << 1.0;
+    QTest::newRow("white queen, 45 px at 2x") << (int)Piece::Queen << (int)Piece::White << (int)ChessBoard::Traditional << QColor("#004080") << 45 << 2.0;
+    QTest::newRow("black bishop, 80 px at 1.5x") << (int)Piece::Bishop << (int)Piece::Black << (int)ChessBoard::Traditional << QColor(Qt::black) << 80 << 1.5;
+    QTest::newRow("secular white bishop, 80 px at 2x") << (int)Piece::Bishop << (int)Piece::White << (int)ChessBoard::Secular << QColor("#806020") << 80 << 2.0;
+}
+
+void PiecePixmapCacheTest::matchesSvg()
+{
+    QFETCH(int, type);
+    QFETCH(int, color);
+    QFETCH(int, version);
+    QFETCH(QColor, tint);
+    QFETCH(int, size);
+    QFETCH(qreal, dpr);
+
+    Piece p( (Piece::Type)type, (Piece::Color)color );
+    ChessBoard::Version v = (ChessBoard::Version)version;
+
+    QPixmap pixmap = PiecePixmapCache::instance()->pixmap( p, v, QString(), tint, size, dpr );
+    int edge = qRound(size * dpr);
+    QCOMPARE( pixmap.width(), edge );
+    compareImages( pixmap.toImage(), directRender(p, v, tint, edge), 3.0, 32 );
+
+    // a second request is the same pixmap, not a new render
+    QCOMPARE( PiecePixmapCache::instance()->pixmap( p, v, QString(), tint, size, dpr ).cacheKey(), pixmap.cacheKey() );
+}
+
+QTEST_MAIN(PiecePixmapCacheTest)
+
+#include "tst_piecepixmapcache.moc"
@@ -0,0 +1,241 @@
+#include "position.h"
+
+#include <string.h>
+
+#include "zobrist.h"
+
+static inline int character(char c) { return (uchar)c; }
+static inline int character(QChar c) { return c.unicode(); }
+
+static inline bool isSpace(int c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// indexed by Piece::Type
+static const char chsLetters[] = "KQBHRPN";
+static const char fenLetters[] = "KQBNRP";
+
+bool Position::operator==(const Position & other) const
+{
+    for(int i=0; i<32; i++)
+        if( squares[i] != other.squares[i] )
+            return false;
+    return true;
+}
+
+quint64 Position::key(Piece::Color sideToMove) const
+{
+    const ZobristKeys & z = zobristKeys();
+    quint64 k = sideToMove == Piece::Black ? z.blackToMove : 0;
+    for(int i=0; i<32; i++)
+        k ^= z.packed[i][ squares[i] ];
+    return k;
+}
+
+template<typename Char>
+bool Position::parseChsText(const Char *data, int length)
+{
+    Position result;
+    int square = 0;
+    int i = 0;
+    while( square < 64 )
+    {
+        while( i < length && isSpace( character(data[i]) ) )
+            i++;
+        if( i + 1 >= length )
+            return false;
+
+        int c = character(data[i]);
+        int t = character(data[i+1]);
+        i += 2;
+        if( i < length && !isSpace( character(data[i]) ) )
+            return false;
+
+        if( c != 'W' && c != 'B' )
+            return false;
+
+        quint8 code;
+        switch(t)
+        {
+        case 'K':
+            code = Piece::King + 1;
+            break;
+        case 'Q':
+            code = Piece::Queen + 1;
+            break;
+        case 'B':
+            code = Piece::Bishop + 1;
+            break;
+        case 'H':
+            code = Piece::Knight + 1;
+            break;
+        case 'R':
+            code = Piece::Rook + 1;
+            break;
+        case 'P':
+            code = Piece::Pawn + 1;
+            break;
+        case 'N':
+            code = 0;
+            break;
+        default:
+            return false;
+        }
+        if( code != 0 && c == 'B' )
+            code += 8;
+
+        result.setCode(square++, code);
+    }
+    *this = result;
+    return true;
+}
+
+template<typename Char>
+bool Position::parseFenText(const Char *data, int length, Piece::Color *sideToMove)
+{
+    Position result;
+    int i = 0;
+    while( i < length && isSpace( character(data[i]) ) )
+        i++;
+
+    int row = 0, col = 0;
+    for( ; i < length; i++ )
+    {
+        int c = character(data[i]);
+        if( isSpace(c) )
+            break;
+
+        if( c == '/' )
+        {
+            if( col != 8 || row == 7 )
+                return false;
+            row++;
+            col = 0;
+        }
+        else if( c >= '1' && c <= '8' )
+        {
+            col += c - '0';
+            if( col > 8 )
+                return false;
+        }
+        else
+        {
+            int lower = c | 0x20;
+            int type = 0;
+            while( fenLetters[type] != 0 && ( fenLetters[type] | 0x20 ) != lower )
+                type++;
+            if( fenLetters[type] == 0 || col >= 8 )
+                return false;
+            result.setCode( row * 8 + col , type + 1 + ( c == lower ? 8 : 0 ) );
+            col++;
+        }
+    }
+    if( row != 7 || col != 8 )
+        return false;
+
+    if( sideToMove != 0 )
+    {
+        while( i < length && isSpace( character(data[i]) ) )
+            i++;
+        *sideToMove = ( i < length && character(data[i]) == 'b' ) ? Piece::Black : Piece::White;
+    }
+
+    *this = result;
+    return true;
+}
+
+bool Position::parseChs(const char *data, int length)
+{
+    return parseChsText(data, length);
+}
+
+bool Position::parseChs(const QChar *data, int length)
+{
+    return parseChsText(data, length);
+}
+
+bool Position::parseFen(const char *data, int length, Piece::Color *sideToMove)
+{
+    return parseFenText(data, length, sideToMove);
+}
+
+bool Position::parseFen(const QChar *data, int length, Piece::Color *sideToMove)
+{
+    return parseFenText(data, length, sideToMove);
+}
+
+bool Position::parse(const QString & s, Piece::Color *sideToMove)
+{
+    if( s.contains('/') )
+        return parseFen(s.constData(), s.length(), sideToMove);
+    if( sideToMove != 0 )
+        *sideToMove = Piece::White;
+    return parseChs(s.constData(), s.length());
+}
+
+bool Position::parse(const char *data, int length, Piece::Color *sideToMove)
+{
+    if( memchr(data, '/', length) != 0 )
+        return parseFen(data, length, sideToMove);
+    if( sideToMove != 0 )
+        *sideToMove = Piece::White;
+    return parseChs(data, length);
+}
+
+int Position::writeChs(char *out) const
+{
+    char *p = out;
+    for(int square=0; square<64; square++)
+    {
+        quint8 c = code(square);
+        if( square > 0 )
+            *p++ = ' ';
+        *p++ = (c & 8) ? 'B' : 'W';
+        *p++ = c == 0 ? 'N' : chsLetters[ (c & 7) - 1 ];
+    }
+    return p - out;
+}
+
+int Position::writeFen(char *out, Piece::Color sideToMove) const
+{
+    char *p = out;
+    for(int row=0; row<8; row++)
+    {
+        if( row > 0 )
+            *p++ = '/';
+        int empty = 0;
+        for(int col=0; col<8; col++)
+        {
+            quint8 c = code(row * 8 + col);
+            if( c == 0 )
+            {
+                empty++;
+                continue;
+            }
+            if( empty > 0 )
+            {
+                *p++ = '0' + empty;
+                empty = 0;
+            }
+            char letter = fenLetters[ (c & 7) - 1 ];
+            *p++ = (c & 8) ? ( letter | 0x20 ) : letter;
+        }
+        if( empty > 0 )
+            *p++ = '0' + empty;
+    }
+
+    const char *rest = sideToMove == Piece::Black ? " b - - 0 1" : " w - - 0 1";
+    while( *rest )
+        *p++ = *rest++;
+    return p - out;
+}
+
+QString Position::toChs() const
+{
+    char buffer[ChsLength];
+    return QString::fromLatin1( buffer, writeChs(buffer) );
+}
+
+QString Position::toFen(Piece::Color sideToMove) const
+{
+    char buffer[FenLength];
+    return QString::fromLatin1( buffer, writeFen(buffer, sideToMove) );
+}
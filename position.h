@@ -0,0 +1,74 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <QtGlobal>
+#include <QString>
+
+#include "piece.h"
+
+// A board packed into 32 bytes, four bits per square. Squares are numbered
+// row * 8 + column, with row 0 at the top of the board (Black's back rank),
+// as in ChessBoard. A nibble is 0 for an empty square, Piece::Type + 1 for
+// a white piece and Piece::Type + 9 for a black one.
+//
+// The parsers and writers work on caller-supplied buffers and do not
+// allocate.
+class Position
+{
+public:
+    enum { ChsLength = 64 * 3 - 1, FenLength = 92 };
+
+    Position() { clear(); }
+
+    void clear() { for(int i=0; i<32; i++) squares[i] = 0; }
+
+    inline quint8 code(int square) const { return ( squares[square >> 1] >> ( (square & 1) << 2 ) ) & 0x0F; }
+    inline void setCode(int square, quint8 c)
+    {
+        int shift = (square & 1) << 2;
+        squares[square >> 1] = ( squares[square >> 1] & ~(0x0F << shift) ) | ( (c & 0x0F) << shift );
+    }
+
+    inline Piece at(int row, int col) const { return pieceFromCode( code(row * 8 + col) ); }
+    inline void set(int row, int col, Piece p) { setCode( row * 8 + col , codeFromPiece(p) ); }
+
+    static inline quint8 codeFromPiece(Piece p) { return p.type() == Piece::None ? 0 : ( p.type() + 1 + ( p.color() == Piece::Black ? 8 : 0 ) ); }
+    static inline Piece pieceFromCode(quint8 c) { return c == 0 ? Piece() : Piece( (Piece::Type)( (c & 7) - 1 ), (c & 8) ? Piece::Black : Piece::White ); }
+
+    const quint8 * data() const { return squares; }
+    quint8 * data() { return squares; }
+
+    // Zobrist hash of the board and the side to move (see zobrist.h)
+    quint64 key(Piece::Color sideToMove = Piece::White) const;
+
+    bool operator==(const Position & other) const;
+    bool operator!=(const Position & other) const { return !(*this == other); }
+
+    // .chs: 64 whitespace-separated two-letter codes, colour (W/B) then piece
+    // (K, Q, B, H for knight, R, P, or N for an empty square). Files written
+    // before knights had their own letter used K for both; those read as kings.
+    bool parseChs(const char *data, int length);
+    bool parseChs(const QChar *data, int length);
+    int writeChs(char *out) const; // out must hold ChsLength bytes
+
+    // FEN: the piece placement field, optionally followed by the rest of the
+    // record, of which only the side to move is read.
+    bool parseFen(const char *data, int length, Piece::Color *sideToMove = 0);
+    bool parseFen(const QChar *data, int length, Piece::Color *sideToMove = 0);
+    int writeFen(char *out, Piece::Color sideToMove) const; // out must hold FenLength bytes
+
+    // either format, telling them apart by the '/' rank separators of FEN
+    bool parse(const QString & s, Piece::Color *sideToMove = 0);
+    bool parse(const char *data, int length, Piece::Color *sideToMove = 0);
+
+    QString toChs() const;
+    QString toFen(Piece::Color sideToMove = Piece::White) const;
+
+private:
+    template<typename Char> bool parseChsText(const Char *data, int length);
+    template<typename Char> bool parseFenText(const Char *data, int length, Piece::Color *sideToMove);
+
+    quint8 squares[32];
+};
+
+#endif // POSITION_H
@@ -0,0 +1,156 @@
+#include "positionquery.h"
+
+#include <QtCore>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "position.h"
+
+PositionQuery::PositionQuery()
+{
+}
+
+bool PositionQuery::parse(const QString & text)
+{
+    static const char letters[] = "KQBNRP";
+
+    terms.clear();
+    sError.clear();
+    foreach(QString word, text.split(' ', Qt::SkipEmptyParts))
+    {
+        Term term;
+        term.negated = word.startsWith('!');
+        QString spec = term.negated ? word.mid(1) : word;
+        if( spec.isEmpty() )
+        {
+            sError = QString("Nothing after ! in: %1").arg(word);
+            return false;
+        }
+
+        quint8 code;
+        char c = spec.at(0).toLatin1();
+        if( c == '.' )
+        {
+            code = 0;
+        }
+        else
+        {
+            const char *found = c != 0 ? strchr(letters, QChar(c).toUpper().toLatin1()) : 0;
+            if( found == 0 )
+            {
+                sError = QString("Not a piece letter: %1").arg(word);
+                return false;
+            }
+            code = ( found - letters ) + 1 + ( QChar(c).isLower() ? 8 : 0 );
+        }
+
+        int file = -1, rank = -1, i = 1;
+        if( i < spec.length() && spec.at(i) >= 'a' && spec.at(i) <= 'h' )
+            file = spec.at(i++).toLatin1() - 'a';
+        if( i < spec.length() && spec.at(i) >= '1' && spec.at(i) <= '8' )
+            rank = spec.at(i++).toLatin1() - '1';
+        if( i != spec.length() )
+        {
+            sError = QString("Not a square, file or rank: %1").arg(word);
+            return false;
+        }
+
+        memset(term.pattern, code | ( code << 4 ), 32);
+        memset(term.lowMask, 0, 32);
+        memset(term.highMask, 0, 32);
+        for(int square=0; square<64; square++)
+        {
+            int row = square / 8, col = square % 8;
+            if( ( file >= 0 && col != file ) || ( rank >= 0 && 7 - row != rank ) )
+                continue;
+            if( square & 1 )
+                term.highMask[square >> 1] = 0xFF;
+            else
+                term.lowMask[square >> 1] = 0xFF;
+        }
+        terms << term;
+    }
+    return true;
+}
+
+bool PositionQuery::matches(const quint8 *position) const
+{
+    for(int t=0; t<terms.count(); t++)
+    {
+        const Term & term = terms.at(t);
+        bool found;
+#ifdef __SSE2__
+        // xor with the pattern leaves a zero nibble wherever the square holds the code
+        const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+        const __m128i highNibbles = _mm_set1_epi8((char)0xF0);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i any = zero;
+        for(int half=0; half<32; half+=16)
+        {
+            __m128i x = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>(position + half) ),
+                                       _mm_loadu_si128( reinterpret_cast<const __m128i*>(term.pattern + half) ) );
+            __m128i low = _mm_and_si128( _mm_cmpeq_epi8( _mm_and_si128(x, lowNibbles), zero ),
+                                         _mm_loadu_si128( reinterpret_cast<const __m128i*>(term.lowMask + half) ) );
+            __m128i high = _mm_and_si128( _mm_cmpeq_epi8( _mm_and_si128(x, highNibbles), zero ),
+                                          _mm_loadu_si128( reinterpret_cast<const __m128i*>(term.highMask + half) ) );
+            any = _mm_or_si128( any, _mm_or_si128(low, high) );
+        }
+        found = _mm_movemask_epi8(any) != 0;
+#else
+        found = false;
+        for(int i=0; i<32 && !found; i++)
+        {
+            quint8 x = position[i] ^ term.pattern[i];
+            found = ( ( x & 0x0F ) == 0 && term.lowMask[i] ) || ( ( x & 0xF0 ) == 0 && term.highMask[i] );
+        }
+#endif
+        if( found == term.negated )
+            return false;
+    }
+    return true;
+}
+
+class QueryWorker : public QRunnable
+{
+public:
+    QueryWorker(const PositionQuery *query, const quint8 *positions, quint64 begin, quint64 end, QList<quint64> *matches)
+        : query(query), positions(positions), nBegin(begin), nEnd(end), matches(matches) { }
+
+    void run()
+    {
+        for(quint64 i=nBegin; i<nEnd; i++)
+            if( query->matches(positions + 32 * i) )
+                *matches << i;
+    }
+
+private:
+    const PositionQuery *query;
+    const quint8 *positions;
+    quint64 nBegin, nEnd;
+    QList<quint64> *matches;
+};
+
+QList<quint64> PositionQuery::search(const quint8 *positions, quint64 count, int threads) const
+{
+    // one contiguous slice per thread, so the results come out in order when joined
+    threads = qMax(1, threads);
+    QVector< QList<quint64> > matches(threads);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    quint64 slice = ( count + threads - 1 ) / threads;
+    for(int t=0; t<threads; t++)
+    {
+        quint64 begin = qMin<quint64>(count, slice * t);
+        quint64 end = qMin<quint64>(count, begin + slice);
+        pool.start( new QueryWorker(this, positions, begin, end, &matches[t]) );
+    }
+    pool.waitForDone();
+
+    QList<quint64> result;
+    for(int t=0; t<threads; t++)
+        result << matches.at(t);
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef POSITIONQUERY_H
+#define POSITIONQUERY_H
+
+#include <QString>
+#include <QVector>
+#include <QList>
+
+// A pattern over packed Positions, written as space-separated terms. Each
+// term is a piece letter as in FEN (KQBNRP for White, kqbnrp for Black, or
+// '.' for an empty square), then optionally a file, a rank, or both:
+//
+//   Kg1     a white king on g1
+//   q7      a black queen anywhere on the seventh rank
+//   Pe      a white pawn on the e-file
+//   n       a black knight anywhere
+//   !Bc4    no white bishop on c4
+//
+// A position matches when every term holds. Each term is tested on all 64
+// squares at once with SSE2 compares where available.
+class PositionQuery
+{
+public:
+    PositionQuery();
+
+    bool parse(const QString & text);
+    QString errorString() const { return sError; }
+    bool isEmpty() const { return terms.isEmpty(); }
+
+    bool matches(const quint8 *position) const;
+
+    // indexes of the matching positions among count packed Positions, in order
+    QList<quint64> search(const quint8 *positions, quint64 count, int threads) const;
+
+private:
+    struct Term
+    {
+        quint8 pattern[32];     // the piece code in both nibbles of every byte
+        quint8 lowMask[32];     // 0xFF where the even square of the byte is one of the term's
+        quint8 highMask[32];    // likewise for the odd square
+        bool negated;
+    };
+
+    QVector<Term> terms;
+    QString sError;
+};
+
+#endif // POSITIONQUERY_H
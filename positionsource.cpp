@@ -0,0 +1,149 @@
+#include "positionsource.h"
+
+#include <QtCore>
+
+QString PositionSource::Item::name() const
+{
+    QString base = QFileInfo(path).completeBaseName();
+    return number == 0 ? base : QString("%1:%2").arg(base).arg(number);
+}
+
+bool PositionSource::Item::read(CollectionEntry *entry) const
+{
+    if( collection != 0 )
+    {
+        bool ok;
+        *entry = collection->entry(number - 1, &ok);
+        if( !ok )
+            qDebug() << "Could not read entry" << number << "of:" << path;
+        return ok;
+    }
+
+    *entry = CollectionEntry();
+    if( number > 0 )
+    {
+        if( !entry->position.parse(text, &entry->sideToMove) )
+        {
+            qDebug() << "Could not read a position from:" << name();
+            return false;
+        }
+        return true;
+    }
+
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Could not open:" << path;
+        return false;
+    }
+    QByteArray data = file.readAll();
+    if( !entry->position.parse(data.constData(), data.size(), &entry->sideToMove) )
+    {
+        qDebug() << "Could not read a position from:" << path;
+        return false;
+    }
+    entry->title = QFileInfo(path).completeBaseName();
+    return true;
+}
+
+PositionSource::PositionSource()
+{
+}
+
+PositionSource::~PositionSource()
+{
+    qDeleteAll(collections);
+}
+
+bool PositionSource::addInput(const QString & path)
+{
+    QFileInfo info(path);
+    if( info.isDir() )
+    {
+        QDir dir(path);
+        foreach(QString name, dir.entryList(QStringList() << "*.chs", QDir::Files, QDir::Name))
+            addFile( dir.absoluteFilePath(name) );
+        return true;
+    }
+    else if( info.suffix().toLower() == "chc" )
+    {
+        return addCollection(path);
+    }
+    else if( info.suffix().toLower() == "chs" )
+    {
+        if( !info.isReadable() )
+        {
+            qDebug() << "Could not open:" << path;
+            return false;
+        }
+        addFile( info.absoluteFilePath() );
+        return true;
+    }
+    else
+    {
+        return addListFile(path);
+    }
+}
+
+void PositionSource::addFile(const QString & path)
+{
+    Item item;
+    item.path = path;
+    lItems << item;
+}
+
+bool PositionSource::addListFile(const QString & path)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly|QFile::Text))
+    {
+        qDebug() << "Could not open:" << path;
+        return false;
+    }
+
+    QDir base = QFileInfo(path).absoluteDir();
+    QTextStream stream(&file);
+    quint64 lineNumber = 0;
+    while( !stream.atEnd() )
+    {
+        QString line = stream.readLine().trimmed();
+        lineNumber++;
+        if( line.isEmpty() || line.startsWith('#') )
+            continue;
+
+        if( line.endsWith(".chs", Qt::CaseInsensitive) )
+        {
+            addFile( base.absoluteFilePath(line) );
+        }
+        else
+        {
+            Item item;
+            item.path = path;
+            item.text = line;
+            item.number = lineNumber;
+            lItems << item;
+        }
+    }
+    return true;
+}
+
+bool PositionSource::addCollection(const QString & path)
+{
+    CollectionFile *collection = new CollectionFile;
+    if( !collection->open(path) )
+    {
+        delete collection;
+        return false;
+    }
+    collections << collection;
+
+    for(quint64 i=0; i<collection->count(); i++)
+    {
+        Item item;
+        item.path = path;
+        item.collection = collection;
+        item.number = i + 1;
+        lItems << item;
+    }
+    return true;
+}
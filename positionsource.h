@@ -0,0 +1,52 @@
+#ifndef POSITIONSOURCE_H
+#define POSITIONSOURCE_H
+
+#include <QList>
+
+#include "collectionfile.h"
+
+// The positions named by the inputs of the batch commands: a collection
+// (.chc), a .chs file, a directory of .chs files, or a list file with one
+// .chs path (relative to the list) or position per line.
+//
+// An input that cannot be opened makes addInput() fail. A position within
+// one that cannot be read, such as a bad line of a list file or a missing
+// .chs file it names, is kept as an item in its place, and read() fails for
+// it; the caller counts it as failed or skipped and goes on.
+//
+// Nothing is read until read() is called, which may be from any thread, so
+// that a batch can read its positions on its own worker threads.
+class PositionSource
+{
+public:
+    struct Item
+    {
+        Item() : collection(0), number(0) { }
+
+        QString path;       // the .chs file, or the list file or collection the position is in
+        QString text;       // the position, for a line of a list file
+        const CollectionFile *collection;
+        quint64 number;     // the line of the list file or the entry of the collection, from 1; 0 for a .chs file
+
+        // the .chs file's base name, or "list:line" or "collection:entry"
+        QString name() const;
+        // the position, and the collection's title or the .chs file's base name
+        bool read(CollectionEntry *entry) const;
+    };
+
+    PositionSource();
+    ~PositionSource();
+
+    bool addInput(const QString & path);
+    const QList<Item> & items() const { return lItems; }
+
+private:
+    void addFile(const QString & path);
+    bool addListFile(const QString & path);
+    bool addCollection(const QString & path);
+
+    QList<Item> lItems;
+    QList<CollectionFile*> collections;
+};
+
+#endif // POSITIONSOURCE_H
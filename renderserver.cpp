@@ -0,0 +1,267 @@
+#include "renderserver.h"
+
+#include <QtCore>
+#include <QtNetwork>
+#include <QPainter>
+#include <QImage>
+#include <algorithm>
+#include <climits>
+
+#include "position.h"
+
+enum { LatencySamples = 100000, MaxSize = 4096, MaxRequestBytes = 64 * 1024 };
+
+RenderServer::RenderServer(QObject *parent) :
+    QObject(parent)
+{
+    localServer = 0;
+    tcpServer = 0;
+    nRequests = 0;
+    nHits = 0;
+    nNextLatency = 0;
+    nReportedRequests = 0;
+    cache.setMaxCost( 64 * 1024 * 1024 );
+
+    // on-screen style rendering, kept for the life of the server so its piece pixmaps stay cached
+    pngBoard = new ChessBoard(this);
+
+    QTimer *timer = new QTimer(this);
+    connect(timer,SIGNAL(timeout()),this,SLOT(reportStatistics()));
+    timer->start(60 * 1000);
+}
+
+void RenderServer::setCacheSize(int megabytes)
+{
+    qint64 bytes = qMax(0, megabytes) * Q_INT64_C(1048576);
+    cache.setMaxCost( (int)qMin<qint64>( bytes, INT_MAX ) );
+}
+
+bool RenderServer::listen(const QString & address)
+{
+    bool isPort;
+    quint16 port = address.toUShort(&isPort);
+    if( isPort )
+    {
+        tcpServer = new QTcpServer(this);
+        connect(tcpServer,SIGNAL(newConnection()),this,SLOT(acceptConnection()));
+        if( !tcpServer->listen(QHostAddress::LocalHost, port) )
+        {
+            qDebug() << "Could not listen on port" << port << tcpServer->errorString();
+            return false;
+        }
+    }
+    else
+    {
+        localServer = new QLocalServer(this);
+        connect(localServer,SIGNAL(newConnection()),this,SLOT(acceptConnection()));
+        // a socket left behind by a server that did not exit cleanly
+        QLocalServer::removeServer(address);
+        if( !localServer->listen(address) )
+        {
+            qDebug() << "Could not listen on" << address << localServer->errorString();
+            return false;
+        }
+    }
+    return true;
+}
+
+void RenderServer::acceptConnection()
+{
+    forever
+    {
+        QIODevice *socket = 0;
+        if( localServer != 0 && localServer->hasPendingConnections() )
+            socket = localServer->nextPendingConnection();
+        else if( tcpServer != 0 && tcpServer->hasPendingConnections() )
+            socket = tcpServer->nextPendingConnection();
+        if( socket == 0 )
+            return;
+
+        connect(socket,SIGNAL(readyRead()),this,SLOT(readRequests()));
+        connect(socket,SIGNAL(disconnected()),socket,SLOT(deleteLater()));
+    }
+}
+
+void RenderServer::readRequests()
+{
+    QIODevice *socket = qobject_cast<QIODevice*>( sender() );
+    if( socket == 0 )
+        return;
+    while( socket->canReadLine() )
+    {
+        QByteArray line = socket->readLine().trimmed();
+        if( !line.isEmpty() )
+            answer(socket, line);
+    }
+
+    // a request is a short line; don't buffer without end for a client that never sends a newline
+    if( socket->bytesAvailable() > MaxRequestBytes )
+    {
+        socket->write( "ERROR Request longer than " + QByteArray::number(MaxRequestBytes) + " bytes\n" );
+        socket->close();
+    }
+}
+
+void RenderServer::answer(QIODevice *socket, const QByteArray & request)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray body, contentType;
+    QString error;
+    if( render(request, body, contentType, error) )
+    {
+        socket->write( "OK " + QByteArray::number(body.size()) + " " + contentType + "\n" );
+        socket->write( body );
+    }
+    else
+    {
+        socket->write( "ERROR " + error.toUtf8() + "\n" );
+    }
+    recordLatency( timer.nsecsElapsed() );
+}
+
+bool RenderServer::render(const QByteArray & request, QByteArray & body, QByteArray & contentType, QString & error)
+{
+    QJsonParseError parseError;
+    QJsonObject json = QJsonDocument::fromJson(request, &parseError).object();
+    if( parseError.error != QJsonParseError::NoError )
+    {
+        error = parseError.errorString();
+        return false;
+    }
+
+    if( json.value("stats").toBool() )
+    {
+        body = statistics();
+        contentType = "application/json";
+        return true;
+    }
+
+    nRequests++;
+
+    Position position;
+    if( !position.parse( json.value("position").toString() ) )
+    {
+        error = "No position, or not a .chs or FEN position";
+        return false;
+    }
+
+    BoardStyle style = mDefaultStyle;
+    if( json.contains("light-square") )
+        style.lightSquare = QColor( json.value("light-square").toString() );
+    if( json.contains("dark-square") )
+        style.darkSquare = QColor( json.value("dark-square").toString() );
+    if( json.contains("light-piece") )
+        style.lightPiece = QColor( json.value("light-piece").toString() );
+    if( json.contains("dark-piece") )
+        style.darkPiece = QColor( json.value("dark-piece").toString() );
+    if( json.contains("secular") )
+        style.version = json.value("secular").toBool() ? ChessBoard::Secular : ChessBoard::Traditional;
+    if( json.contains("pieces") )
+        style.pieceTheme = json.value("pieces").toString();
+    if( !style.lightSquare.isValid() || !style.darkSquare.isValid() || !style.lightPiece.isValid() || !style.darkPiece.isValid() )
+    {
+        error = "Not a color";
+        return false;
+    }
+
+    QString format = json.value("format").toString("svg").toLower();
+    if( format != "svg" && format != "png" )
+    {
+        error = "The format must be svg or png";
+        return false;
+    }
+    int size = json.value("size").toInt(360);
+    if( size < 8 || size > MaxSize )
+    {
+        error = QString("The size must be from 8 to %1").arg(MaxSize);
+        return false;
+    }
+    contentType = format == "png" ? "image/png" : "image/svg+xml";
+
+    // the cache key is everything that affects the output
+    QByteArray key( reinterpret_cast<const char*>( position.data() ), 32 );
+    QDataStream keyStream(&key, QIODevice::WriteOnly | QIODevice::Append);
+    keyStream << style.lightSquare.rgba() << style.darkSquare.rgba() << style.lightPiece.rgba() << style.darkPiece.rgba()
+              << (quint8)style.version << style.pieceTheme << (quint8)( format == "png" ) << (qint32)size;
+
+    QByteArray *cached = cache.object(key);
+    if( cached != 0 )
+    {
+        nHits++;
+        body = *cached;
+        return true;
+    }
+
+    if( format == "png" )
+    {
+        body = renderPng(position, style, size);
+    }
+    else
+    {
+        svgWriter.setSize( QSize(size, size) );
+        body = svgWriter.toSvg(position, style);
+    }
+    cache.insert( key, new QByteArray(body), body.size() );
+    return true;
+}
+
+QByteArray RenderServer::renderPng(const Position & position, const BoardStyle & style, int size)
+{
+    pngBoard->setStyle(style);
+    pngBoard->setPosition(position);
+
+    QRectF board( 0, 0, 8 * pngBoard->squareSize(), 8 * pngBoard->squareSize() );
+    pngBoard->setPixelScale( size / board.width(), 1.0 );
+
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    pngBoard->render( &painter, QRectF(0, 0, size, size), board );
+    painter.end();
+
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return png;
+}
+
+void RenderServer::recordLatency(qint64 nanoseconds)
+{
+    if( latencies.count() < LatencySamples )
+        latencies << nanoseconds;
+    else
+        latencies[nNextLatency] = nanoseconds;
+    nNextLatency = ( nNextLatency + 1 ) % LatencySamples;
+}
+
+QByteArray RenderServer::statistics() const
+{
+    QVector<qint64> sorted = latencies;
+    std::sort( sorted.begin(), sorted.end() );
+
+    QJsonObject json;
+    json.insert( "requests", (double)nRequests );
+    json.insert( "cache-hits", (double)nHits );
+    json.insert( "hit-rate", nRequests > 0 ? (double)nHits / nRequests : 0.0 );
+    json.insert( "cached-bytes", cache.totalCost() );
+    if( !sorted.isEmpty() )
+    {
+        json.insert( "p50-ms", sorted.at( sorted.count() / 2 ) / 1e6 );
+        json.insert( "p99-ms", sorted.at( qMin( sorted.count() - 1, sorted.count() * 99 / 100 ) ) / 1e6 );
+        json.insert( "max-ms", sorted.last() / 1e6 );
+    }
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+void RenderServer::reportStatistics()
+{
+    if( nRequests == nReportedRequests )
+        return;
+    nReportedRequests = nRequests;
+    QTextStream out(stdout);
+    out << statistics() << Qt::endl;
+}
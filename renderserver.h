@@ -0,0 +1,81 @@
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <QObject>
+#include <QCache>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include "chessboard.h"
+#include "svgboardwriter.h"
+
+class QLocalServer;
+class QTcpServer;
+class QIODevice;
+class QTextStream;
+
+// Serves diagrams to other programs over a local socket, or a TCP port on
+// localhost, so that they do not pay for starting the application and
+// loading the pieces on every request. Each request is one line of JSON:
+//
+//   {"position": "<FEN or .chs>", "format": "svg" or "png", "size": 360,
+//    "light-square": "#ffffff", "dark-square": "#a0a0a0",
+//    "light-piece": "#000000", "dark-piece": "#000000", "secular": false,
+//    "pieces": "<piece set>"}
+//
+// Everything but the position is optional and defaults to the server's
+// style. The reply is a line "OK <bytes> <content type>" followed by that
+// many bytes, or a line "ERROR <message>". A connection that sends more than
+// 64 KB without a newline is closed. The request {"stats": true} is
+// answered with the latency percentiles and cache hit rate as JSON.
+//
+// Finished diagrams are kept in a least-recently-used cache keyed by the
+// position and everything in the request that affects the output.
+class RenderServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderServer(QObject *parent = 0);
+
+    void setDefaultStyle(const BoardStyle & style) { mDefaultStyle = style; }
+    // at most 2 GB, the most a QCache can count
+    void setCacheSize(int megabytes);
+
+    // a number listens on that port of localhost; anything else is a local socket name
+    bool listen(const QString & address);
+
+    QByteArray statistics() const;
+
+signals:
+
+public slots:
+
+private slots:
+    void acceptConnection();
+    void readRequests();
+    void reportStatistics();
+
+private:
+    void answer(QIODevice *socket, const QByteArray & request);
+    bool render(const QByteArray & request, QByteArray & body, QByteArray & contentType, QString & error);
+    QByteArray renderPng(const Position & position, const BoardStyle & style, int size);
+    void recordLatency(qint64 nanoseconds);
+
+    QLocalServer *localServer;
+    QTcpServer *tcpServer;
+
+    BoardStyle mDefaultStyle;
+    SvgBoardWriter svgWriter;
+    ChessBoard *pngBoard;
+
+    QCache<QByteArray, QByteArray> cache;
+    quint64 nRequests;
+    quint64 nHits;
+
+    // the most recent latencies, in nanoseconds, as a ring
+    QVector<qint64> latencies;
+    int nNextLatency;
+    quint64 nReportedRequests;
+};
+
+#endif // RENDERSERVER_H
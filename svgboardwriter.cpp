@@ -0,0 +1,255 @@
+#include "svgboardwriter.h"
+
+#include <QtCore>
+#include "piecetheme.h"
+
+static QMutex artworkMutex;
+static QHash<QString,QByteArray> artworkCache;
+
+SvgBoardWriter::SvgBoardWriter()
+{
+    sSize = QSize(200, 200);
+}
+
+QByteArray SvgBoardWriter::toSvg(const ChessBoard *board) const
+{
+    return toSvg( board->position(), board->style(), board->squareSize(), board->annotations() );
+}
+
+QByteArray SvgBoardWriter::toSvg(const Position & position, const BoardStyle & style, int squareSize, const Annotations & annotations) const
+{
+    const int w = squareSize;
+    const QByteArray boardSize = QByteArray::number(8 * w);
+    const QByteArray squareEdge = QByteArray::number(w);
+
+    QByteArray defs;
+    QByteArray uses;
+    bool defined[2][6] = { { false, false, false, false, false, false }, { false, false, false, false, false, false } };
+
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            Piece p = position.at(i,j);
+            if( p.type() == Piece::None )
+                continue;
+
+            QByteArray id = pieceId(p);
+            if( !defined[p.color()][p.type()] )
+            {
+                defined[p.color()][p.type()] = true;
+                QColor tint = p.color() == Piece::White ? style.lightPiece : style.darkPiece;
+                defs += pieceDefinition(p, style.version, style.pieceTheme, tint, id, w);
+            }
+            uses += "<use xlink:href=\"#" + id + "\" x=\"" + QByteArray::number(j * w) + "\" y=\"" + QByteArray::number(i * w) + "\"/>\n";
+        }
+    }
+
+    QByteArray darkSquares;
+    for(int i=0; i<8; i++)
+        for(int j=0; j<8; j++)
+            if( i % 2 != j % 2 )
+                darkSquares += "M" + QByteArray::number(j * w) + " " + QByteArray::number(i * w) + "h" + squareEdge + "v" + squareEdge + "h-" + squareEdge + "z";
+
+    QByteArray svg;
+    svg.reserve( defs.size() + uses.size() + darkSquares.size() + 512 );
+    svg += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    svg += "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\""
+           " width=\"" + QByteArray::number(sSize.width()) + "\" height=\"" + QByteArray::number(sSize.height()) + "\""
+           " viewBox=\"0 0 " + boardSize + " " + boardSize + "\">\n";
+    if( !defs.isEmpty() )
+        svg += "<defs>\n" + defs + "</defs>\n";
+    svg += "<rect width=\"" + boardSize + "\" height=\"" + boardSize + "\" fill=\"" + style.lightSquare.name().toLatin1() + "\"/>\n";
+    svg += "<path fill=\"" + style.darkSquare.name().toLatin1() + "\" d=\"" + darkSquares + "\"/>\n";
+    svg += uses;
+    svg += annotations.toSvg(w);
+    svg += "</svg>\n";
+    return svg;
+}
+
+bool SvgBoardWriter::write(const ChessBoard *board, QIODevice *device) const
+{
+    if( device == 0 || !device->isWritable() )
+        return false;
+    QByteArray svg = toSvg(board);
+    return device->write(svg) == svg.size();
+}
+
+bool SvgBoardWriter::write(const Position & position, const BoardStyle & style, QIODevice *device) const
+{
+    if( device == 0 || !device->isWritable() )
+        return false;
+    QByteArray svg = toSvg(position, style);
+    return device->write(svg) == svg.size();
+}
+
+QByteArray SvgBoardWriter::pieceId(Piece p)
+{
+    static const char types[] = "kqbnrp";
+    QByteArray id;
+    id += p.color() == Piece::White ? 'w' : 'b';
+    id += types[p.type()];
+    return id;
+}
+
+QByteArray SvgBoardWriter::pieceDefinition(Piece p, ChessBoard::Version v, const QString & theme, QColor tint, const QByteArray & id, int size)
+{
+    // the SVG itself rather than the theme's pictures, so that the export stays vector artwork
+    QString filename = PieceTheme::theme(theme)->filename(p, v);
+    QString key = filename + tint.name() + id + QString::number(size);
+
+    QMutexLocker locker(&artworkMutex);
+    QHash<QString,QByteArray>::const_iterator it = artworkCache.constFind(key);
+    if( it != artworkCache.constEnd() )
+        return it.value();
+
+    QRectF viewBox;
+    QByteArray artwork = readPieceArtwork(filename, tint, id + "-", &viewBox);
+
+    // fit the artwork's viewBox into the square, centred, as a viewer would
+    QByteArray transform;
+    if( viewBox.isValid() && viewBox != QRectF(0, 0, size, size) )
+    {
+        double scale = qMin( size / viewBox.width(), size / viewBox.height() );
+        double dx = ( size - viewBox.width() * scale ) / 2 - viewBox.x() * scale;
+        double dy = ( size - viewBox.height() * scale ) / 2 - viewBox.y() * scale;
+        transform = " transform=\"matrix(" + QByteArray::number(scale, 'g', 6) + " 0 0 " + QByteArray::number(scale, 'g', 6)
+                + " " + QByteArray::number(dx, 'g', 6) + " " + QByteArray::number(dy, 'g', 6) + ")\"";
+    }
+
+    QByteArray definition = "<g id=\"" + id + "\"" + transform + ">" + artwork + "</g>\n";
+    artworkCache.insert(key, definition);
+    return definition;
+}
+
+// the leading number of a length such as "45", "45px" or "12.5mm"
+static double svgLength(const QString & length)
+{
+    QRegularExpressionMatch match = QRegularExpression("^\\s*([0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?)").match(length);
+    return match.hasMatch() ? match.captured(1).toDouble() : 0;
+}
+
+QByteArray SvgBoardWriter::readPieceArtwork(const QString & filename, QColor tint, const QByteArray & idPrefix, QRectF *viewBox)
+{
+    // copy the drawing elements of the file, leaving out editor metadata and
+    // foreign namespaces; ids, and the references to them, get the piece's
+    // prefix so that they cannot clash with another piece's
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly))
+    {
+        qDebug() << "Could not open:" << filename;
+        return QByteArray();
+    }
+
+    const QString svgNamespace = "http://www.w3.org/2000/svg";
+    const QString xlinkNamespace = "http://www.w3.org/1999/xlink";
+    const bool recolor = tint != Qt::black;
+    const QString prefix = QString::fromUtf8(idPrefix);
+    const QRegularExpression reference("url\\(\\s*#([^)\\s]+)\\s*\\)");
+
+    // a file without a viewBox or a size is taken to be drawn in one 45-unit square
+    *viewBox = QRectF(0, 0, 45, 45);
+
+    QByteArray artwork;
+    QXmlStreamWriter writer(&artwork);
+    QXmlStreamReader reader(&file);
+    int depth = 0;
+    while( !reader.atEnd() )
+    {
+        reader.readNext();
+        if( reader.isStartElement() )
+        {
+            depth++;
+            if( depth == 1 )
+            {
+                // the root <svg> element gives the artwork's coordinates
+                QXmlStreamAttributes root = reader.attributes();
+                QStringList box = root.value("viewBox").toString().split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+                double width = svgLength( root.value("width").toString() );
+                double height = svgLength( root.value("height").toString() );
+                if( box.count() == 4 )
+                    *viewBox = QRectF( box.at(0).toDouble(), box.at(1).toDouble(), box.at(2).toDouble(), box.at(3).toDouble() );
+                else if( width > 0 && height > 0 )
+                    *viewBox = QRectF(0, 0, width, height);
+                continue;
+            }
+            if( reader.namespaceUri() != svgNamespace || reader.name() == "metadata" || reader.name() == "title" || reader.name() == "desc" )
+            {
+                reader.skipCurrentElement();
+                depth--;
+                continue;
+            }
+
+            writer.writeStartElement( reader.name().toString() );
+            foreach(QXmlStreamAttribute attribute, reader.attributes())
+            {
+                QString value = attribute.value().toString();
+                if( attribute.namespaceUri() == xlinkNamespace && attribute.name() == "href" )
+                {
+                    if( value.startsWith('#') )
+                        value.insert(1, prefix);
+                    writer.writeAttribute( "xlink:href", value );
+                    continue;
+                }
+                if( !attribute.namespaceUri().isEmpty() )
+                    continue;
+
+                if( attribute.name() == "id" )
+                    value.prepend(prefix);
+                else if( attribute.name() == "href" && value.startsWith('#') )
+                    value.insert(1, prefix);
+                else
+                    value.replace( reference, "url(#" + prefix + "\\1)" );
+
+                if( recolor )
+                {
+                    if( attribute.name() == "style" )
+                        value = tintStyle(value, tint);
+                    else if( ( attribute.name() == "fill" || attribute.name() == "stroke" || attribute.name() == "stop-color" ) && QColor::isValidColor(value) )
+                        value = tinted(QColor(value), tint).name();
+                }
+                writer.writeAttribute( attribute.name().toString(), value );
+            }
+        }
+        else if( reader.isEndElement() )
+        {
+            if( depth > 1 )
+                writer.writeEndElement();
+            depth--;
+        }
+        else if( reader.isCharacters() && !reader.isWhitespace() && depth > 1 )
+        {
+            writer.writeCharacters( reader.text().toString() );
+        }
+    }
+
+    if( reader.hasError() )
+        qDebug() << "Could not parse:" << filename << reader.errorString();
+
+    return artwork;
+}
+
+QString SvgBoardWriter::tintStyle(const QString & style, QColor tint)
+{
+    QStringList declarations = style.split(';', Qt::SkipEmptyParts);
+    for(int i=0; i<declarations.count(); i++)
+    {
+        int colon = declarations.at(i).indexOf(':');
+        if( colon < 0 )
+            continue;
+        QString property = declarations.at(i).left(colon).trimmed();
+        QString value = declarations.at(i).mid(colon+1).trimmed();
+        if( ( property == "fill" || property == "stroke" || property == "stop-color" ) && QColor::isValidColor(value) )
+            declarations[i] = property + ":" + tinted(QColor(value), tint).name();
+    }
+    return declarations.join(';');
+}
+
+QColor SvgBoardWriter::tinted(QColor artwork, QColor tint)
+{
+    // grayscale, then screen blend with the tint
+    int g = qGray( artwork.rgb() );
+    return QColor( 255 - (255 - g) * (255 - tint.red()) / 255,
+                   255 - (255 - g) * (255 - tint.green()) / 255,
+                   255 - (255 - g) * (255 - tint.blue()) / 255 );
+}
@@ -0,0 +1,50 @@
+#ifndef SVGBOARDWRITER_H
+#define SVGBOARDWRITER_H
+
+#include <QSize>
+#include <QColor>
+#include <QHash>
+#include <QRectF>
+
+#include "chessboard.h"
+#include "position.h"
+
+class QIODevice;
+
+// Writes a board as SVG directly, rather than replaying the scene through
+// QSvgGenerator: each piece used is defined once in <defs> and placed with
+// <use>, and the dark squares are a single path. Piece colours are applied
+// to the artwork's fills and strokes with the same tint the screen uses.
+class SvgBoardWriter
+{
+public:
+    SvgBoardWriter();
+
+    void setSize(const QSize & size) { sSize = size; }
+    QSize size() const { return sSize; }
+
+    QByteArray toSvg(const ChessBoard *board) const;
+    // the annotations, if any, are drawn over the pieces
+    QByteArray toSvg(const Position & position, const BoardStyle & style, int squareSize = 45, const Annotations & annotations = Annotations()) const;
+    bool write(const ChessBoard *board, QIODevice *device) const;
+    bool write(const Position & position, const BoardStyle & style, QIODevice *device) const;
+
+    // "wk", "bq", etc.
+    static QByteArray pieceId(Piece p);
+
+    // the <g> element for one piece of the theme, tinted, with the given id,
+    // scaled from the artwork's viewBox to fill a square of the given size;
+    // the artwork's own ids are prefixed with the piece's
+    static QByteArray pieceDefinition(Piece p, ChessBoard::Version v, const QString & theme, QColor tint, const QByteArray & id, int size = 45);
+
+    // what QGraphicsColorizeEffect does to a single colour
+    static QColor tinted(QColor artwork, QColor tint);
+
+private:
+    static QByteArray readPieceArtwork(const QString & filename, QColor tint, const QByteArray & idPrefix, QRectF *viewBox);
+    static QString tintStyle(const QString & style, QColor tint);
+
+    QSize sSize;
+};
+
+#endif // SVGBOARDWRITER_H
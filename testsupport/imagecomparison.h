@@ -0,0 +1,45 @@
+#ifndef IMAGECOMPARISON_H
+#define IMAGECOMPARISON_H
+
+#include <QtTest>
+#include <QImage>
+
+// Shared by the tests that compare what is drawn with a reference image.
+
+// the piece set's cache file goes to a test location; call from initTestCase()
+inline void useTestLocations()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+// antialiasing, and a GIF's palette, move pixels a little, so edges may be
+// off; the mean difference and the share of pixels that are clearly
+// different (by more than threshold in some channel) must both be small
+inline void compareImages(const QImage & actual, const QImage & expected, double meanLimit, int threshold)
+{
+    QCOMPARE( actual.size(), expected.size() );
+    QImage a = actual.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage e = expected.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    qint64 total = 0;
+    int different = 0;
+    for(int y=0; y<a.height(); y++)
+    {
+        const QRgb *la = reinterpret_cast<const QRgb*>( a.constScanLine(y) );
+        const QRgb *le = reinterpret_cast<const QRgb*>( e.constScanLine(y) );
+        for(int x=0; x<a.width(); x++)
+        {
+            int d = qMax( qMax( qAbs( qRed(la[x]) - qRed(le[x]) ), qAbs( qGreen(la[x]) - qGreen(le[x]) ) ),
+                          qMax( qAbs( qBlue(la[x]) - qBlue(le[x]) ), qAbs( qAlpha(la[x]) - qAlpha(le[x]) ) ) );
+            total += d;
+            if( d > threshold )
+                different++;
+        }
+    }
+    int pixels = a.width() * a.height();
+    double mean = (double)total / pixels;
+    QVERIFY2( mean < meanLimit, qPrintable( QString("mean difference %1").arg(mean) ) );
+    QVERIFY2( different <= pixels / 50, qPrintable( QString("%1 of %2 pixels differ").arg(different).arg(pixels) ) );
+}
+
+#endif // IMAGECOMPARISON_H
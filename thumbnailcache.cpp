@@ -0,0 +1,303 @@
+#include "thumbnailcache.h"
+
+#include <QtCore>
+#include <algorithm>
+#include <climits>
+#include <QPainter>
+#include "piecerenderercache.h"
+#include "piecepixmapcache.h"
+#include "instrumentation.h"
+
+// tinted piece images at one square size, kept by each thread that draws thumbnails
+struct ThumbnailPieces
+{
+    ThumbnailPieces() : size(0) { }
+
+    BoardStyle style;
+    int size;
+    QImage images[2][6];
+};
+
+static QThreadStorage<ThumbnailPieces*> thumbnailPieces;
+
+class ThumbnailWorker : public QRunnable
+{
+public:
+    ThumbnailWorker(ThumbnailCache *cache, const Position & position, quint64 key, int generation, const BoardStyle & style, int size, const QString & directory)
+        : cache(cache), position(position), key(key), generation(generation), style(style), size(size), directory(directory) { }
+
+    void run();
+
+private:
+    ThumbnailCache *cache;
+    Position position;
+    quint64 key;
+    int generation;
+    BoardStyle style;
+    int size;
+    QString directory;
+};
+
+void ThumbnailWorker::run()
+{
+    QImage image;
+    qint64 written = 0;
+    QString filename;
+    if( !directory.isEmpty() )
+        filename = QString("%1/%2.png").arg(directory).arg(key, 16, 16, QChar('0'));
+
+    if( filename.isEmpty() || !image.load(filename, "PNG") )
+    {
+        image = ThumbnailCache::render(position, style, size / 8);
+        if( !filename.isEmpty() )
+        {
+            QFile file(filename);
+            if( file.open(QFile::WriteOnly) && image.save(&file, "PNG") )
+                written = file.size();
+            else
+                qDebug() << "Could not open:" << filename;
+        }
+    }
+
+    QMetaObject::invokeMethod(cache, "finished", Qt::QueuedConnection, Q_ARG(quint64, key), Q_ARG(int, generation), Q_ARG(QImage, image), Q_ARG(qint64, written));
+}
+
+static bool olderThan(const QFileInfo & a, const QFileInfo & b)
+{
+    return a.lastModified() < b.lastModified();
+}
+
+// measures the disk cache and, if it is over the limit, removes the oldest files
+class DiskTrimWorker : public QRunnable
+{
+public:
+    DiskTrimWorker(ThumbnailCache *cache, const QString & directory, qint64 limit)
+        : cache(cache), directory(directory), limit(limit) { }
+
+    void run();
+
+private:
+    ThumbnailCache *cache;
+    QString directory;
+    qint64 limit;
+};
+
+void DiskTrimWorker::run()
+{
+    QList<QFileInfo> files;
+    qint64 bytes = 0;
+    QDirIterator it(directory, QStringList() << "*.png", QDir::Files, QDirIterator::Subdirectories);
+    while( it.hasNext() )
+    {
+        it.next();
+        files << it.fileInfo();
+        bytes += it.fileInfo().size();
+    }
+
+    // the oldest go first, down to three quarters of the limit so that this is not done after every write
+    if( bytes > limit )
+    {
+        std::sort( files.begin(), files.end(), olderThan );
+        for(int i=0; i<files.count() && bytes > limit * 3 / 4; i++)
+        {
+            if( QFile::remove( files.at(i).absoluteFilePath() ) )
+                bytes -= files.at(i).size();
+        }
+    }
+
+    QMetaObject::invokeMethod(cache, "diskTrimmed", Qt::QueuedConnection, Q_ARG(QString, directory), Q_ARG(qint64, bytes));
+}
+
+ThumbnailCache::ThumbnailCache(QObject *parent) :
+    QObject(parent)
+{
+    nSize = 96;
+    nDiskLimit = 256 * 1024 * 1024;
+    nDiskBytes = -1;
+    bTrimming = false;
+    nWrittenWhileTrimming = 0;
+    nNextInQueue = 0;
+    nGeneration = 0;
+    setMemoryLimit(32);
+    pool.setMaxThreadCount( qMax(1, QThread::idealThreadCount() - 1) );
+    setDiskDirectory( QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails" );
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    queue.clear();
+    pool.waitForDone();
+}
+
+void ThumbnailCache::setMemoryLimit(int megabytes)
+{
+    qint64 bytes = qMax(0, megabytes) * Q_INT64_C(1048576);
+    pixmaps.setMaxCost( (int)qMin<qint64>( bytes, INT_MAX ) );
+}
+
+void ThumbnailCache::setStyle(const BoardStyle & style)
+{
+    if( style.lightSquare == mStyle.lightSquare && style.darkSquare == mStyle.darkSquare
+            && style.lightPiece == mStyle.lightPiece && style.darkPiece == mStyle.darkPiece
+            && style.version == mStyle.version && style.pieceTheme == mStyle.pieceTheme )
+        return;
+    mStyle = style;
+    startAfresh();
+}
+
+void ThumbnailCache::setSize(int pixels)
+{
+    pixels = qMax(8, pixels / 8 * 8);
+    if( pixels == nSize )
+        return;
+    nSize = pixels;
+    startAfresh();
+}
+
+void ThumbnailCache::setDiskDirectory(const QString & path)
+{
+    sDiskDirectory = path;
+    nDiskBytes = -1;
+    startAfresh();
+}
+
+void ThumbnailCache::startAfresh()
+{
+    pixmaps.clear();
+    queue.clear();
+    nNextInQueue = 0;
+    inFlight.clear();
+    nGeneration++;
+
+    if( sDiskDirectory.isEmpty() )
+    {
+        sStyleDirectory.clear();
+        return;
+    }
+    sStyleDirectory = QString("%1/%2-%3-%4-%5-%6-%7-%8").arg(sDiskDirectory).arg(nSize)
+            .arg(mStyle.lightSquare.rgb() & 0xFFFFFF, 6, 16, QChar('0')).arg(mStyle.darkSquare.rgb() & 0xFFFFFF, 6, 16, QChar('0'))
+            .arg(mStyle.lightPiece.rgb() & 0xFFFFFF, 6, 16, QChar('0')).arg(mStyle.darkPiece.rgb() & 0xFFFFFF, 6, 16, QChar('0'))
+            .arg(mStyle.version).arg( qHash(mStyle.pieceTheme), 8, 16, QChar('0') );
+    if( !QDir().mkpath(sStyleDirectory) )
+    {
+        qDebug() << "Could not open:" << sStyleDirectory;
+        sStyleDirectory.clear();
+    }
+}
+
+QPixmap ThumbnailCache::thumbnail(quint64 key) const
+{
+    QPixmap *p = pixmaps.object(key);
+    return p == 0 ? QPixmap() : *p;
+}
+
+void ThumbnailCache::request(const QVector<Position> & positions)
+{
+    queue = positions;
+    nNextInQueue = 0;
+    startJobs();
+}
+
+void ThumbnailCache::startJobs()
+{
+    // only as many jobs as threads are started, so that a new request does
+    // not wait behind a backlog of positions that have scrolled out of view
+    while( inFlight.count() < pool.maxThreadCount() && nNextInQueue < queue.count() )
+    {
+        const Position & p = queue.at(nNextInQueue++);
+        quint64 k = key(p);
+        if( pixmaps.contains(k) || inFlight.contains(k) )
+            continue;
+        inFlight.insert(k);
+        pool.start( new ThumbnailWorker(this, p, k, nGeneration, mStyle, nSize, sStyleDirectory) );
+    }
+}
+
+void ThumbnailCache::finished(quint64 key, int generation, const QImage & image, qint64 bytesWritten)
+{
+    if( generation != nGeneration )
+        return;
+    inFlight.remove(key);
+    if( !image.isNull() )
+    {
+        pixmaps.insert( key, new QPixmap( QPixmap::fromImage(image) ), int( image.sizeInBytes() ) );
+        if( bytesWritten > 0 )
+        {
+            if( nDiskBytes >= 0 )
+                nDiskBytes += bytesWritten;
+            if( bTrimming )
+                nWrittenWhileTrimming += bytesWritten;
+            else if( nDiskBytes < 0 || nDiskBytes > nDiskLimit )
+                trimDisk();
+        }
+        emit ready(key);
+    }
+    startJobs();
+}
+
+// scanning and sorting the files takes a while, so it is done on the pool
+// behind the thumbnails, and never more than once at a time
+void ThumbnailCache::trimDisk()
+{
+    if( sDiskDirectory.isEmpty() )
+        return;
+    bTrimming = true;
+    nWrittenWhileTrimming = 0;
+    pool.start( new DiskTrimWorker(this, sDiskDirectory, nDiskLimit), -1 );
+}
+
+void ThumbnailCache::diskTrimmed(const QString & directory, qint64 bytes)
+{
+    bTrimming = false;
+    if( directory != sDiskDirectory )
+        return;
+    nDiskBytes = bytes + nWrittenWhileTrimming;
+}
+
+QImage ThumbnailCache::render(const Position & position, const BoardStyle & style, int squareSize)
+{
+    ScopedTimer timer("thumbnail");
+
+    if( !thumbnailPieces.hasLocalData() )
+        thumbnailPieces.setLocalData( new ThumbnailPieces );
+    ThumbnailPieces *pieces = thumbnailPieces.localData();
+    if( pieces->size != squareSize || pieces->style.lightPiece != style.lightPiece
+            || pieces->style.darkPiece != style.darkPiece || pieces->style.version != style.version
+            || pieces->style.pieceTheme != style.pieceTheme )
+    {
+        pieces->size = squareSize;
+        pieces->style = style;
+        for(int c=0; c<2; c++)
+            for(int t=0; t<6; t++)
+                pieces->images[c][t] = QImage();
+    }
+
+    QImage image(squareSize * 8, squareSize * 8, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            QRect square( j * squareSize, i * squareSize, squareSize, squareSize );
+            painter.fillRect( square, i % 2 == j % 2 ? style.lightSquare : style.darkSquare );
+
+            Piece p = position.at(i,j);
+            if( p.type() == Piece::None )
+                continue;
+            QImage & piece = pieces->images[p.color()][p.type()];
+            if( piece.isNull() )
+            {
+                QImage artwork(squareSize, squareSize, QImage::Format_ARGB32_Premultiplied);
+                artwork.fill(Qt::transparent);
+                QPainter piecePainter(&artwork);
+                piecePainter.setRenderHint(QPainter::Antialiasing);
+                PieceRendererCache::instance()->render( &piecePainter, p, style.version, style.pieceTheme, QRectF(0, 0, squareSize, squareSize) );
+                piecePainter.end();
+                piece = PiecePixmapCache::colorize( artwork, p.color() == Piece::White ? style.lightPiece : style.darkPiece );
+            }
+            painter.drawImage( square.topLeft(), piece );
+        }
+    }
+    painter.end();
+    return image;
+}
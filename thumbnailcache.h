@@ -0,0 +1,83 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QPixmap>
+#include <QImage>
+#include <QThreadPool>
+#include <QVector>
+#include <QSet>
+
+#include "chessboard.h"
+#include "position.h"
+
+// Small pictures of positions, for browsing a collection. A thumbnail is
+// looked for in memory, then on disk, and only then drawn; drawing and
+// reading from disk are done on a pool of threads, and ready() is emitted
+// when a thumbnail arrives. Thumbnails are keyed by the position's Zobrist
+// key, so a position that occurs many times is drawn once. Both caches are
+// bounded: the memory one drops the least recently used pictures, the disk
+// one the oldest files. The disk is measured and trimmed on the pool too.
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailCache(QObject *parent = 0);
+    ~ThumbnailCache();
+
+    // changing either starts afresh, in memory and in a separate directory on disk
+    void setStyle(const BoardStyle & style);
+    void setSize(int pixels);
+    int size() const { return nSize; }
+
+    // at most 2 GB, the most a QCache can count
+    void setMemoryLimit(int megabytes);
+    void setDiskLimit(int megabytes) { nDiskLimit = (qint64)megabytes * 1024 * 1024; }
+    // the default is "thumbnails" in the application's cache directory; empty for no disk cache
+    void setDiskDirectory(const QString & path);
+
+    static quint64 key(const Position & position) { return position.key(); }
+
+    // the thumbnail if it is in memory, or a null pixmap
+    QPixmap thumbnail(quint64 key) const;
+
+    // replaces whatever was waiting to be drawn with these positions, in
+    // this order; thumbnails already being drawn are finished
+    void request(const QVector<Position> & positions);
+
+    // draws a board squareSize * 8 pixels wide, for any thread
+    static QImage render(const Position & position, const BoardStyle & style, int squareSize);
+
+signals:
+    void ready(quint64 key);
+
+private slots:
+    void finished(quint64 key, int generation, const QImage & image, qint64 bytesWritten);
+    void diskTrimmed(const QString & directory, qint64 bytes);
+
+private:
+    void startJobs();
+    void trimDisk();
+    void startAfresh();
+
+    BoardStyle mStyle;
+    int nSize;
+
+    QCache<quint64, QPixmap> pixmaps;
+
+    QString sDiskDirectory;
+    QString sStyleDirectory;
+    qint64 nDiskLimit;
+    qint64 nDiskBytes;     // -1 until the directory has been measured
+    bool bTrimming;
+    qint64 nWrittenWhileTrimming;
+
+    QThreadPool pool;
+    QVector<Position> queue;
+    int nNextInQueue;
+    QSet<quint64> inFlight;
+    int nGeneration;        // results from before a style or size change are dropped
+};
+
+#endif // THUMBNAILCACHE_H
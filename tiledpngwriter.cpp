@@ -0,0 +1,269 @@
+#include "tiledpngwriter.h"
+
+#include <QtCore>
+#include <QtEndian>
+#include <QImage>
+#include <QPainter>
+#include <QSvgRenderer>
+#include <zlib.h>
+
+#include "svgboardwriter.h"
+#include "instrumentation.h"
+
+// bands are about this many bytes of image
+enum { BandBytes = 4 << 20 };
+
+struct PngBand
+{
+    QByteArray data;    // raw deflate, ending on a byte boundary
+    uLong adler;        // of the uncompressed band
+    qint64 length;      // uncompressed
+};
+
+struct PngJob
+{
+    QByteArray svg;
+    QSize size;
+    QRectF boardRect;
+    QColor background;
+    int bandHeight;
+    int bandCount;
+
+    QAtomicInt next;
+    QSemaphore freeSlots;   // bands that may be in memory at once
+    QMutex mutex;
+    QWaitCondition bandReady;
+    QMap<int,PngBand> finished;
+
+    QAtomicInteger<qint64> liveBytes;
+    QAtomicInteger<qint64> peakBytes;
+
+    void allocated(qint64 n)
+    {
+        qint64 now = liveBytes.fetchAndAddRelaxed(n) + n;
+        qint64 peak = peakBytes.load();
+        while( now > peak && !peakBytes.testAndSetRelaxed(peak, now) )
+            peak = peakBytes.load();
+    }
+    void freed(qint64 n) { liveBytes.fetchAndAddRelaxed(-n); }
+};
+
+static QByteArray deflateBand(const QByteArray & raw, bool last)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+    QByteArray out( deflateBound(&stream, raw.size()) + 64, Qt::Uninitialized );
+    stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( raw.constData() ) );
+    stream.avail_in = raw.size();
+    forever
+    {
+        stream.next_out = reinterpret_cast<Bytef*>( out.data() ) + stream.total_out;
+        stream.avail_out = out.size() - stream.total_out;
+        deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        if( stream.avail_out != 0 )
+            break;
+        out.resize( out.size() * 2 );
+    }
+    out.resize( stream.total_out );
+    deflateEnd(&stream);
+    return out;
+}
+
+class PngBandWorker : public QRunnable
+{
+public:
+    explicit PngBandWorker(PngJob *job) : job(job) { }
+
+    void run();
+
+private:
+    PngJob *job;
+};
+
+void PngBandWorker::run()
+{
+    QSvgRenderer renderer(job->svg);
+    const int width = job->size.width();
+
+    forever
+    {
+        job->freeSlots.acquire();
+        int i = job->next.fetchAndAddRelaxed(1);
+        if( i >= job->bandCount )
+        {
+            job->freeSlots.release();
+            return;
+        }
+        int top = i * job->bandHeight;
+        int rows = qMin( job->bandHeight, job->size.height() - top );
+
+        ScopedTimer timer("png band");
+        QImage image(width, rows, QImage::Format_RGB32);
+        qint64 imageBytes = (qint64)image.bytesPerLine() * rows;
+        job->allocated(imageBytes);
+        image.fill(job->background);
+        {
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.translate(0, -top);
+            renderer.render(&painter, job->boardRect);
+        }
+
+        // 8-bit RGB rows, each with filter type 1: every byte less the one a pixel to its left
+        QByteArray raw( rows * ( 1 + 3 * width ), Qt::Uninitialized );
+        job->allocated( raw.size() );
+        uchar *out = reinterpret_cast<uchar*>( raw.data() );
+        for(int y=0; y<rows; y++)
+        {
+            const QRgb *line = reinterpret_cast<const QRgb*>( image.constScanLine(y) );
+            *out++ = 1;
+            int r = 0, g = 0, b = 0;
+            for(int x=0; x<width; x++)
+            {
+                *out++ = qRed(line[x]) - r;
+                *out++ = qGreen(line[x]) - g;
+                *out++ = qBlue(line[x]) - b;
+                r = qRed(line[x]);
+                g = qGreen(line[x]);
+                b = qBlue(line[x]);
+            }
+        }
+        image = QImage();
+        job->freed(imageBytes);
+
+        PngBand band;
+        band.adler = adler32( adler32(0, 0, 0), reinterpret_cast<const Bytef*>( raw.constData() ), raw.size() );
+        band.length = raw.size();
+        band.data = deflateBand( raw, i == job->bandCount - 1 );
+        job->allocated( band.data.size() );
+        job->freed( raw.size() );
+
+        QMutexLocker locker(&job->mutex);
+        job->finished.insert(i, band);
+        job->bandReady.wakeAll();
+    }
+}
+
+bool TiledPngWriter::writeChunk(QIODevice *device, const char *type, const QByteArray & data)
+{
+    uchar length[4];
+    qToBigEndian<quint32>( data.size(), length );
+    uLong crc = crc32( 0, reinterpret_cast<const Bytef*>(type), 4 );
+    crc = crc32( crc, reinterpret_cast<const Bytef*>( data.constData() ), data.size() );
+    uchar check[4];
+    qToBigEndian<quint32>( crc, check );
+
+    return device->write( reinterpret_cast<const char*>(length), 4 ) == 4
+            && device->write( type, 4 ) == 4
+            && device->write( data ) == data.size()
+            && device->write( reinterpret_cast<const char*>(check), 4 ) == 4;
+}
+
+TiledPngWriter::TiledPngWriter()
+{
+    sSize = QSize(2400, 2400);
+    nDpi = 600;
+    nThreads = QThread::idealThreadCount();
+    nMilliseconds = 0;
+    nPeakBytes = 0;
+}
+
+double TiledPngWriter::millisecondsPerMegapixel() const
+{
+    double megapixels = (double)sSize.width() * sSize.height() / 1e6;
+    return megapixels > 0 ? nMilliseconds / megapixels : 0.0;
+}
+
+bool TiledPngWriter::write(const ChessBoard *board, QIODevice *device)
+{
+    return write( board->position(), board->style(), device, board->annotations() );
+}
+
+bool TiledPngWriter::write(const Position & position, const BoardStyle & style, QIODevice *device, const Annotations & annotations)
+{
+    if( device == 0 || !device->isWritable() || sSize.isEmpty() )
+        return false;
+    ScopedTimer scopedTimer("png export");
+    Instrumentation::count(Instrumentation::Exports);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const int width = sSize.width(), height = sSize.height();
+    const int side = qMin(width, height);
+
+    PngJob job;
+    SvgBoardWriter svgWriter;
+    svgWriter.setSize( QSize(side, side) );
+    job.svg = svgWriter.toSvg(position, style, 45, annotations);
+    job.size = sSize;
+    job.boardRect = QRectF( ( width - side ) / 2.0, ( height - side ) / 2.0, side, side );
+    job.background = style.lightSquare;
+    job.bandHeight = qBound( 1, BandBytes / ( 4 * width ), height );
+    job.bandCount = ( height + job.bandHeight - 1 ) / job.bandHeight;
+    job.next = 0;
+    job.liveBytes = 0;
+    job.peakBytes = 0;
+
+    int threads = qMax(1, nThreads);
+    job.freeSlots.release( threads * 2 );
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for(int i=0; i<threads; i++)
+        pool.start( new PngBandWorker(&job) );
+
+    static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    bool ok = device->write(signature, 8) == 8;
+
+    QByteArray header(13, 0);
+    qToBigEndian<quint32>( width, reinterpret_cast<uchar*>( header.data() ) );
+    qToBigEndian<quint32>( height, reinterpret_cast<uchar*>( header.data() ) + 4 );
+    header[8] = 8;  // bits per channel
+    header[9] = 2;  // RGB
+    ok = ok && writeChunk(device, "IHDR", header);
+
+    QByteArray physical(9, 0);
+    quint32 pixelsPerMetre = qRound( nDpi / 0.0254 );
+    qToBigEndian<quint32>( pixelsPerMetre, reinterpret_cast<uchar*>( physical.data() ) );
+    qToBigEndian<quint32>( pixelsPerMetre, reinterpret_cast<uchar*>( physical.data() ) + 4 );
+    physical[8] = 1;    // metres
+    ok = ok && writeChunk(device, "pHYs", physical);
+
+    // one IDAT per band: the zlib header, the bands in order, then the Adler-32 of them all
+    uLong adler = adler32(0, 0, 0);
+    for(int i=0; i<job.bandCount; i++)
+    {
+        PngBand band;
+        {
+            QMutexLocker locker(&job.mutex);
+            while( !job.finished.contains(i) )
+                job.bandReady.wait(&job.mutex);
+            band = job.finished.take(i);
+        }
+        adler = adler32_combine( adler, band.adler, band.length );
+
+        QByteArray data;
+        if( i == 0 )
+            data += "\x78\x9c";
+        data += band.data;
+        if( i == job.bandCount - 1 )
+        {
+            uchar check[4];
+            qToBigEndian<quint32>( adler, check );
+            data.append( reinterpret_cast<const char*>(check), 4 );
+        }
+        ok = ok && writeChunk(device, "IDAT", data);
+
+        job.freed( band.data.size() );
+        job.freeSlots.release();
+    }
+    pool.waitForDone();
+
+    ok = ok && writeChunk(device, "IEND", QByteArray());
+
+    nMilliseconds = timer.elapsed();
+    nPeakBytes = job.peakBytes.load();
+    return ok;
+}
@@ -0,0 +1,50 @@
+#ifndef TILEDPNGWRITER_H
+#define TILEDPNGWRITER_H
+
+#include <QSize>
+#include <QByteArray>
+
+#include "chessboard.h"
+#include "position.h"
+
+class QIODevice;
+
+// Writes a board as a PNG of any size without holding the whole image in
+// memory. The image is cut into bands of rows; worker threads each render
+// a band from the board's SVG and deflate it, and the bands are written to
+// the device in order as they finish. Each band is compressed on its own
+// and ends on a byte boundary, so the pieces join into one zlib stream, as
+// pigz does.
+class TiledPngWriter
+{
+public:
+    TiledPngWriter();
+
+    // the board is drawn as large as fits, centred; the rest is the light square colour
+    void setSize(const QSize & size) { sSize = size; }
+    QSize size() const { return sSize; }
+    // stored in the file so that the image prints at the intended size
+    void setDotsPerInch(int dpi) { nDpi = dpi; }
+    void setThreadCount(int n) { nThreads = n; }
+
+    bool write(const ChessBoard *board, QIODevice *device);
+    bool write(const Position & position, const BoardStyle & style, QIODevice *device, const Annotations & annotations = Annotations());
+
+    // figures for the last write()
+    qint64 milliseconds() const { return nMilliseconds; }
+    qint64 peakBytes() const { return nPeakBytes; }    // band images and buffers alive at once
+    double millisecondsPerMegapixel() const;
+
+    // a PNG chunk: the length, the type, the data and the CRC of type and data
+    static bool writeChunk(QIODevice *device, const char *type, const QByteArray & data);
+
+private:
+    QSize sSize;
+    int nDpi;
+    int nThreads;
+
+    qint64 nMilliseconds;
+    qint64 nPeakBytes;
+};
+
+#endif // TILEDPNGWRITER_H
@@ -0,0 +1,276 @@
+#include "uciengine.h"
+
+#include <QtCore>
+
+QString EngineEvaluation::scoreText() const
+{
+    if( mate )
+        return QString("#%1").arg(score);
+    return QString("%1%2").arg( score >= 0 ? "+" : "" ).arg( score / 100.0, 0, 'f', 2 );
+}
+
+UciEngine::UciEngine(QObject *parent) :
+    QObject(parent)
+{
+    qRegisterMetaType<EngineEvaluation>();
+
+    bReady = false;
+    bSearching = false;
+    bStopping = false;
+    bQuitting = false;
+    bHavePending = false;
+    ePendingSide = Piece::White;
+    eSideToMove = Piece::White;
+    nDepth = 20;
+    nMilliseconds = 0;
+
+    process = new QProcess(this);
+    connect(process,SIGNAL(readyReadStandardOutput()),this,SLOT(readOutput()));
+    connect(process,SIGNAL(errorOccurred(QProcess::ProcessError)),this,SLOT(processError(QProcess::ProcessError)));
+    connect(process,SIGNAL(finished(int,QProcess::ExitStatus)),this,SLOT(processFinished(int,QProcess::ExitStatus)));
+}
+
+UciEngine::~UciEngine()
+{
+    if( process->state() != QProcess::NotRunning )
+    {
+        bQuitting = true;
+        send("quit");
+        if( !process->waitForFinished(1000) )
+            process->kill();
+    }
+}
+
+void UciEngine::start(const QString & program, const QStringList & arguments)
+{
+    sName = program;
+    bQuitting = false;
+    process->start(program, arguments);
+    send("uci");
+}
+
+void UciEngine::setOption(const QString & name, const QString & value)
+{
+    QByteArray line = "setoption name " + name.toUtf8() + " value " + value.toUtf8();
+    if( bReady )
+        send(line);
+    else
+        options << line;
+}
+
+void UciEngine::analyse(const Position & position, Piece::Color sideToMove)
+{
+    QString fen = position.toFen(sideToMove);
+    if( bReady && !bSearching )
+    {
+        go(fen, sideToMove);
+        return;
+    }
+
+    bHavePending = true;
+    pendingFen = fen;
+    ePendingSide = sideToMove;
+    if( bSearching && !bStopping )
+    {
+        send("stop");
+        bStopping = true;
+    }
+}
+
+void UciEngine::stop()
+{
+    bHavePending = false;
+    if( bSearching && !bStopping )
+    {
+        send("stop");
+        bStopping = true;
+    }
+}
+
+void UciEngine::kill()
+{
+    bHavePending = false;
+    bQuitting = true;
+    if( process->state() != QProcess::NotRunning )
+        process->kill();
+}
+
+void UciEngine::quit()
+{
+    bHavePending = false;
+    bQuitting = true;
+    if( process->state() != QProcess::NotRunning )
+        send("quit");
+}
+
+void UciEngine::quitLater()
+{
+    quit();
+    if( process->state() == QProcess::NotRunning )
+    {
+        deleteLater();
+        return;
+    }
+    connect(process,SIGNAL(finished(int,QProcess::ExitStatus)),this,SLOT(deleteLater()));
+    QTimer::singleShot(1000, this, SLOT(forceQuit()));
+}
+
+void UciEngine::forceQuit()
+{
+    // a process that never started sends no finished()
+    if( process->state() == QProcess::NotRunning )
+        deleteLater();
+    else
+        kill();
+}
+
+void UciEngine::send(const QByteArray & line)
+{
+    process->write(line + '\n');
+}
+
+void UciEngine::go(const QString & fen, Piece::Color sideToMove)
+{
+    current = EngineEvaluation();
+    eSideToMove = sideToMove;
+    bSearching = true;
+
+    QByteArray command = "position fen " + fen.toLatin1() + "\ngo";
+    if( nDepth > 0 )
+        command += " depth " + QByteArray::number(nDepth);
+    else if( nMilliseconds > 0 )
+        command += " movetime " + QByteArray::number(nMilliseconds);
+    else
+        command += " infinite";
+    send(command);
+}
+
+void UciEngine::readOutput()
+{
+    while( process->canReadLine() )
+    {
+        QList<QByteArray> words = process->readLine().simplified().split(' ');
+        const QByteArray & command = words.first();
+
+        if( command == "info" )
+        {
+            parseInfo(words);
+        }
+        else if( command == "bestmove" )
+        {
+            bSearching = false;
+            if( bStopping )
+            {
+                bStopping = false;
+            }
+            else
+            {
+                current.bestMove = words.value(1);
+                if( current.pv.isEmpty() && !current.bestMove.isEmpty() )
+                    current.pv << current.bestMove;
+                emit finished(current);
+            }
+            if( bHavePending && !bSearching )
+            {
+                bHavePending = false;
+                go(pendingFen, ePendingSide);
+            }
+        }
+        else if( command == "id" && words.value(1) == "name" )
+        {
+            sName = QString::fromUtf8( words.mid(2).join(' ') );
+        }
+        else if( command == "uciok" )
+        {
+            foreach(QByteArray line, options)
+                send(line);
+            options.clear();
+            send("isready");
+        }
+        else if( command == "readyok" && !bReady )
+        {
+            bReady = true;
+            emit ready();
+            if( bHavePending && !bSearching )
+            {
+                bHavePending = false;
+                go(pendingFen, ePendingSide);
+            }
+        }
+    }
+}
+
+void UciEngine::parseInfo(const QList<QByteArray> & words)
+{
+    if( !bSearching || bStopping )
+        return;
+
+    EngineEvaluation e = current;
+    bool havePv = false;
+    for(int i=1; i<words.count(); i++)
+    {
+        const QByteArray & key = words.at(i);
+        if( key == "depth" )
+        {
+            e.depth = words.value(++i).toInt();
+        }
+        else if( key == "multipv" )
+        {
+            // only the best line is shown
+            if( words.value(++i).toInt() != 1 )
+                return;
+        }
+        else if( key == "score" )
+        {
+            QByteArray kind = words.value(++i);
+            e.mate = kind == "mate";
+            e.score = words.value(++i).toInt();
+            if( eSideToMove == Piece::Black )
+                e.score = -e.score;
+        }
+        else if( key == "nodes" )
+        {
+            e.nodes = words.value(++i).toULongLong();
+        }
+        else if( key == "time" )
+        {
+            e.milliseconds = words.value(++i).toLongLong();
+        }
+        else if( key == "pv" )
+        {
+            e.pv.clear();
+            for(i++; i<words.count(); i++)
+                e.pv << QString::fromLatin1( words.at(i) );
+            havePv = true;
+        }
+        else if( key == "string" )
+        {
+            break;
+        }
+    }
+
+    current = e;
+    if( havePv )
+        emit info(current);
+}
+
+void UciEngine::processError(QProcess::ProcessError e)
+{
+    if( e == QProcess::FailedToStart )
+    {
+        qDebug() << "Could not start:" << sName;
+        emit error( tr("Could not start %1").arg(sName) );
+    }
+}
+
+void UciEngine::processFinished(int exitCode, QProcess::ExitStatus status)
+{
+    Q_UNUSED(exitCode);
+    Q_UNUSED(status);
+    bool searching = bSearching;
+    bReady = false;
+    bSearching = false;
+    bStopping = false;
+    if( !bQuitting )
+        emit error( searching ? tr("%1 stopped during a search").arg(sName) : tr("%1 stopped").arg(sName) );
+}
@@ -0,0 +1,102 @@
+#ifndef UCIENGINE_H
+#define UCIENGINE_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QMetaType>
+
+#include "position.h"
+
+struct EngineEvaluation
+{
+    EngineEvaluation() : depth(0), score(0), mate(false), nodes(0), milliseconds(0) { }
+
+    // "+0.35", "-1.20", "#3", "#-2"
+    QString scoreText() const;
+
+    int depth;
+    int score;      // centipawns, or moves to mate if mate is set; positive is good for White
+    bool mate;
+    quint64 nodes;
+    qint64 milliseconds;
+    QStringList pv; // in the engine's long algebraic notation, e2e4
+    QString bestMove;
+};
+Q_DECLARE_METATYPE(EngineEvaluation)
+
+// A UCI engine run as a child process. Everything is asynchronous: the
+// engine's output is read as it arrives and reported through signals, so
+// the caller never waits on the process.
+//
+// analyse() may be called at any time. If the engine is still starting the
+// position waits for it; if it is searching, the search is stopped and the
+// new position follows as soon as the engine answers with its best move.
+// Only the most recent position is ever reported on.
+class UciEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UciEngine(QObject *parent = 0);
+    ~UciEngine();
+
+    void start(const QString & program, const QStringList & arguments = QStringList());
+    bool isRunning() const { return process->state() != QProcess::NotRunning; }
+    bool isReady() const { return bReady; }
+    bool isSearching() const { return bSearching; }
+    QString name() const { return sName; }
+
+    // sent once the engine is ready, before the first search
+    void setOption(const QString & name, const QString & value);
+
+    // a depth of 0 searches for milliseconds instead; both 0 searches until stop()
+    void setLimits(int depth, int milliseconds) { nDepth = depth; nMilliseconds = milliseconds; }
+
+public slots:
+    void analyse(const Position & position, Piece::Color sideToMove);
+    void stop();
+    void quit();
+    // ends the process at once, for an engine that has stopped answering; no error is signalled
+    void kill();
+    // asks the engine to quit and deletes this object once the process has
+    // ended, killing it after a second; unlike deleting it, this does not wait
+    void quitLater();
+
+signals:
+    void ready();
+    // during a search, each time the engine reports a new principal variation
+    void info(const EngineEvaluation & evaluation);
+    void finished(const EngineEvaluation & evaluation);
+    void error(const QString & message);
+
+private slots:
+    void readOutput();
+    void processError(QProcess::ProcessError e);
+    void processFinished(int exitCode, QProcess::ExitStatus status);
+    void forceQuit();
+
+private:
+    void send(const QByteArray & line);
+    void go(const QString & fen, Piece::Color sideToMove);
+    void parseInfo(const QList<QByteArray> & words);
+
+    QProcess *process;
+    QString sName;
+    bool bReady;
+    bool bSearching;
+    bool bStopping;     // a search was stopped and its best move is still to come
+    bool bQuitting;
+    QList<QByteArray> options;
+
+    bool bHavePending;
+    QString pendingFen;
+    Piece::Color ePendingSide;
+
+    Piece::Color eSideToMove;
+    EngineEvaluation current;
+
+    int nDepth;
+    int nMilliseconds;
+};
+
+#endif // UCIENGINE_H
@@ -0,0 +1,37 @@
+#include "zobrist.h"
+
+// splitmix64
+static quint64 nextRandom(quint64 & state)
+{
+    quint64 z = ( state += Q_UINT64_C(0x9E3779B97F4A7C15) );
+    z = ( z ^ ( z >> 30 ) ) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    z = ( z ^ ( z >> 27 ) ) * Q_UINT64_C(0x94D049BB133111EB);
+    return z ^ ( z >> 31 );
+}
+
+ZobristKeys::ZobristKeys()
+{
+    quint64 state = Q_UINT64_C(0x9E3779B97F4A7C15);
+    for(int s=0; s<64; s++)
+    {
+        square[s][0] = 0;
+        for(int code=1; code<16; code++)
+            square[s][code] = nextRandom(state);
+    }
+    castling[0] = 0;
+    for(int i=1; i<16; i++)
+        castling[i] = nextRandom(state);
+    for(int i=0; i<8; i++)
+        enPassant[i] = nextRandom(state);
+    blackToMove = nextRandom(state);
+
+    for(int i=0; i<32; i++)
+        for(int b=0; b<256; b++)
+            packed[i][b] = square[2*i][b & 0x0F] ^ square[2*i+1][b >> 4];
+}
+
+const ZobristKeys & zobristKeys()
+{
+    static const ZobristKeys keys;
+    return keys;
+}
@@ -0,0 +1,27 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <QtGlobal>
+
+// Random numbers for Zobrist hashing. They are the same on every run, so
+// keys can be stored in files.
+//
+// Squares are numbered as in Position, and pieces by their Position code,
+// so that Position::key() and BitboardPosition::key() agree. The keys for
+// an empty square and for no castling rights are 0.
+struct ZobristKeys
+{
+    ZobristKeys();
+
+    quint64 square[64][16];
+    quint64 castling[16];
+    quint64 enPassant[8];   // by file
+    quint64 blackToMove;
+
+    // square[2i][low nibble] ^ square[2i+1][high nibble], to hash a packed Position a byte at a time
+    quint64 packed[32][256];
+};
+
+const ZobristKeys & zobristKeys();
+
+#endif // ZOBRIST_H